@@ -8,11 +8,15 @@ street_names = pathlib.Path(__file__).parent.parent / "resources/denominations-e
 
 import cProfile
 
+LineSegmentation = __soducocxx.LineSegmentation
+ProcessingStage = __soducocxx.ProcessingStage
+
 class Application(__soducocxx.Application):
     parser = Parser(street_names)
 
-    def __init__(self, uri: str, page: int, progress = None, deskew_only=False):
-        super().__init__(uri, page, progress, deskew_only)
+    def __init__(self, uri: str, page: int, progress = None, deskew_only=False,
+                 lines=LineSegmentation.WATERSHED):
+        super().__init__(uri, page, progress, deskew_only, lines)
 
 
     def GetDocument(self):
@@ -20,11 +24,13 @@ class Application(__soducocxx.Application):
 
         #pr = cProfile.Profile()
         #pr.enable()
+        # The entries of the page are decoded at once (see Parser.decode_batch)
+        entries = [x for x in self.__doc if x["type"] == "ENTRY"]
+        for x, decoded in zip(entries, self.parser.decode_batch([x.get("text") for x in entries])):
+            x.update(decoded)
+            del x["text"]
+
         for x in self.__doc:
-            if x["type"] == "ENTRY":
-                text = x.get("text");
-                x.update(self.parser.decode(text))
-                del x["text"]
             if x["type"] == "ENTRY" or x["type"] == "TITLE_LEVEL_1" or x["type"] == "TITLE_LEVEL_2":
                 if x.get("origin") is None:
                     x["origin"] = "computer"
@@ -34,3 +40,105 @@ class Application(__soducocxx.Application):
         #pr.print_stats()
         return self.__doc
 
+
+    @classmethod
+    def FromJob(cls, jobs, job_id):
+        '''
+        Application processed by a finished job of `jobs` (see JobManager). The job is released.
+        '''
+        self = cls.__new__(cls)
+        super(Application, self).__init__(jobs, job_id)
+        return self
+
+
+    def SetDocument(self, document, from_stage=ProcessingStage.ENTRIES):
+        '''
+        Replace the document by a corrected one (same schema as GetDocument) and process it again from `from_stage`.
+        Return the new document. The boxes are clipped to the page, a box outside the page raises ValueError.
+        '''
+        super().SetDocument(document, from_stage)
+        return self.GetDocument()
+
+
+class JobManager(__soducocxx.JobManager):
+    '''
+    Process pages in background threads: submit(uri, page, deskew_only, lines) returns the id of the job, whose
+    status(job_id) ({"state", "progress", "error"}) can be polled until the result is available. The finished jobs
+    whose result is not taken are released after `ttl` seconds, or when there are more than `max_finished` of them.
+    '''
+
+    def result(self, job_id):
+        '''
+        Application processed by the job (the job is released) or None if the job is not finished.
+        Raise RuntimeError if the job has failed or has been canceled, IndexError if the job does not exist.
+        '''
+        if self.status(job_id)["state"] in ("PENDING", "RUNNING"):
+            return None
+        return Application.FromJob(self, job_id)
+
+
+
+import pytest
+
+def test_lines_across_column_seam(tmp_path):
+    '''
+    Two columns that overlap (as the columns of a split, which are inflated by margins) and text lines that cross the
+    boundary between them: every text pixel goes to a single line, so the lines of the two columns meet at the middle
+    of the overlap, without overlapping nor being truncated.
+    '''
+    from PIL import Image, ImageDraw
+
+    x0, x1, seam, margin = 150, 1450, 800, 12
+    image = Image.new("L", (1600, 1800), 255)
+    draw = ImageDraw.Draw(image)
+    for y in range(200, 1600, 60):
+        draw.rectangle((x0, y, x1 - 1, y + 19), fill=0)
+    pdf = str(tmp_path / "page.pdf")
+    image.save(pdf, resolution=72.0)  # Rendered at 72 dpi: one pixel per point
+
+    app = Application(pdf, 0)
+    page = next(x for x in app.GetDocument() if x["type"] == "PAGE")
+    left = (100, 100, seam + margin - 100, 1600)
+    right = (seam - margin, 100, 1500 - seam + margin, 1600)
+    document = app.SetDocument([{"id": 1, "type": "PAGE", "box": page["box"]},
+                                {"id": 2, "parent": 1, "type": "COLUMN_LEVEL_2", "box": left},
+                                {"id": 3, "parent": 1, "type": "COLUMN_LEVEL_2", "box": right}],
+                               ProcessingStage.LINES)
+
+    elements = {x["id"]: x for x in document}
+    def column(x):
+        while x["type"] != "COLUMN_LEVEL_2":
+            x = elements[x["parent"]]
+        return tuple(x["box"])
+
+    lines = {left: [], right: []}
+    for x in document:
+        if x["type"] == "LINE":
+            lines[column(x)].append(x["box"])
+
+    tolerance = 4  # The lines are detected on the subsampled page
+    assert lines[left] and lines[right]
+    assert abs(min(x for x, _, _, _ in lines[left]) - x0) <= tolerance
+    assert abs(max(x + w for x, _, w, _ in lines[left]) - seam) <= tolerance
+    assert abs(min(x for x, _, _, _ in lines[right]) - seam) <= tolerance
+    assert abs(max(x + w for x, _, w, _ in lines[right]) - x1) <= tolerance
+
+
+@pytest.mark.parametrize("parents", [[None, 1, 3], [None, 3, 2], [None, None, 1], [2, 3, 1]])
+def test_set_document_rejects_invalid_tree(tmp_path, parents):
+    '''
+    A corrected document with a parent cycle (self or ancestor), several roots or no root is rejected with a
+    ValueError before it replaces the document.
+    '''
+    from PIL import Image
+
+    pdf = str(tmp_path / "page.pdf")
+    Image.new("L", (200, 200), 255).save(pdf, resolution=72.0)
+
+    app = Application(pdf, 0)
+    before = app.GetDocument()
+    document = [{"id": i + 1, "parent": p, "type": "PAGE" if i == 0 else "COLUMN_LEVEL_2", "box": [0, 0, 100, 100]}
+                for i, p in enumerate(parents)]
+    with pytest.raises(ValueError):
+        app.SetDocument(document, ProcessingStage.LINES)
+    assert app.GetDocument() == before
@@ -0,0 +1,299 @@
+'''
+Binary format of a directory of page DOMs (.sdom).
+
+The layout is described in `sources/include/DOMBinary.hpp`: a header, an index of the pages sorted by page id, then one
+block per page with fixed-size node records and a string table. The file is memory-mapped so that a page is decoded
+without reading the others.
+
+The conversion from/to the json schema is lossless: the keys that do not fit in a record (or that do not have the
+expected type) are stored as a json object in the string table.
+'''
+import os
+import json
+import mmap
+import struct
+import tempfile
+import bisect
+
+MAGIC = b"SODUCODM"
+VERSION = 1
+UNKNOWN_TYPE = 0xFF
+
+HAS_ID = 1
+HAS_PARENT = 2
+HAS_TYPE = 4
+HAS_BOX = 8
+HAS_TEXT = 16
+
+# Same order as DOMCategory
+CATEGORIES = ["PAGE", "TITLE_LEVEL_1", "TITLE_LEVEL_2", "SECTION_LEVEL_1", "SECTION_LEVEL_2",
+              "COLUMN_LEVEL_1", "COLUMN_LEVEL_2", "ENTRY", "LINE"]
+_CATEGORY_CODE = {name: i for i, name in enumerate(CATEGORIES)}
+
+_FILE_HEADER = struct.Struct("<8sII")       # magic, version, num_pages
+_PAGE_INDEX = struct.Struct("<iIQQ")        # page_id, reserved, offset, size
+_PAGE_HEADER = struct.Struct("<II")         # num_nodes, strings_size
+_NODE_RECORD = struct.Struct("<ii4iIIIIBBH") # id, parent, box, text (offset, size), extra (offset, size), type, flags
+
+_INT32_MIN = -2**31
+_INT32_MAX = 2**31 - 1
+
+
+class DOMBinaryError(RuntimeError):
+    '''
+    Indicates that a .sdom file is invalid.
+    '''
+    def __init__(self, filename, msg):
+        super().__init__(f"Invalid DOM file \"{filename}\": {msg}")
+
+
+# Reading
+# =============================================================================
+class DOMFile:
+    '''
+    Memory-mapped .sdom file (use it as a context manager to release the mapping).
+    '''
+    def __init__(self, filename):
+        self.filename = filename
+        with open(filename, "rb") as f:
+            if os.fstat(f.fileno()).st_size < _FILE_HEADER.size:
+                raise DOMBinaryError(filename, "file too small")
+            self._map = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+
+        magic, version, num_pages = _FILE_HEADER.unpack_from(self._map, 0)
+        if magic != MAGIC:
+            self.close()
+            raise DOMBinaryError(filename, "bad magic number")
+        if version != VERSION:
+            self.close()
+            raise DOMBinaryError(filename, "unsupported version")
+        if _FILE_HEADER.size + num_pages * _PAGE_INDEX.size > len(self._map):
+            self.close()
+            raise DOMBinaryError(filename, "truncated index")
+
+        self._index = [_PAGE_INDEX.unpack_from(self._map, _FILE_HEADER.size + i * _PAGE_INDEX.size)
+                       for i in range(num_pages)]
+        self._ids = [e[0] for e in self._index]
+
+        # Validate the index and the pages once (as the C++ reader), so that the pages can be decoded without checks
+        try:
+            for i, (page_id, _, offset, size) in enumerate(self._index):
+                if i > 0 and self._ids[i - 1] >= page_id:
+                    raise DOMBinaryError(filename, "unsorted index")
+                if offset % 8 != 0 or offset + size > len(self._map):
+                    raise DOMBinaryError(filename, "page out of bounds")
+                _check_page(self._map, offset, size, filename)
+        except DOMBinaryError:
+            self.close()
+            raise
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *args):
+        self.close()
+
+    def close(self):
+        if self._map is not None:
+            self._map.close()
+            self._map = None
+
+    def pages(self):
+        '''
+        Ids of the pages (sorted).
+        '''
+        return list(self._ids)
+
+    def has_page(self, page_id):
+        return self.__find(page_id) is not None
+
+    def page_block(self, page_id):
+        '''
+        Encoded block of a page (bytes) or None if the file does not have the page.
+        '''
+        e = self.__find(page_id)
+        if e is None:
+            return None
+        _, _, offset, size = e
+        return self._map[offset:offset + size]
+
+    def load_page(self, page_id):
+        '''
+        Content of the page in the json schema (list of dict) or None if the file does not have the page.
+        '''
+        block = self.page_block(page_id)
+        if block is None:
+            return None
+        return _decode_page(block)
+
+    def __find(self, page_id):
+        i = bisect.bisect_left(self._ids, page_id)
+        if i < len(self._ids) and self._ids[i] == page_id:
+            return self._index[i]
+        return None
+
+
+def _check_page(buf, offset, size, filename):
+    '''
+    Check that the page block buf[offset:offset + size] is consistent: the node records and the strings are inside the
+    block and the types are known. Raise DOMBinaryError otherwise.
+    '''
+    if size < _PAGE_HEADER.size:
+        raise DOMBinaryError(filename, "page out of bounds")
+    num_nodes, strings_size = _PAGE_HEADER.unpack_from(buf, offset)
+    records_start = offset + _PAGE_HEADER.size
+    if _PAGE_HEADER.size + num_nodes * _NODE_RECORD.size + strings_size > size:
+        raise DOMBinaryError(filename, "truncated page")
+
+    for (_, _, _, _, _, _, text_offset, text_size, extra_offset, extra_size, code, flags, _) in \
+            _NODE_RECORD.iter_unpack(buf[records_start:records_start + num_nodes * _NODE_RECORD.size]):
+        if text_offset + text_size > strings_size or extra_offset + extra_size > strings_size:
+            raise DOMBinaryError(filename, "string out of bounds")
+        if flags & HAS_TYPE and code >= len(CATEGORIES):
+            raise DOMBinaryError(filename, "unknown node type")
+
+
+def decode_page(block):
+    '''
+    Decode a page block into the json schema (list of dict). Raise DOMBinaryError if the block is invalid.
+    '''
+    _check_page(block, 0, len(block), "<page>")
+    return _decode_page(block)
+
+
+def _decode_page(block):
+    # The block has been checked
+    num_nodes, strings_size = _PAGE_HEADER.unpack_from(block, 0)
+    strings_start = _PAGE_HEADER.size + num_nodes * _NODE_RECORD.size
+    strings = memoryview(block)[strings_start:strings_start + strings_size]
+
+    nodes = []
+    for (node_id, parent, x, y, w, h, text_offset, text_size, extra_offset, extra_size, code, flags, _) in \
+            _NODE_RECORD.iter_unpack(block[_PAGE_HEADER.size:strings_start]):
+        node = {}
+        if flags & HAS_ID:
+            node["id"] = node_id
+        if flags & HAS_PARENT:
+            node["parent"] = parent
+        if flags & HAS_TYPE:
+            node["type"] = CATEGORIES[code]
+        if flags & HAS_BOX:
+            node["box"] = [x, y, w, h]
+        if flags & HAS_TEXT:
+            node["text"] = str(strings[text_offset:text_offset + text_size], "utf-8")
+        if extra_size:
+            node.update(json.loads(str(strings[extra_offset:extra_offset + extra_size], "utf-8")))
+        nodes.append(node)
+    return nodes
+
+
+# Writing
+# =============================================================================
+def _is_int32(v):
+    return type(v) is int and _INT32_MIN <= v <= _INT32_MAX
+
+
+def _utf8(s):
+    try:
+        return s.encode("utf-8")
+    except UnicodeEncodeError: # Lone surrogates
+        return None
+
+
+def encode_page(nodes):
+    '''
+    Encode a page in the json schema (list of dict) into a page block (bytes).
+    '''
+    records = []
+    strings = bytearray()
+
+    def add_string(b):
+        offset = len(strings)
+        strings.extend(b)
+        return offset, len(b)
+
+    for node in nodes:
+        extra = dict(node)
+        flags = 0
+        node_id = parent = 0
+        box = (0, 0, 0, 0)
+        code = UNKNOWN_TYPE
+        text = (0, 0)
+
+        if _is_int32(extra.get("id")):
+            node_id = extra.pop("id")
+            flags |= HAS_ID
+        if _is_int32(extra.get("parent")):
+            parent = extra.pop("parent")
+            flags |= HAS_PARENT
+        if extra.get("type") in _CATEGORY_CODE:
+            code = _CATEGORY_CODE[extra.pop("type")]
+            flags |= HAS_TYPE
+        b = extra.get("box")
+        if isinstance(b, list) and len(b) == 4 and all(_is_int32(v) for v in b):
+            box = extra.pop("box")
+            flags |= HAS_BOX
+        if isinstance(extra.get("text"), str) and _utf8(extra["text"]) is not None:
+            text = add_string(_utf8(extra.pop("text")))
+            flags |= HAS_TEXT
+
+        extra_ref = (0, 0)
+        if extra:
+            encoded = _utf8(json.dumps(extra, ensure_ascii=False))
+            if encoded is None:
+                encoded = json.dumps(extra).encode("ascii")
+            extra_ref = add_string(encoded)
+
+        records.append(_NODE_RECORD.pack(node_id, parent, *box, *text, *extra_ref, code, flags, 0))
+
+    return _PAGE_HEADER.pack(len(records), len(strings)) + b"".join(records) + bytes(strings)
+
+
+# The umask can only be read by setting it: read once, not while other threads create files
+_UMASK = os.umask(0)
+os.umask(_UMASK)
+
+
+def write_file(filename, blocks):
+    '''
+    Write a .sdom file from a dict <page id (int), page block (bytes)>. The file is written in a temporary file of the
+    same directory and then renamed, with the default permissions (0666 & ~umask).
+    '''
+    ids = sorted(blocks.keys())
+    out = bytearray(_FILE_HEADER.pack(MAGIC, VERSION, len(ids)))
+
+    offset = _FILE_HEADER.size + len(ids) * _PAGE_INDEX.size
+    for i in ids:
+        out += _PAGE_INDEX.pack(i, 0, offset, len(blocks[i]))
+        offset = (offset + len(blocks[i]) + 7) & ~7
+    for i in ids:
+        out += blocks[i]
+        out += bytes(-len(out) % 8)
+
+    fd, tmp = tempfile.mkstemp(dir=os.path.dirname(os.path.abspath(filename)))
+    try:
+        with os.fdopen(fd, "wb") as f:
+            f.write(out)
+        # mkstemp creates the file with the mode 0600, give it the default permissions of a new file
+        os.chmod(tmp, 0o666 & ~_UMASK)
+        os.replace(tmp, filename)
+    except BaseException:
+        os.unlink(tmp)
+        raise
+
+
+# Conversions
+# =============================================================================
+def from_pages(pages, filename):
+    '''
+    Write a .sdom file from a dict <page id (int or 4-digits str), page content (json schema)>.
+    '''
+    write_file(filename, {int(k): encode_page(v) for k, v in pages.items()})
+
+
+def to_pages(filename):
+    '''
+    Read all the pages of a .sdom file in a dict <page id (4-digits str), page content (json schema)>.
+    '''
+    with DOMFile(filename) as f:
+        return {f"{i:04}": f.load_page(i) for i in f.pages()}
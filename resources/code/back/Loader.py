@@ -2,9 +2,13 @@ import os
 import json
 import tempfile
 import copy
+import struct
 import zipfile
+import zlib
 from pathlib import Path
 import back.Application as Application
+import back.DOMBinary as DOMBinary
+from back.soducocxx import AnnotationStore, parse_dom_json
 
 class LoadError(RuntimeError):
     '''
@@ -178,6 +182,103 @@ def load_DOM_zip(filename, load_policy="raise_error_if_do_not_exists", page_id=N
     return preloaded_dict
 
 
+def load_DOM_sdom(filename, load_policy="raise_error_if_do_not_exists"):
+    '''
+    Tries to load the DOM doc content from a binary DOM file (.sdom, see `back.DOMBinary`).
+    All the pages of the file will be loaded.
+    The behavior to apply when the target file do not exists can be defined thanks to a load_policy'.
+
+    Parameters
+    ----------
+    filename: (str)
+        Path to the target input.
+
+    load_policy: (str)
+        Selects the behavior to apply when target file do not exists:
+        - "raise_error_if_do_not_exists": raise FileDoNotExists
+        - "read_empty": load file as an empty file
+
+    Returns
+    --------
+    preloaded_map: (map)
+        map where the DOM document content will be saved. <key=num_page; value=DOM document content>
+
+    None if error
+
+    Exceptions
+    ----------
+    FileAlreadyExists:
+        When the target file do not exists and the `load_policy` is "raise_error_if_do_not_exists".
+
+    LoadError:
+        When the file is not a valid binary DOM file.
+    '''
+    if not os.path.exists(filename):
+        if load_policy == "raise_error_if_do_not_exists":
+            raise FileDoNotExist(filename)
+        return None
+    try:
+        pages = DOMBinary.to_pages(filename)
+    except DOMBinary.DOMBinaryError as e:
+        raise LoadError(str(e))
+    return {k: __prepare_doc(v) for k, v in pages.items()}
+
+
+def load_DOM_annot(filename, load_policy="raise_error_if_do_not_exists"):
+    '''
+    Tries to load the DOM doc content from an annotation store (.annot, see `back.soducocxx.AnnotationStore`).
+    All the pages of the store will be loaded.
+    The behavior to apply when the target file do not exists can be defined thanks to a load_policy'.
+
+    Parameters
+    ----------
+    filename: (str)
+        Path to the target input.
+
+    load_policy: (str)
+        Selects the behavior to apply when target file do not exists:
+        - "raise_error_if_do_not_exists": raise FileDoNotExists
+        - "read_empty": load file as an empty file
+
+    Returns
+    --------
+    preloaded_map: (map)
+        map where the DOM document content will be saved. <key=num_page; value=DOM document content>
+
+    None if error
+
+    Exceptions
+    ----------
+    FileAlreadyExists:
+        When the target file do not exists and the `load_policy` is "raise_error_if_do_not_exists".
+
+    LoadError:
+        When the file is not a valid annotation store.
+    '''
+    if not os.path.exists(filename):
+        if load_policy == "raise_error_if_do_not_exists":
+            raise FileDoNotExist(filename)
+        return None
+    try:
+        store = AnnotationStore(filename)
+        return {f"{i:04}": parse_dom_json(store.get(i)) for i in store.pages()}
+    except RuntimeError as e:
+        raise LoadError(str(e))
+
+
+def load_zip_page(filename, page_id):
+    '''
+    Return the content of the page from a zip file, or None if the zip file does not have the page.
+    Only the entry of the page is read and parsed: the directory of the zip file is read once, and again only when the
+    file has been modified.
+    '''
+    with open(filename, 'rb') as f:
+        info = __zip_directory(filename, f).get(f"{page_id:04}.json")
+        if info is None:
+            return None
+        return parse_dom_json(__read_zip_entry(filename, f, info))
+
+
 def load_page(filename, page_id):
     '''
     Return the preloaded content of the page if already loaded.
@@ -198,13 +299,38 @@ def load_page(filename, page_id):
     str_page_id = f"{page_id:04}"
     if not filename:
         return None
+    if Path(filename).suffix.lower() == ".sdom":
+        # Only the page is decoded
+        if not os.path.exists(filename):
+            return None
+        with DOMBinary.DOMFile(filename) as f:
+            content = f.load_page(page_id)
+        return __prepare_doc(content) if content is not None else None
+    if Path(filename).suffix.lower() == ".annot":
+        # Only the page is read
+        if not os.path.exists(filename):
+            return None
+        return load_store_page(AnnotationStore(filename), page_id)
+    if Path(filename).suffix.lower() == ".zip":
+        if not os.path.exists(filename):
+            return None
+        return load_zip_page(filename, page_id)
     dictionary = load_DOM_guess_type(filename, load_policy="load_empty") or dict()
     return dictionary.get(str_page_id, None)
 
+def load_store_page(store, page_id):
+    '''
+    Return the content of the page from an opened annotation store (see `back.soducocxx.AnnotationStore`).
+    Return None if the store does not have the page.
+    '''
+    content = store.get(page_id)
+    return parse_dom_json(content) if content is not None else None
+
 # Internal definitions
 # =============================================================================================
 __load_policies = ["raise_error_if_do_not_exists", "load_empty"]
-__type_to_loader = {".json": load_DOM_json, ".zip": load_DOM_zip}
+__type_to_loader = {".json": load_DOM_json, ".zip": load_DOM_zip, ".sdom": load_DOM_sdom, ".annot": load_DOM_annot}
+__zip_directories = dict() # path -> (identity of the file, {name: ZipInfo})
 
 def ___guess_loader_from_filename(filename):
     '''
@@ -221,7 +347,48 @@ def __json_from_file(jsonFile):
     Load and prepare the json to be used in the application.
     Create parent link between dict.
     '''
-    jsondoc = json.load(jsonFile)
+    return parse_dom_json(jsonFile.read())
+
+def __zip_directory(filename, zipFile):
+    '''
+    Return the entries of the opened zip file by name.
+    The directory is cached until the file is modified or replaced (the Saver renames a new zip over the old one).
+    '''
+    st = os.fstat(zipFile.fileno())
+    identity = (st.st_ino, st.st_size, st.st_mtime_ns)
+    path = os.path.abspath(filename)
+    cached = __zip_directories.get(path)
+    if cached is None or cached[0] != identity:
+        with zipfile.ZipFile(zipFile) as zipObj:
+            cached = (identity, {info.filename: info for info in zipObj.infolist()})
+        __zip_directories[path] = cached
+    return cached[1]
+
+def __read_zip_entry(filename, zipFile, info):
+    '''
+    Read an entry of the opened zip file from its local header (the directory is not read again).
+    '''
+    zipFile.seek(info.header_offset)
+    header = zipFile.read(30)
+    if len(header) != 30 or header[:4] != b"PK\x03\x04":
+        raise LoadError(f"Invalid zip entry \"{filename}#{info.filename}\"")
+    name_size, extra_size = struct.unpack("<HH", header[26:30])
+    zipFile.seek(name_size + extra_size, os.SEEK_CUR)
+    data = zipFile.read(info.compress_size)
+    if info.compress_type == zipfile.ZIP_DEFLATED:
+        data = zlib.decompress(data, -15)
+    elif info.compress_type != zipfile.ZIP_STORED:
+        zipFile.seek(0)
+        with zipfile.ZipFile(zipFile) as zipObj:
+            return zipObj.read(info)
+    if zlib.crc32(data) != info.CRC:
+        raise LoadError(f"Corrupted zip entry \"{filename}#{info.filename}\"")
+    return data
+
+def __prepare_doc(jsondoc):
+    '''
+    Add the default annotation fields to the titles and the entries.
+    '''
     for x in jsondoc:
         if x["type"] == "ENTRY" or x["type"] == "TITLE_LEVEL_1" or x["type"] == "TITLE_LEVEL_2":
             if x.get("origin") is None:
@@ -241,3 +408,34 @@ def insert_parent_link(dic):
 
 
 
+import pytest
+
+@pytest.mark.parametrize("text", [
+    '[]',
+    ' \n[ {"type" : "LINE", "id": 256, "box": [1, 2, 3, 4]} ]\t',
+    '[{"type": "ENTRY", "text": "a\\"b\\\\c\\/\\b\\f\\n\\r\\t\\u00e9\\u0000"}]',
+    '[{"type": "LINE", "text": "\u00e9\u20ac\U0001f600"}]',
+    '[{"type": "LINE", "text": "\\ud83d\\ude00 \\uD83D\\uDE00"}]',
+    '[{"type": "LINE", "text": "\\ud83d x \\ude00 \\udc00\\ud800"}]',
+    '[{"type": "LINE", "text": "\ud83d x \ude00"}]',
+    '[{"type": "LINE", "values": [NaN, Infinity, -Infinity, 1e400, -0.0, 1.5e-7, 0.1]}]',
+    '[{"type": "LINE", "values": [12345678901234567890123, -98765432109876543210, 0, -0, 9223372036854775808]}]',
+    '[{"type": "ENTRY", "origin": null, "a": 1, "a": [2], "checked": false, "a": 3}]',
+    '[{"type": "TITLE_LEVEL_1", "origin": "user", "checked": true}, {"type": "TITLE_LEVEL_2", "checked": null}]',
+    '[{"type": "PAGE", "children": [[], {}, [{"b": null, "c": true}]]}, {"type": "ENTRY", "id": 1, "parent": 0}]',
+])
+def test_parse_dom_json(text):
+    expected = repr(__prepare_doc(json.loads(text)))  # repr: NaN != NaN, 1 == 1.0 == True
+    assert repr(parse_dom_json(text)) == expected
+    assert repr(parse_dom_json(text.encode("utf-8", "surrogatepass"))) == expected
+    assert repr(parse_dom_json(b"\xef\xbb\xbf" + text.encode("utf-8", "surrogatepass"))) == expected
+
+@pytest.mark.parametrize("text", [
+    '', '[', '[1,]', '{"a" 1}', '[] []', '[{"type": "ENTRY"}] x', '["\\x"]', '["\\u12"]',
+    '["a\x01"]', '["a\n"]', '[01]', '[1.]', '[.5]', '[nan]', '[+1]', '\ufeff[]',
+])
+def test_parse_dom_json_rejects(text):
+    with pytest.raises(ValueError):
+        json.loads(text)
+    with pytest.raises(ValueError):
+        parse_dom_json(text)
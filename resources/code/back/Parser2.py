@@ -1,12 +1,21 @@
 import regex as re
+import os
 import logging
 import dataclasses
 import csv
+import hashlib
 from FastSpellChecker import Dictionary
 from dataclasses import dataclass
 from unidecode import unidecode
 from typing import List, Dict, Iterable
+from filelock import FileLock
 
+# Native implementation of the normalization (optional, the python implementation is used if it is not available)
+try:
+    from .soducocxx import split_entries as _native_split_entries, Gazetteer as _NativeGazetteer
+except ImportError:
+    _native_split_entries = None
+    _NativeGazetteer = None
 
 
 class Parser:
@@ -15,11 +24,12 @@ class Parser:
     '''
 
 
-    def decode(self, text):
+    def decode(self, text, fields = None):
         '''
         return a pair (text, score) with the decoded entry
+        `fields` are the normalized fields of the entry if they are already computed (see decode_batch)
         '''
-        entry = self._process_entry(text)
+        entry = self._process_entry(text, fields)
         if entry is None:
             entry = EntryParseResult()
         entry.raw = text
@@ -31,52 +41,50 @@ class Parser:
         return dataclasses.asdict(entry)
 
 
-    def __init__(self, street_names_uri):
-        self.street_fullnames = None
-        self.street_names = None
-        self.street_fullnames_rev = {}
-        self.street_names_rev = {}
-
-
-
-        with open(street_names_uri) as fp:
-            reader = csv.DictReader(fp, delimiter=';')
-            street_fullnames = set()
-            street_names = set()
-            for row in reader:
-                x = row["typo_min"]
-                y = text_normalize(row["nomvoie"], force_ascii=True)
-                street_names.add(y)
-                if y not in self.street_names_rev or row["typvoie"] == "rue":
-                    self.street_names_rev[y] = x
-
-                y = text_normalize(row["typo"])
-                street_fullnames.add(y)
-                self.street_fullnames_rev[y] = x
+    def decode_batch(self, texts):
+        '''
+        Decode a list of entries (same as decode on each entry)
+        The entries are normalized and split at once by the native implementation if it is available (the entries that
+        it does not handle are processed in python).
+        '''
+        fields = _native_split_entries(texts) if _native_split_entries else [None] * len(texts)
+        return [self.decode(text, f) for text, f in zip(texts, fields)]
 
 
+    def __init__(self, street_names_uri):
+        # The compiled gazetteer is shared by the processes (memory-mapped) and its dictionaries have the interface
+        # of both the spell checker dictionaries and the reverse dicts
+        gazetteer = _load_gazetteer(street_names_uri) if _NativeGazetteer else None
+        if gazetteer is not None:
+            self.street_names = self.street_names_rev = gazetteer.dictionary(0)
+            self.street_fullnames = self.street_fullnames_rev = gazetteer.dictionary(1)
+            return
 
-        self.street_fullnames = Dictionary(street_fullnames)
-        self.street_names = Dictionary(street_names)
+        self.street_names_rev, self.street_fullnames_rev = _read_street_names(street_names_uri)
+        self.street_fullnames = Dictionary(set(self.street_fullnames_rev.keys()))
+        self.street_names = Dictionary(set(self.street_names_rev.keys()))
 
 
-    def _process_entry(self, text: str):
+    def _process_entry(self, text: str, fields = None):
         '''
         '''
-        # 1. Text normalization
-        text = text_normalize(text, force_ascii = True, block = True, remove_abbrv = True)
+        if fields is None:
+            # 1. Text normalization
+            text = text_normalize(text, force_ascii = True, block = True, remove_abbrv = True)
 
-        logging.debug(text)
-        # 3. Split in fields
-        fields = _split_fields(text)
+            logging.debug(text)
+            # 3. Split in fields
+            fields = _split_fields(text)
 
         if len(fields) == 0:
             return None
 
         # 4. Parse fields
         name_field = fields[0]
+        street_names = _PrefetchedMatches(self.street_names, fields)
+        street_fullnames = _PrefetchedMatches(self.street_fullnames, fields)
         street_number_fields = [ _match_street_number(f) for f in fields ]
-        street_name_fields = [ _match_street_name(f, self.street_names, self.street_fullnames) for f in fields ]
+        street_name_fields = [ _match_street_name(f, street_names, street_fullnames) for f in fields ]
 
         logging.debug("Fields = {}".format(fields))
         logging.debug("Score StreetName = {}".format(street_name_fields))
@@ -97,6 +105,110 @@ class Parser:
         return None
 
 
+def _read_street_names(street_names_uri):
+    '''
+    Read the street names (csv) and return the dicts <normalized name, typography> of the names and of the full names
+    '''
+    street_names = {}
+    street_fullnames = {}
+    with open(street_names_uri) as fp:
+        reader = csv.DictReader(fp, delimiter=';')
+        for row in reader:
+            x = row["typo_min"]
+            y = text_normalize(row["nomvoie"], force_ascii=True)
+            if y not in street_names or row["typvoie"] == "rue":
+                street_names[y] = x
+
+            y = text_normalize(row["typo"])
+            street_fullnames[y] = x
+    return street_names, street_fullnames
+
+
+def _load_gazetteer(street_names_uri):
+    '''
+    Map the compiled gazetteer of the street names (dictionaries: names, full names).
+    The gazetteer is compiled next to the csv file if it is missing or if it was compiled from another content of the
+    csv file (the size and the hash of the source are recorded in <gazetteer>.src: the mtime is not enough, a copy can
+    keep it or make it go backwards).
+    Return None if it cannot be compiled.
+    '''
+    path = str(street_names_uri) + ".gaz"
+    stamp_path = path + ".src"
+
+    def load_if_up_to_date(stamp):
+        try:
+            with open(stamp_path) as fp:
+                if fp.read() != stamp:
+                    return None
+            return _NativeGazetteer(path)
+        except (OSError, RuntimeError): # Missing, invalid or older format
+            return None
+
+    try:
+        stamp = _source_stamp(street_names_uri)
+        gazetteer = load_if_up_to_date(stamp)
+        if gazetteer is None:
+            with FileLock(path + ".lock"):
+                gazetteer = load_if_up_to_date(stamp)
+                if gazetteer is None:
+                    _NativeGazetteer.compile(path, _read_street_names(street_names_uri))
+                    _write_stamp(stamp_path, stamp)
+                    gazetteer = _NativeGazetteer(path)
+        return gazetteer
+    except (OSError, RuntimeError) as e:
+        logging.warning("Unable to compile the gazetteer %s (%s)", path, e)
+        return None
+
+
+def _source_stamp(uri):
+    '''
+    Size and SHA-256 of the content of a file
+    '''
+    h = hashlib.sha256()
+    size = 0
+    with open(uri, "rb") as fp:
+        for chunk in iter(lambda: fp.read(1 << 20), b""):
+            h.update(chunk)
+            size += len(chunk)
+    return "{} {}".format(size, h.hexdigest())
+
+
+def _write_stamp(stamp_path, stamp):
+    '''
+    Write the stamp in a temporary file then rename it, so that the readers never see a partial stamp (called with the
+    lock of the gazetteer held, so the temporary file is not shared)
+    '''
+    tmp = stamp_path + ".tmp"
+    with open(tmp, "w") as fp:
+        fp.write(stamp)
+    os.replace(tmp, stamp_path)
+
+
+class _PrefetchedMatches:
+    '''
+    Dictionary whose best matches of the fields of an entry are searched at once (if the dictionary supports it)
+    '''
+    def __init__(self, dictionary, texts, max_distance = 2):
+        self.dictionary = dictionary
+        self.max_distance = max_distance
+        self.matches = {}
+        if hasattr(dictionary, "best_matches"):
+            # The texts longer than the longest word of the dictionary + max_distance have no match (the distance is at
+            # least the difference of the lengths, in code points as len), they are not worth a search
+            max_length = dictionary.max_word_length + max_distance
+            texts = [t for t in texts if 0 < len(t) <= max_length]
+            self.matches = dict(zip(texts, dictionary.best_matches(texts, max_distance)))
+
+    def __contains__(self, text):
+        return text in self.dictionary
+
+    def best_match(self, text, max_distance):
+        if max_distance == self.max_distance and text in self.matches:
+            m = self.matches[text]
+            return dict(m) if m else m
+        return self.dictionary.best_match(text, max_distance)
+
+
 class _bcolors:
     HEADER = '\033[95m'
     OKBLUE = '\033[94m'
@@ -426,6 +538,21 @@ if __name__ == "__main__":
 
 
 import pytest
+
+try:
+    from .soducocxx import text_normalize as _native_text_normalize, split_fields as _native_split_fields
+except ImportError:
+    _native_text_normalize = _native_split_fields = None
+
+_requires_native = pytest.mark.skipif(_native_text_normalize is None, reason="soducocxx is not available")
+
+@pytest.fixture(params=["python", pytest.param("native", marks=_requires_native)])
+def implementation(request):
+    if request.param == "python":
+        return text_normalize, _split_fields
+    return (lambda text, **kwargs: _native_text_normalize([text], **kwargs)[0],
+            lambda text: _native_split_fields([text])[0])
+
 @pytest.mark.parametrize("text, kwargs, expected", [
     ('  Rue du   Marché Saint-Honoré ',
      dict(force_ascii = 0, block = 0, remove_abbrv = 0, strip_dashes = 0),
@@ -446,5 +573,27 @@ import pytest
      dict(force_ascii = 0, block = 0, remove_abbrv = 1, strip_dashes = 1),
      "à brial(cte.)o\u2022 ,él., place de france, plumet, 18."),
 ])
-def test_normalization(text, kwargs, expected):
-    assert text_normalize(text, **kwargs) == expected
\ No newline at end of file
+def test_normalization(implementation, text, kwargs, expected):
+    normalize, _ = implementation
+    assert normalize(text, **kwargs) == expected
+
+@pytest.mark.parametrize("text, expected", [
+    ("Lagaffe (G.), avenue G\u2022 De Gaulle. 12.",
+     ["Lagaffe (G.)", "avenue G\u2022 De Gaulle", "12"]),
+    ("a (b, c); d:e (f", ["a (b, c)", "d", "e", "f"]),
+    (" , x()", ["", "x()"]),
+])
+def test_split_fields(implementation, text, expected):
+    _, split = implementation
+    assert split(text) == expected
+
+@_requires_native
+def test_gazetteer(tmp_path):
+    path = str(tmp_path / "streets.gaz")
+    _NativeGazetteer.compile(path, [{"rivoli": "rue de Rivoli", "rivolo": "x", "bac": "rue du Bac"}])
+    names = _NativeGazetteer(path).dictionary(0)
+    assert "bac" in names and "ba" not in names
+    assert names.get("bac") == "rue du Bac" and names.get("ba") is None
+    assert names.best_match("rivola", 2) == {"word": "rivoli", "distance": 1, "count": 2}
+    assert names.best_match("rue", 2) is None
+    assert names.best_matches(["bc", "zzz"], 1) == [{"word": "bac", "distance": 1, "count": 1}, None]
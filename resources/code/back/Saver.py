@@ -5,6 +5,8 @@ from filelock import FileLock
 import copy
 import zipfile
 from pathlib import Path
+import back.DOMBinary as DOMBinary
+from back.soducocxx import AnnotationStore
 
 # Exceptions
 # =============================================================================
@@ -220,10 +222,120 @@ def save_DOM_zip(doc_content, filename, page_id, overwrite_policy="raise_error_i
             os.rename(tmpZip, zipPath)
 
 
+def save_DOM_sdom(doc_content, filename, page_id, overwrite_policy="raise_error_if_exists"):
+    '''
+    Tries to save the document in the binary DOM format (.sdom, see `back.DOMBinary`).
+    The page is added to the file (or replaces the page with the same number); the other pages are copied without
+    being decoded.
+    The behavior to apply when the page already exists can be defined thanks to an overwrite policy.
+
+    Parameters
+    ----------
+    doc_content: (dict)
+        DOM document content to be saved.
+
+    filename: (str)
+        Path to the target destination of the binary file.
+
+    page_id: (int)
+        Number of the page in the document.
+
+    overwrite_policy: (str)
+        Selects the behavior to apply when target page already exists:
+        - "raise_error_if_exists": raise FileAlreadyExists
+        - "overwrite_all": silently overwrite the destination
+        - "overwrite_none": skip (do nothing) without warning
+
+    Returns
+    -------
+    None
+
+    Exceptions
+    ----------
+    FileAlreadyExists:
+        When the page already exists and the `overwrite_policy` is "raise_error_if_exists".
+
+    SaveError:
+        When another save-related error is detected.
+    '''
+    path = Path(filename)
+    lock = FileLock(filename + ".lock")
+    with lock:
+        blocks = dict()
+        if path.exists():
+            if not path.is_file():
+                raise SaveError(f"\"{path}\" is not a file. Cannot save.")
+            try:
+                with DOMBinary.DOMFile(filename) as f:
+                    if f.has_page(page_id):
+                        if overwrite_policy == "raise_error_if_exists":
+                            raise FileAlreadyExists(f"{path}#{page_id:04}")
+                        elif overwrite_policy == "overwrite_none":
+                            print(f"Skipping saving of page \"{path}#{page_id:04}\" because \"no overwrite\" policy is selected.")
+                            return
+                    blocks = {i: f.page_block(i) for i in f.pages()}
+            except DOMBinary.DOMBinaryError as e:
+                raise SaveError(f"{e}. Cannot save.")
+
+        blocks[page_id] = DOMBinary.encode_page(__doc_to_json(doc_content))
+        DOMBinary.write_file(filename, blocks)
+
+
+def save_DOM_annot(doc_content, filename, page_id, overwrite_policy="raise_error_if_exists"):
+    '''
+    Tries to save the document in an annotation store (.annot, see `back.soducocxx.AnnotationStore`).
+    The page is appended to the store: the other pages are neither read nor copied.
+    The behavior to apply when the page already exists can be defined thanks to an overwrite policy.
+
+    Parameters
+    ----------
+    doc_content: (dict)
+        DOM document content to be saved.
+
+    filename: (str)
+        Path to the target annotation store.
+
+    page_id: (int)
+        Number of the page in the document.
+
+    overwrite_policy: (str)
+        Selects the behavior to apply when target page already exists:
+        - "raise_error_if_exists": raise FileAlreadyExists
+        - "overwrite_all": silently overwrite the destination
+        - "overwrite_none": skip (do nothing) without warning
+
+    Returns
+    -------
+    None
+
+    Exceptions
+    ----------
+    FileAlreadyExists:
+        When the page already exists and the `overwrite_policy` is "raise_error_if_exists".
+
+    SaveError:
+        When another save-related error is detected.
+    '''
+    path = Path(filename)
+    if path.exists() and not path.is_file():
+        raise SaveError(f"\"{path}\" is not a file. Cannot save.")
+    try:
+        store = AnnotationStore(filename)
+        json_str = json.dumps(__doc_to_json(doc_content), ensure_ascii=False)
+        # The check and the write are done under the lock of the store
+        if store.put(page_id, json_str, overwrite=(overwrite_policy == "overwrite_all")):
+            return
+    except RuntimeError as e:
+        raise SaveError(f"{e}. Cannot save.")
+    if overwrite_policy == "raise_error_if_exists":
+        raise FileAlreadyExists(f"{path}#{page_id:04}")
+    print(f"Skipping saving of page \"{path}#{page_id:04}\" because \"no overwrite\" policy is selected.")
+
+
 # Internal definitions
 # =============================================================================
 __overwrite_policies = ["raise_error_if_exists", "overwrite_all", "overwrite_none"]
-__type_to_saver = {".json": save_DOM_json, ".zip": save_DOM_zip}
+__type_to_saver = {".json": save_DOM_json, ".zip": save_DOM_zip, ".sdom": save_DOM_sdom, ".annot": save_DOM_annot}
 
 
 def __guess_saver_from_filename(filename):
@@ -1,11 +1,13 @@
 '''
 The symbols exported are:
 * Application (The main entry point)
+* JobManager (Processing of pages in background threads)
 * Progress (An callback object used to track progress)
+* AnnotationStore (Append-only store of the annotated pages)
 * DOM (module to handle DOM types)
 
 '''
-from .Application import Application
-from .soducocxx import Progress, PDFInfo
+from .Application import Application, JobManager
+from .soducocxx import Progress, PDFInfo, AnnotationStore
 
 
@@ -2,7 +2,12 @@
 #include "DOMTypes-wrapper.hpp"
 
 #include <Application.hpp>
+#include <AnnotationStore.hpp>
+#include <DOMExport.hpp>
+#include <Gazetteer.hpp>
+#include <JobManager.hpp>
 #include <PDFInfo.hpp>
+#include <TextNormalize.hpp>
 #include <pybind11/pybind11.h>
 #include "ndimage_buffer_helper.hpp"
 #include <mln/core/image/ndbuffer_image.hpp>
@@ -14,7 +19,12 @@ namespace py = pybind11;
 class PyProgress : public Progress
 {
 public:
-  void Update(int value) final { PYBIND11_OVERLOAD_PURE(void, Progress, Update, value); }
+  // Called by the pipeline while the GIL is released
+  void Update(int value) final
+  {
+    py::gil_scoped_acquire gil;
+    PYBIND11_OVERLOAD_PURE(void, Progress, Update, value);
+  }
 };
 
 
@@ -29,10 +39,16 @@ int PyPDFInfo::get_num_pages() const
 }
 
 
-PyApplication::PyApplication(const std::string& uri, int page, Progress* progress = nullptr, bool deskew_only = false)
+PyApplication::PyApplication(const std::string& uri, int page, Progress* progress = nullptr, bool deskew_only = false,
+                             LineSegmentation lines = LineSegmentation::WATERSHED)
 {
   py::gil_scoped_release release;
-  m_app = std::make_unique<Application>(uri, page, progress, deskew_only);
+  m_app = std::make_unique<Application>(uri, page, progress, deskew_only, lines);
+}
+
+PyApplication::PyApplication(std::unique_ptr<Application> app)
+  : m_app{std::move(app)}
+{
 }
 
 PyApplication::~PyApplication()
@@ -54,25 +70,263 @@ py::array   PyApplication::GetDeskewedImage() const
 
 py::object   PyApplication::GetDocument() const
 {
-  DOMElement* doc = m_app->GetDocument();
-  return to_python(doc);
+  return to_python(m_app->GetFlatDocument());
+}
+
+py::dict     PyApplication::GetDocumentArrays() const
+{
+  return to_numpy(m_app->GetFlatDocument());
+}
+
+py::str      PyApplication::GetDocumentJSON() const
+{
+  std::string json;
+  {
+    py::gil_scoped_release release;
+    json = DOMExportToString(m_app->GetFlatDocument());
+  }
+  return py::str(json);
+}
+
+void PyApplication::ReprocessRegion(std::tuple<int, int, int, int> region, ProcessingStage from)
+{
+  auto [x, y, w, h] = region;
+  py::gil_scoped_release release;
+  m_app->ReprocessRegion(Box{x, y, w, h}, from);
+}
+
+void PyApplication::SetDocument(py::object doc, ProcessingStage from)
+{
+  auto document = from_python(doc);
+  py::gil_scoped_release release;
+  m_app->SetDocument(std::move(document), from);
+}
+
+// Convert the texts to UTF-8 (the items that are not str are replaced by empty strings and marked as invalid)
+static std::vector<std::string> texts_from_python(py::iterable texts, std::vector<bool>& valid)
+{
+  std::vector<std::string> out;
+  for (auto t : texts)
+  {
+    std::string s;
+    bool        ok = py::isinstance<py::str>(t);
+    if (ok)
+    {
+      try
+      {
+        s = t.cast<std::string>();
+      }
+      catch (const py::cast_error&) // Lone surrogates
+      {
+        ok = false;
+      }
+    }
+    out.push_back(std::move(s));
+    valid.push_back(ok);
+  }
+  return out;
+}
+
+static py::list fields_to_python(const std::vector<std::optional<std::vector<std::string>>>& fields,
+                                 const std::vector<bool>&                                     valid)
+{
+  py::list out;
+  for (std::size_t i = 0; i < fields.size(); ++i)
+  {
+    if (!valid[i] || !fields[i])
+    {
+      out.append(py::none());
+      continue;
+    }
+
+    py::list f;
+    for (const auto& x : *fields[i])
+      f.append(py::str(x));
+    out.append(f);
+  }
+  return out;
+}
+
+// Same as Parser2.text_normalize over a list of texts (None for the texts that are not handled)
+static py::list text_normalize(py::iterable texts, bool force_ascii, bool block, bool remove_abbrv, bool strip_dashes)
+{
+  std::vector<bool> valid;
+  auto              in = texts_from_python(texts, valid);
+
+  std::vector<std::optional<std::string>> res;
+  {
+    py::gil_scoped_release release;
+    res = TextNormalize::normalize(in, {force_ascii, block, remove_abbrv, strip_dashes});
+  }
+
+  py::list out;
+  for (std::size_t i = 0; i < res.size(); ++i)
+  {
+    if (valid[i] && res[i])
+      out.append(py::str(*res[i]));
+    else
+      out.append(py::none());
+  }
+  return out;
 }
 
-/*
-void PyApplication::SetDocument(py::object doc)
+// Same as Parser2._split_fields over a list of texts (None for the texts that are not handled)
+static py::list split_fields(py::iterable texts)
 {
-  from_python(doc);
+  std::vector<bool> valid;
+  auto              in = texts_from_python(texts, valid);
+
+  std::vector<std::optional<std::vector<std::string>>> res(in.size());
+  {
+    py::gil_scoped_release release;
+    for (std::size_t i = 0; i < in.size(); ++i)
+      res[i] = TextNormalize::split_fields(in[i]);
+  }
+  return fields_to_python(res, valid);
 }
-*/
+
+// Normalization and splitting of the entries as Parser._process_entry (None for the texts that are not handled)
+static py::list split_entries(py::iterable texts)
+{
+  std::vector<bool> valid;
+  auto              in = texts_from_python(texts, valid);
+
+  std::vector<std::optional<std::vector<std::string>>> res;
+  {
+    py::gil_scoped_release release;
+    res = TextNormalize::split_entries(in);
+  }
+  return fields_to_python(res, valid);
+}
+
+
+// Same format as FastSpellChecker.Dictionary.best_match: {"word", "distance", "count"} or None
+static py::object match_to_python(const std::optional<Gazetteer::match_t>& m)
+{
+  if (!m)
+    return py::none();
+
+  py::dict d;
+  d["word"]     = py::str(m->word.data(), m->word.size());
+  d["distance"] = m->distance;
+  d["count"]    = m->count;
+  return d;
+}
+
+static py::list best_matches(const Gazetteer::Dictionary& dict, py::iterable words, int max_distance)
+{
+  std::vector<std::string> in;
+  for (auto w : words)
+    in.push_back(w.cast<std::string>());
+
+  std::vector<std::optional<Gazetteer::match_t>> res;
+  {
+    py::gil_scoped_release release;
+    res = dict.best_matches(in, max_distance);
+  }
+
+  py::list out;
+  for (const auto& m : res)
+    out.append(match_to_python(m));
+  return out;
+}
+
+// Write a gazetteer from a list of dict <word, value>
+static void compile_gazetteer(const std::string& path, py::iterable dictionaries)
+{
+  Gazetteer::Writer w;
+  for (auto d : dictionaries)
+  {
+    std::map<std::string, std::string> entries;
+    for (auto [k, v] : d.cast<py::dict>())
+      entries[k.cast<std::string>()] = v.cast<std::string>();
+    w.add_dictionary(entries);
+  }
+
+  py::gil_scoped_release release;
+  w.save(path);
+}
+
+
+static const char* job_state_name(JobManager::State s)
+{
+  switch (s)
+  {
+  case JobManager::State::PENDING:
+    return "PENDING";
+  case JobManager::State::RUNNING:
+    return "RUNNING";
+  case JobManager::State::DONE:
+    return "DONE";
+  case JobManager::State::FAILED:
+    return "FAILED";
+  case JobManager::State::CANCELED:
+    break;
+  }
+  return "CANCELED";
+}
+
+// Status of a job: {"state": name of the state, "progress": int, "error": str or None}
+static py::dict job_status(JobManager& jobs, int job_id)
+{
+  auto     s = jobs.status(job_id);
+  py::dict d;
+  d["state"]    = job_state_name(s.state);
+  d["progress"] = s.progress;
+  d["error"]    = (s.state == JobManager::State::FAILED) ? py::object(py::str(s.error)) : py::object(py::none());
+  return d;
+}
+
+
+static py::object store_get(AnnotationStore::Store& store, int page_id)
+{
+  std::optional<std::string> content;
+  {
+    py::gil_scoped_release release;
+    content = store.get(page_id);
+  }
+  return content ? py::object(py::str(content->data(), content->size())) : py::object(py::none());
+}
+
+static py::list store_pages(AnnotationStore::Store& store)
+{
+  py::list out;
+  for (int p : store.pages())
+    out.append(p);
+  return out;
+}
+
 
 PYBIND11_MODULE(soducocxx, m)
 {
+  py::enum_<LineSegmentation>(m, "LineSegmentation")
+    .value("WATERSHED", LineSegmentation::WATERSHED)
+    .value("PROJECTION", LineSegmentation::PROJECTION)
+    .value("AUTO", LineSegmentation::AUTO);
+
+  py::enum_<ProcessingStage>(m, "ProcessingStage")
+    .value("LINES", ProcessingStage::LINES)
+    .value("ENTRIES", ProcessingStage::ENTRIES)
+    .value("TEXT", ProcessingStage::TEXT);
+
   py::class_<PyApplication>(m, "Application")
-    .def(py::init<const std::string&, int, PyProgress*, bool>())
+    .def(py::init<const std::string&, int, PyProgress*, bool, LineSegmentation>())
+    .def(py::init([](JobManager& jobs, int job_id) {
+           auto app = jobs.result(job_id);
+           if (!app)
+             throw py::value_error("The job is not finished");
+           return std::make_unique<PyApplication>(std::move(app));
+         }),
+         py::arg("jobs"), py::arg("job_id"))
     .def_property_readonly("InputImage", &PyApplication::GetInputImage, ::py::return_value_policy::reference_internal)
     .def_property_readonly("DeskewedImage", &PyApplication::GetDeskewedImage, ::py::return_value_policy::reference_internal)
     .def("GetDocument", &PyApplication::GetDocument)
-    //.def("SetDocument", &PyApplication::SetDocument)
+    .def("GetDocumentArrays", &PyApplication::GetDocumentArrays)
+    .def("GetDocumentJSON", &PyApplication::GetDocumentJSON)
+    .def("ReprocessRegion", &PyApplication::ReprocessRegion, py::arg("region"),
+         py::arg("from_stage") = ProcessingStage::LINES)
+    .def("SetDocument", &PyApplication::SetDocument, py::arg("document"),
+         py::arg("from_stage") = ProcessingStage::ENTRIES)
     ;
 
 
@@ -84,4 +338,62 @@ PYBIND11_MODULE(soducocxx, m)
   py::class_<PyPDFInfo>(m, "PDFInfo")
     .def(py::init<std::string>())
     .def("get_num_pages", &PyPDFInfo::get_num_pages);
+
+  // The progress of the jobs is polled (no callback), so the pipelines never wait for the GIL
+  py::class_<JobManager>(m, "JobManager")
+    .def(py::init([](int workers, int ttl, std::size_t max_finished) {
+           return std::make_unique<JobManager>(workers, std::chrono::seconds(ttl), max_finished);
+         }),
+         py::arg("workers") = 1, py::arg("ttl") = 1800, py::arg("max_finished") = 256)
+    .def(
+      "submit",
+      [](JobManager& jobs, const std::string& uri, int page, bool deskew_only, LineSegmentation lines) {
+        return jobs.submit(uri, page, JobOptions{deskew_only, lines});
+      },
+      py::arg("uri"), py::arg("page"), py::arg("deskew_only") = false, py::arg("lines") = LineSegmentation::WATERSHED)
+    .def("status", &job_status, py::arg("job_id"))
+    .def("cancel", &JobManager::cancel, py::arg("job_id"));
+
+  py::class_<Gazetteer::Reader>(m, "Gazetteer")
+    .def(py::init<const std::string&>())
+    .def("__len__", &Gazetteer::Reader::size)
+    .def("dictionary", &Gazetteer::Reader::dictionary, py::arg("index"), py::keep_alive<0, 1>())
+    .def_static("compile", &compile_gazetteer, py::arg("path"), py::arg("dictionaries"));
+
+  // Same interface as FastSpellChecker.Dictionary (and dict.get for the values)
+  py::class_<Gazetteer::Dictionary>(m, "GazetteerDictionary")
+    .def("__len__", &Gazetteer::Dictionary::size)
+    .def_property_readonly("max_word_length", &Gazetteer::Dictionary::max_word_length)
+    .def("__contains__", [](const Gazetteer::Dictionary& d, const std::string& w) { return d.contains(w); })
+    .def("get",
+         [](const Gazetteer::Dictionary& d, const std::string& w, py::object default_value) -> py::object {
+           auto v = d.get(w);
+           return v ? py::str(v->data(), v->size()) : default_value;
+         },
+         py::arg("word"), py::arg("default") = py::none())
+    .def("best_match",
+         [](const Gazetteer::Dictionary& d, const std::string& w, int max_distance) {
+           return match_to_python(d.best_match(w, max_distance));
+         },
+         py::arg("word"), py::arg("max_distance"))
+    .def("best_matches", &best_matches, py::arg("words"), py::arg("max_distance"));
+
+  // The writes are appended to the store (see AnnotationStore.hpp), so saving a page does not rewrite the others
+  py::class_<AnnotationStore::Store>(m, "AnnotationStore")
+    .def(py::init<std::string>(), py::arg("path"))
+    .def("pages", &store_pages)
+    .def("has_page", &AnnotationStore::Store::has_page, py::arg("page_id"))
+    .def("get", &store_get, py::arg("page_id"))
+    .def("put", &AnnotationStore::Store::put, py::arg("page_id"), py::arg("content"), py::arg("overwrite") = true,
+         py::call_guard<py::gil_scoped_release>())
+    .def("remove", &AnnotationStore::Store::remove, py::arg("page_id"), py::call_guard<py::gil_scoped_release>())
+    .def("compact", &AnnotationStore::Store::compact, py::call_guard<py::gil_scoped_release>())
+    .def("export_zip", &AnnotationStore::Store::export_zip, py::arg("path"),
+         py::call_guard<py::gil_scoped_release>());
+
+  m.def("parse_dom_json", &from_json, py::arg("json"));
+  m.def("text_normalize", &text_normalize, py::arg("texts"), py::arg("force_ascii") = false, py::arg("block") = false,
+        py::arg("remove_abbrv") = false, py::arg("strip_dashes") = true);
+  m.def("split_fields", &split_fields, py::arg("texts"));
+  m.def("split_entries", &split_entries, py::arg("texts"));
 }
@@ -7,11 +7,16 @@
 class Application;
 class Progress;
 class PDFInfo;
+enum class LineSegmentation;
+enum class ProcessingStage;
 
 class PyApplication
 {
 public:
-  PyApplication(const std::string& uri, int page, Progress* progress, bool deskew_only);
+  PyApplication(const std::string& uri, int page, Progress* progress, bool deskew_only, LineSegmentation lines);
+
+  // Wrap the application processed by a job (see JobManager)
+  explicit PyApplication(std::unique_ptr<Application> app);
   ~PyApplication();
 
   PyApplication(const PyApplication&) = delete;
@@ -23,7 +28,18 @@ public:
 
   // Return the root document object
   pybind11::object  GetDocument() const;
-  void              SetDocument(pybind11::object obj);
+
+  // Return the document as numpy columns (see to_numpy)
+  pybind11::dict    GetDocumentArrays() const;
+
+  // Return the document serialized in JSON
+  pybind11::str     GetDocumentJSON() const;
+
+  // Replace the document by a corrected one (see from_python) and process it again from the given stage
+  void              SetDocument(pybind11::object obj, ProcessingStage from);
+
+  // Process again the region (x, y, width, height) of the document from the given stage
+  void              ReprocessRegion(std::tuple<int, int, int, int> region, ProcessingStage from);
 
 private:
   std::unique_ptr<Application> m_app;
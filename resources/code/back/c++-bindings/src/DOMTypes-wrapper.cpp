@@ -1,142 +1,632 @@
 #include "DOMTypes-wrapper.hpp"
 
+#include <pybind11/numpy.h>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
 namespace py = pybind11;
 
 namespace
 {
-  struct ToPythonVisitor : public DOMConstElementVisitor
+  constexpr int kFirstId = 0x100; // Elements [0 - 255] are reserved
+
+  py::dict create_element(const FlatDOM& doc, int i)
   {
+    py::dict self;
+
+    auto b     = doc.bbox(i);
+    self["id"] = kFirstId + i;
+    if (doc.parent(i) != FlatDOM::kNone)
+      self["parent"] = kFirstId + doc.parent(i);
+    self["type"] = doc.type_str(i);
+    self["box"]  = std::make_tuple(b.x, b.y, b.width, b.height);
 
-    py::dict create_element(const DOMElement* e, void* parent_id)
+    if (FlatDOM::is_textual(doc.type(i)))
+      self["text"] = doc.text(i);
+
+    if (doc.type(i) == DOMCategory::LINE)
     {
-      py::dict  self;
-      int       id = m_id++;
+      self["indented"] = bool(doc.flags(i) & FlatDOM::INDENTED);
+      self["EOL"]      = bool(doc.flags(i) & FlatDOM::REACH_EOL);
+    }
+    return self;
+  }
 
-      auto b          = e->bbox;
-      self["id"]      = id;
-      if (parent_id)
-        self["parent"] = (int)(intptr_t)parent_id;
-      self["type"] = e->type_str();
-      self["box"]  = std::make_tuple(b.x, b.y, b.width, b.height);
 
-      if (!e->children.empty())
-        recurse(e, (void*)(intptr_t)id);
+  // Columns of the document (one value per node in document order)
+  struct dom_columns_t
+  {
+    std::vector<int32_t> id, parent, x, y, width, height;
+    std::vector<uint8_t> type, indented, eol;
+  };
 
-      return self;
+  dom_columns_t make_columns(const FlatDOM& doc)
+  {
+    const int     n = doc.size();
+    dom_columns_t c;
+    for (auto* v : {&c.id, &c.parent, &c.x, &c.y, &c.width, &c.height})
+      v->resize(n);
+    for (auto* v : {&c.type, &c.indented, &c.eol})
+      v->resize(n);
+
+    for (int i = 0; i < n; ++i)
+    {
+      const auto& b = doc.bbox(i);
+      c.id[i]       = kFirstId + i;
+      c.parent[i]   = doc.parent(i) != FlatDOM::kNone ? kFirstId + doc.parent(i) : -1;
+      c.type[i]     = static_cast<uint8_t>(doc.type(i));
+      c.x[i]        = b.x;
+      c.y[i]        = b.y;
+      c.width[i]    = b.width;
+      c.height[i]   = b.height;
+      c.indented[i] = (doc.flags(i) & FlatDOM::INDENTED) != 0;
+      c.eol[i]      = (doc.flags(i) & FlatDOM::REACH_EOL) != 0;
     }
+    return c;
+  }
+
+  // Numpy array that takes the ownership of the vector (no copy)
+  template <class T>
+  py::array as_array(std::vector<T>&& v, py::dtype dtype = py::dtype::of<T>())
+  {
+    auto*       p = new std::vector<T>(std::move(v));
+    py::capsule owner(p, [](void* x) { delete static_cast<std::vector<T>*>(x); });
+    py::ssize_t n = static_cast<py::ssize_t>(p->size());
+    return py::array(dtype, {n}, {py::ssize_t(sizeof(T))}, p->data(), owner);
+  }
 
-    void add_to_list(py::dict&& element) { m_elements.append(std::move(element)); }
 
-    void add_element(const DOMElement* e, void* parent_id)
+  // Node of the document built from an element of the python document (the children are not linked)
+  std::unique_ptr<DOMElement> create_node(const py::dict& in)
+  {
+    std::string type = py::cast<std::string>(in["type"]);
+
+    std::unique_ptr<DOMElement> e;
+    try
     {
-      auto x = create_element(e, parent_id);
-      add_to_list(std::move(x));
-    } 
+      e = DOMElement::create_node(std::string_view(type));
+    }
+    catch (const std::out_of_range&)
+    {
+      throw py::value_error("Unknown DOM element type: " + type);
+    }
 
+    py::sequence box = in["box"];
+    if (py::len(box) != 4)
+      throw py::value_error("The box of a DOM element must be (x, y, width, height)");
+    e->bbox = {py::cast<int>(box[0]), py::cast<int>(box[1]), py::cast<int>(box[2]), py::cast<int>(box[3])};
 
-    void add_element(const DOM::TextualElement* e, void* parent_id)
+    if (FlatDOM::is_textual(e->type()) && in.contains("text"))
     {
-      auto x = create_element(e, parent_id);
-      x["text"] = e->text;
-      add_to_list(std::move(x));
+      py::object text = in["text"];
+      if (py::isinstance<py::str>(text)) // The text of the entries may have been replaced by the parsed fields
+        static_cast<DOM::TextualElement*>(e.get())->text = py::cast<std::string>(text);
     }
 
-    void add_element(const DOM::line* e, void* parent_id)
+    if (e->type() == DOMCategory::LINE)
     {
-      auto x = create_element(e, parent_id);
-      x["text"] = e->text;
-      x["indented"] = e->indented;
-      x["EOL"] = e->reach_EOL;
-      add_to_list(std::move(x));
+      auto* l = static_cast<DOM::line*>(e.get());
+      if (in.contains("indented"))
+        l->indented = py::cast<bool>(in["indented"]);
+      if (in.contains("EOL"))
+        l->reach_EOL = py::cast<bool>(in["EOL"]);
     }
+    return e;
+  }
 
-    py::list get_root() const { return m_elements; }
+} // namespace
 
 
-    virtual void visit(const DOM::page* e, void* parent_id) override { add_element(e, parent_id); };
-    virtual void visit(const DOM::title_level_1* e, void* parent_id) override { add_element(e, parent_id); };
-    virtual void visit(const DOM::title_level_2* e, void* parent_id) override { add_element(e, parent_id); };
-    virtual void visit(const DOM::section_level_1* e, void* parent_id) override { add_element(e, parent_id); };
-    virtual void visit(const DOM::section_level_2* e, void* parent_id) override { add_element(e, parent_id); };
-    virtual void visit(const DOM::column_level_1* e, void* parent_id) override { add_element(e, parent_id); };
-    virtual void visit(const DOM::column_level_2* e, void* parent_id) override { add_element(e, parent_id); };
-    virtual void visit(const DOM::entry* e, void* parent_id) override { add_element(e, parent_id); };
-    virtual void visit(const DOM::line* e, void* parent_id) override { add_element(e, parent_id); };
+py::object to_python(const FlatDOM& doc)
+{
+  // The children are listed before their parent
+  py::list elements;
+  for (int i : doc.post_order())
+    elements.append(create_element(doc, i));
+  return elements;
+}
 
-  private:
-    py::list m_elements;
-    int      m_id = 0x100; // Elements [0 - 255] are reserved
-  };
+py::object to_python(const DOMElement* doc)
+{
+  return to_python(FlatDOM(doc));
+}
 
 
-  /*
-  std::unique_ptr<DOMElement>  from_python_impl(py::handle e);
+py::dict to_numpy(const FlatDOM& doc)
+{
+  dom_columns_t cols;
+  {
+    py::gil_scoped_release release;
+    cols = make_columns(doc);
+  }
 
-  struct FromPythonVisitor : public DOMElementVisitor
+  py::list texts;
+  for (int i = 0; i < doc.size(); ++i)
   {
-    void add_element(DOMElement* out, py::dict& in)
+    if (FlatDOM::is_textual(doc.type(i)))
+      texts.append(py::str(doc.text(i)));
+    else
+      texts.append(py::none());
+  }
+
+  py::list type_names;
+  for (auto cat : {DOMCategory::PAGE, DOMCategory::TITLE_LEVEL_1, DOMCategory::TITLE_LEVEL_2,
+                   DOMCategory::SECTION_LEVEL_1, DOMCategory::SECTION_LEVEL_2, DOMCategory::COLUMN_LEVEL_1,
+                   DOMCategory::COLUMN_LEVEL_2, DOMCategory::ENTRY, DOMCategory::LINE})
+    type_names.append(py::str(to_string(cat)));
+
+  py::dict out;
+  out["id"]         = as_array(std::move(cols.id));
+  out["parent"]     = as_array(std::move(cols.parent));
+  out["type"]       = as_array(std::move(cols.type));
+  out["x"]          = as_array(std::move(cols.x));
+  out["y"]          = as_array(std::move(cols.y));
+  out["width"]      = as_array(std::move(cols.width));
+  out["height"]     = as_array(std::move(cols.height));
+  out["indented"]   = as_array(std::move(cols.indented), py::dtype::of<bool>());
+  out["EOL"]        = as_array(std::move(cols.eol), py::dtype::of<bool>());
+  out["text"]       = texts;
+  out["type_names"] = type_names;
+  return out;
+}
+
+
+std::unique_ptr<DOMElement> from_python(py::object doc)
+{
+  py::list elements = doc;
+  const std::size_t n = elements.size();
+
+  std::vector<std::unique_ptr<DOMElement>> nodes(n);
+  std::unordered_map<int, std::size_t>     index;
+  for (std::size_t i = 0; i < n; ++i)
+  {
+    py::dict e = elements[i];
+    nodes[i]   = create_node(e);
+    if (!index.emplace(py::cast<int>(e["id"]), i).second)
+      throw py::value_error("Duplicate DOM element id: " + std::to_string(py::cast<int>(e["id"])));
+  }
+
+  // Parent positions (-1 for the root); the children are attached in the order of the list (the document order of
+  // the siblings)
+  std::vector<int> parents(n, -1);
+  for (std::size_t i = 0; i < n; ++i)
+  {
+    py::dict e = elements[i];
+    if (!e.contains("parent") || e["parent"].is_none())
+      continue;
+
+    auto it = index.find(py::cast<int>(e["parent"]));
+    if (it == index.end())
+      throw py::value_error("Invalid parent of the DOM element " + std::to_string(py::cast<int>(e["id"])));
+    parents[i] = static_cast<int>(it->second);
+  }
+
+  // Several roots, no root or parent cycles (the elements are numbered by their position in the list)
+  try
+  {
+    return DOMElement::create_tree(std::move(nodes), parents);
+  }
+  catch (const std::invalid_argument& e)
+  {
+    throw py::value_error(e.what());
+  }
+}
+
+
+namespace
+{
+  constexpr int kMaxJsonDepth = 1000;
+
+  // As json.loads, the unpaired surrogates (escaped or not) are kept
+  constexpr const char* kErrors = "surrogatepass";
+
+  py::object steal(PyObject* o)
+  {
+    if (!o)
+      throw py::error_already_set();
+    return py::reinterpret_steal<py::object>(o);
+  }
+
+  void append_utf8(std::string& out, uint32_t cp)
+  {
+    if (cp < 0x80)
+      out += static_cast<char>(cp);
+    else if (cp < 0x800)
+    {
+      out += static_cast<char>(0xC0 | (cp >> 6));
+      out += static_cast<char>(0x80 | (cp & 0x3F));
+    }
+    else if (cp < 0x10000)
     {
-      py::tuple bbox   = in["box"];
-      int       x      = py::cast<py::int_>(bbox[0]);
-      int       y      = py::cast<py::int_>(bbox[1]);
-      int       width  = py::cast<py::int_>(bbox[2]);
-      int       height = py::cast<py::int_>(bbox[3]);
+      out += static_cast<char>(0xE0 | (cp >> 12));
+      out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+      out += static_cast<char>(0x80 | (cp & 0x3F));
+    }
+    else
+    {
+      out += static_cast<char>(0xF0 | (cp >> 18));
+      out += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+      out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+      out += static_cast<char>(0x80 | (cp & 0x3F));
+    }
+  }
 
-      out->bbox = {x, y, width, height};
+  // Parser of the json of a saved document (same grammar and same values as json.loads)
+  //
+  // The values are built as python objects as the input is scanned (no intermediate json document), and the keys, that
+  // are the same for all the elements, are created once.
+  class json_parser
+  {
+  public:
+    explicit json_parser(std::string_view s)
+      : m_begin{s.data()}
+      , m_p{s.data()}
+      , m_end{s.data() + s.size()}
+    {
+    }
+
+    py::object parse()
+    {
+      skip_ws();
+      py::object v = value(0);
+      skip_ws();
+      if (m_p != m_end)
+        fail("Extra data");
+      return v;
+    }
+
+  private:
+    [[noreturn]] void fail(const char* msg) const
+    {
+      throw py::value_error(std::string(msg) + " (offset " + std::to_string(m_p - m_begin) + ")");
+    }
+
+    void skip_ws()
+    {
+      while (m_p != m_end && (*m_p == ' ' || *m_p == '\n' || *m_p == '\r' || *m_p == '\t'))
+        ++m_p;
+    }
+
+    bool consume(std::string_view literal)
+    {
+      if (static_cast<std::size_t>(m_end - m_p) < literal.size() || std::string_view(m_p, literal.size()) != literal)
+        return false;
+      m_p += literal.size();
+      return true;
+    }
+
+    bool is_digit() const { return m_p != m_end && *m_p >= '0' && *m_p <= '9'; }
+
+    py::object value(int depth)
+    {
+      if (m_p == m_end)
+        fail("Expecting value");
+
+      switch (*m_p)
+      {
+      case '{':
+        return object(depth + 1);
+      case '[':
+        return array(depth + 1);
+      case '"':
+        return string(false);
+      case 't':
+        if (consume("true"))
+          return py::reinterpret_borrow<py::object>(Py_True);
+        break;
+      case 'f':
+        if (consume("false"))
+          return py::reinterpret_borrow<py::object>(Py_False);
+        break;
+      case 'n':
+        if (consume("null"))
+          return py::reinterpret_borrow<py::object>(Py_None);
+        break;
+      case 'N':
+        if (consume("NaN"))
+          return steal(PyFloat_FromDouble(std::numeric_limits<double>::quiet_NaN()));
+        break;
+      case 'I':
+        if (consume("Infinity"))
+          return steal(PyFloat_FromDouble(std::numeric_limits<double>::infinity()));
+        break;
+      default:
+        if (consume("-Infinity"))
+          return steal(PyFloat_FromDouble(-std::numeric_limits<double>::infinity()));
+        if (*m_p == '-' || is_digit())
+          return number();
+      }
+      fail("Expecting value");
+    }
+
+    py::object array(int depth)
+    {
+      if (depth > kMaxJsonDepth)
+        fail("Too deeply nested");
+
+      ++m_p;
+      py::object list = steal(PyList_New(0));
+      skip_ws();
+      if (m_p != m_end && *m_p == ']')
+      {
+        ++m_p;
+        return list;
+      }
+      while (true)
+      {
+        skip_ws();
+        py::object v = value(depth);
+        if (PyList_Append(list.ptr(), v.ptr()) < 0)
+          throw py::error_already_set();
+        skip_ws();
+        if (m_p != m_end && *m_p == ']')
+        {
+          ++m_p;
+          return list;
+        }
+        if (m_p == m_end || *m_p != ',')
+          fail("Expecting ',' delimiter");
+        ++m_p;
+      }
+    }
+
+    py::object object(int depth)
+    {
+      if (depth > kMaxJsonDepth)
+        fail("Too deeply nested");
 
-      if (in.contains("children"))
+      ++m_p;
+      py::object dict = steal(PyDict_New());
+      skip_ws();
+      if (m_p != m_end && *m_p == '}')
       {
-        py::list children = in["children"];
-        for (auto&& c : children)
-          out->children.push_back(from_python_impl(c));
+        ++m_p;
+        return dict;
+      }
+      while (true)
+      {
+        skip_ws();
+        if (m_p == m_end || *m_p != '"')
+          fail("Expecting property name enclosed in double quotes");
+        py::object key = string(true);
+        skip_ws();
+        if (m_p == m_end || *m_p != ':')
+          fail("Expecting ':' delimiter");
+        ++m_p;
+        skip_ws();
+        py::object v = value(depth);
+        if (PyDict_SetItem(dict.ptr(), key.ptr(), v.ptr()) < 0)
+          throw py::error_already_set();
+        skip_ws();
+        if (m_p != m_end && *m_p == '}')
+        {
+          ++m_p;
+          return dict;
+        }
+        if (m_p == m_end || *m_p != ',')
+          fail("Expecting ',' delimiter");
+        ++m_p;
       }
     }
 
+    uint32_t hex4()
+    {
+      if (m_end - m_p < 4)
+        fail("Invalid \\uXXXX escape");
+      uint32_t v = 0;
+      for (int i = 0; i < 4; ++i)
+      {
+        char c = *m_p++;
+        v <<= 4;
+        if (c >= '0' && c <= '9')
+          v |= c - '0';
+        else if (c >= 'a' && c <= 'f')
+          v |= c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F')
+          v |= c - 'A' + 10;
+        else
+          fail("Invalid \\uXXXX escape");
+      }
+      return v;
+    }
 
-    void add_element(DOM::TextualElement* out, py::dict& in)
+    py::object string(bool is_key)
     {
-      out->text = py::cast<py::str>(in["text"]);
-      add_element((DOMElement*)out, in);
+      const char* start = ++m_p;
+      while (m_p != m_end && *m_p != '"' && *m_p != '\\' && static_cast<unsigned char>(*m_p) >= 0x20)
+        ++m_p;
+      if (m_p == m_end)
+        fail("Unterminated string");
+
+      // Without escapes, the string is decoded from the input
+      if (*m_p == '"')
+      {
+        std::string_view s(start, m_p - start);
+        ++m_p;
+        if (!is_key)
+          return steal(PyUnicode_DecodeUTF8(s.data(), s.size(), kErrors));
+
+        auto it = m_keys.find(s);
+        if (it == m_keys.end())
+          it = m_keys.emplace(s, steal(PyUnicode_DecodeUTF8(s.data(), s.size(), kErrors))).first;
+        return it->second;
+      }
+
+      std::string buf(start, m_p);
+      while (true)
+      {
+        if (m_p == m_end)
+          fail("Unterminated string");
+        char c = *m_p++;
+        if (c == '"')
+          break;
+        if (static_cast<unsigned char>(c) < 0x20)
+          fail("Invalid control character");
+        if (c != '\\')
+        {
+          buf += c;
+          continue;
+        }
+
+        if (m_p == m_end)
+          fail("Unterminated string");
+        switch (*m_p++)
+        {
+        case '"':
+          buf += '"';
+          break;
+        case '\\':
+          buf += '\\';
+          break;
+        case '/':
+          buf += '/';
+          break;
+        case 'b':
+          buf += '\b';
+          break;
+        case 'f':
+          buf += '\f';
+          break;
+        case 'n':
+          buf += '\n';
+          break;
+        case 'r':
+          buf += '\r';
+          break;
+        case 't':
+          buf += '\t';
+          break;
+        case 'u': {
+          uint32_t cp = hex4();
+          if (cp >= 0xD800 && cp < 0xDC00 && consume("\\u"))
+          {
+            const char* low_start = m_p - 2;
+            uint32_t    low       = hex4();
+            if (low >= 0xDC00 && low < 0xE000)
+              cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+            else
+              m_p = low_start; // The next escape is decoded on its own
+          }
+          append_utf8(buf, cp);
+          break;
+        }
+        default:
+          --m_p;
+          fail("Invalid \\escape");
+        }
+      }
+      return steal(PyUnicode_DecodeUTF8(buf.data(), buf.size(), kErrors));
     }
 
-    virtual void visit(DOM::page* out, void* in) override { add_element(out, *reinterpret_cast<py::dict*>(in)); };
-    virtual void visit(DOM::title_level_1* out, void* in) override { add_element(out, *reinterpret_cast<py::dict*>(in)); };
-    virtual void visit(DOM::title_level_2* out, void* in) override { add_element(out, *reinterpret_cast<py::dict*>(in)); };
-    virtual void visit(DOM::section_level_1* out, void* in) override { add_element(out, *reinterpret_cast<py::dict*>(in)); };
-    virtual void visit(DOM::section_level_2* out, void* in) override { add_element(out, *reinterpret_cast<py::dict*>(in)); };
-    virtual void visit(DOM::column_level_1* out, void* in) override { add_element(out, *reinterpret_cast<py::dict*>(in)); };
-    virtual void visit(DOM::column_level_2* out, void* in) override { add_element(out, *reinterpret_cast<py::dict*>(in)); };
-    virtual void visit(DOM::entry* out, void* in) override { add_element(out, *reinterpret_cast<py::dict*>(in)); };
-    virtual void visit(DOM::line* out, void* in) override { add_element(out, *reinterpret_cast<py::dict*>(in)); };
+    py::object number()
+    {
+      const char* start = m_p;
+      if (*m_p == '-')
+        ++m_p;
+      if (!is_digit())
+        fail("Expecting value");
+      if (*m_p == '0')
+        ++m_p;
+      else
+        while (is_digit())
+          ++m_p;
+
+      bool is_float = false;
+      if (m_end - m_p >= 2 && *m_p == '.' && m_p[1] >= '0' && m_p[1] <= '9')
+      {
+        is_float = true;
+        m_p += 2;
+        while (is_digit())
+          ++m_p;
+      }
+      if (m_p != m_end && (*m_p == 'e' || *m_p == 'E'))
+      {
+        const char* e = m_p++;
+        if (m_p != m_end && (*m_p == '+' || *m_p == '-'))
+          ++m_p;
+        if (is_digit())
+        {
+          is_float = true;
+          while (is_digit())
+            ++m_p;
+        }
+        else
+          m_p = e; // Not an exponent (the caller fails on the next character)
+      }
+
+      // The coordinates and the ids fit in a long long
+      std::string_view s(start, m_p - start);
+      if (!is_float && s.size() <= 18)
+      {
+        long long v = 0;
+        for (char c : s.substr(s[0] == '-'))
+          v = v * 10 + (c - '0');
+        return steal(PyLong_FromLongLong(s[0] == '-' ? -v : v));
+      }
+
+      std::string tmp(s);
+      if (!is_float)
+        return steal(PyLong_FromString(tmp.c_str(), nullptr, 10));
+      double v = PyOS_string_to_double(tmp.c_str(), nullptr, nullptr);
+      if (v == -1.0 && PyErr_Occurred())
+        throw py::error_already_set();
+      return steal(PyFloat_FromDouble(v));
+    }
+
+    const char*                                      m_begin;
+    const char*                                      m_p;
+    const char*                                      m_end;
+    std::unordered_map<std::string_view, py::object> m_keys;
   };
 
-  std::unique_ptr<DOMElement>  from_python_impl(py::handle e_)
+  // Same defaults as Loader.__prepare_doc
+  void set_annotation_defaults(PyObject* element)
   {
-    py::dict e = e_.cast<py::dict>();
-
-    std::string type_str = py::cast<py::str>(e["type"]);
+    PyObject* type = PyDict_GetItemString(element, "type");
+    if (!type || !PyUnicode_Check(type))
+      return;
+    if (PyUnicode_CompareWithASCIIString(type, "ENTRY") != 0 &&
+        PyUnicode_CompareWithASCIIString(type, "TITLE_LEVEL_1") != 0 &&
+        PyUnicode_CompareWithASCIIString(type, "TITLE_LEVEL_2") != 0)
+      return;
 
-    auto x = DOMElement::create_node(type_str);
-    FromPythonVisitor viz;
-    x->accept(viz, (void*)&e);
-    return x;
+    PyObject* origin = PyDict_GetItemString(element, "origin");
+    if (!origin || origin == Py_None)
+    {
+      py::object computer = steal(PyUnicode_FromString("computer"));
+      if (PyDict_SetItemString(element, "origin", computer.ptr()) < 0)
+        throw py::error_already_set();
+    }
+    PyObject* checked = PyDict_GetItemString(element, "checked");
+    if (!checked || checked == Py_None)
+      if (PyDict_SetItemString(element, "checked", Py_False) < 0)
+        throw py::error_already_set();
   }
-  */
-
 } // namespace
 
 
-py::object to_python(DOMElement* doc)
+py::object from_json(py::object json)
 {
-  ToPythonVisitor viz;
-  doc->accept(viz, nullptr);
-  return viz.get_root();
-}
+  py::object encoded = json;
+  if (!PyBytes_Check(json.ptr()))
+    encoded = steal(PyUnicode_AsEncodedString(json.ptr(), "utf-8", kErrors));
 
+  char*      data;
+  Py_ssize_t size;
+  if (PyBytes_AsStringAndSize(encoded.ptr(), &data, &size) < 0)
+    throw py::error_already_set();
 
-/*
-std::unique_ptr<DOMElement>  from_python(py::object doc)
-{
-  return from_python_impl(doc);
+  std::string_view s(data, size);
+  if (encoded.ptr() == json.ptr() && s.starts_with("\xEF\xBB\xBF")) // BOM (accepted by json.loads for bytes)
+    s.remove_prefix(3);
+
+  py::object doc = json_parser(s).parse();
+  if (PyList_Check(doc.ptr()))
+    for (Py_ssize_t i = 0; i < PyList_GET_SIZE(doc.ptr()); ++i)
+      if (PyObject* e = PyList_GET_ITEM(doc.ptr(), i); PyDict_Check(e))
+        set_annotation_defaults(e);
+  return doc;
 }
-*/
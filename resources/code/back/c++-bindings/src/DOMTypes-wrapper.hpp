@@ -1,7 +1,24 @@
 #pragma once
 
 #include <DOMTypes.hpp>
+#include <FlatDOM.hpp>
 #include <pybind11/pybind11.h>
 
-pybind11::object            to_python(DOMElement* document);
+pybind11::object            to_python(const FlatDOM& document);
+pybind11::object            to_python(const DOMElement* document);
+
+/// Convert the document to numpy columns (one value per node in document order):
+/// id, parent (-1 for the root), type (code, see type_names), x, y, width, height (int32), indented, EOL (bool) and
+/// text (list of str, None for the non-textual nodes)
+pybind11::dict              to_numpy(const FlatDOM& document);
+
+/// Build the document from its python representation (the list of elements returned by to_python, the elements are
+/// linked with their parent ids and the other keys are ignored)
+/// \throw pybind11::value_error if the document is invalid (duplicate ids, unknown parent, not exactly one root or a
+/// parent cycle)
 std::unique_ptr<DOMElement> from_python(pybind11::object document);
+
+/// Build the python representation of a saved document from its json (str or UTF-8 bytes). The result is the same as
+/// json.loads, with the default annotation fields of the titles and the entries (origin, checked) as set by the Loader.
+/// \throw pybind11::value_error if the json is invalid
+pybind11::object            from_json(pybind11::object json);
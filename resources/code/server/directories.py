@@ -8,11 +8,21 @@ import glob
 from io import BytesIO
 from PIL import Image as img
 from flask import Blueprint, request, jsonify, send_file, safe_join, abort, Response
-from back import Application, Loader, Saver, PDFInfo
+from filelock import FileLock
+from back import Application, Loader, Saver, PDFInfo, JobManager, AnnotationStore
 
 bp_directories = Blueprint('directories', __name__, url_prefix='/directories')
 bp_directories.config = {}
 
+# Background processing of the pages (created at first use, so that it is not shared by forked workers).
+# The jobs live in the process that has submitted them, so the polling must reach the same process (the server runs
+# a single gunicorn worker, see the Dockerfiles).
+jobs = None
+job_pages = dict() # job id -> (directory, view)
+
+# Annotation stores (.annot) opened by the server, by path (a store catches up with the writes of the other processes)
+annotation_stores = dict()
+
 def get_stem(path):
     '''
     Return the stem of the path arg.
@@ -29,6 +39,42 @@ def get_stem_with_extension(path, ext):
     '''
     return "{}.{}".format(get_stem(path), ext)
 
+def get_annotation_store(directory):
+    '''
+    Return the annotation store of the directory (created at first use).
+    The pages of a zip file saved by a previous version of the server are imported in the new store.
+    '''
+    store_path = osp.abspath(safe_join(bp_directories.config['SODUCO_ANNOTATIONS_PATH'], get_stem_with_extension(directory, "annot")))
+    store = annotation_stores.get(store_path)
+    if store is None:
+        zip_path = osp.abspath(safe_join(bp_directories.config['SODUCO_ANNOTATIONS_PATH'], get_stem_with_extension(directory, "zip")))
+        with FileLock(store_path + ".lock"):
+            if not osp.exists(store_path) and osp.exists(zip_path):
+                import_zip(zip_path, store_path)
+            store = AnnotationStore(store_path)
+        annotation_stores[store_path] = store
+    return store
+
+
+def import_zip(zip_path, store_path):
+    '''
+    Import the pages of a zip file in a new annotation store (the lock of the store must be held).
+    The store is filled aside and renamed when complete: an interrupted import leaves no store and is done again.
+    The members that are not pages (whose stem is not a page number) are skipped.
+    '''
+    tmp_path = store_path + ".import"
+    if osp.exists(tmp_path): # Left by an interrupted import
+        os.unlink(tmp_path)
+    store = AnnotationStore(tmp_path)
+    with zipfile.ZipFile(zip_path) as zip_obj:
+        for name in zip_obj.namelist():
+            stem = get_stem(name)
+            if not (stem.isascii() and stem.isdigit()):
+                continue
+            store.put(int(stem), zip_obj.read(name).decode('utf-8'), overwrite=False)
+    del store
+    os.replace(tmp_path, store_path)
+
 
 @bp_directories.record
 def record_config(setup_state):
@@ -122,8 +168,9 @@ def access_annotation(directory, view):
         force_compute = turn_to_bool(request.args.get('force_compute'))
         download = turn_to_bool(request.args.get('download'))
         content = None
+        store = get_annotation_store(directory)
         if not force_compute: 
-            content = Loader.load_page(safe_join(bp_directories.config['SODUCO_ANNOTATIONS_PATH'], get_stem_with_extension(directory, "zip")), view)
+            content = Loader.load_store_page(store, view)
             mode = "cached"
         if not content or force_compute: #if no content were found on the server we compute
             directory_path = safe_join(bp_directories.config['SODUCO_DIRECTORIES_PATH'], get_stem_with_extension(directory, "pdf"))
@@ -134,19 +181,9 @@ def access_annotation(directory, view):
             mode = "computed"
 
         # cache the computed data if not already cached
-        directory_found = False
-        file_found = False
-        directory_path = osp.abspath(safe_join(bp_directories.config['SODUCO_ANNOTATIONS_PATH'], get_stem_with_extension(directory, "zip")))
-        if osp.exists(directory_path):
-            directory_found = True
-        if directory_found:
-            zip_name = f'{view:04}.json'
-            with zipfile.ZipFile(directory_path) as zip_obj:
-                if zip_name in zip_obj.namelist():
-                    file_found = True
+        file_found = store.has_page(view)
         if not file_found:
-            Saver.save_DOM_guess_type(content, safe_join(bp_directories.config['SODUCO_ANNOTATIONS_PATH'], 
-                get_stem_with_extension(directory, "zip")), view, None)
+            store.put(view, json.dumps(content, ensure_ascii=False), overwrite=False)
 
         if download:
             downloaded_page = None
@@ -160,37 +197,44 @@ def access_annotation(directory, view):
             return jsonify({ "content": content, "mode": mode })#return jsonify({ content, mode})
     elif request.method == 'PUT':
         content = request.get_json(force=True)['content']
-        Saver.save_DOM_guess_type(content, safe_join(bp_directories.config['SODUCO_ANNOTATIONS_PATH'], 
-            get_stem_with_extension(directory, "zip")), view, overwrite_policy="overwrite_all")
+        get_annotation_store(directory).put(view, json.dumps(content, ensure_ascii=False))
         return "Content saved on the server", 200
 
 
 @bp_directories.route('/<directory>/download_directory', methods=['GET'])
 def download_directory(directory):
-    directory_path = osp.abspath(safe_join(bp_directories.config['SODUCO_ANNOTATIONS_PATH'], get_stem_with_extension(directory, "zip")))
-    # json error if file doesn't exist
-    if not osp.exists(directory_path):
-        abort(404, f"zip file of {directory} not found")
-    return send_file(directory_path, as_attachment=True)
+    store = get_annotation_store(directory)
+    # json error if no page is saved
+    if not store.pages():
+        abort(404, f"annotations of {directory} not found")
+    # the store is exported in a zip file (same content as the zip saver)
+    return send_temporary_file(store.export_zip, get_stem_with_extension(directory, "zip"))
 
 #@bp_directories.route('/<directory>/<int:view>/download_page', methods=['GET'])
 def download_page(directory, view, filename = None):
-   
-    directory_path = osp.abspath(safe_join(bp_directories.config['SODUCO_ANNOTATIONS_PATH'], get_stem_with_extension(directory, "zip")))
-    # json error if file doesn't exist
-    if not osp.exists(directory_path):
-        abort(404, f"zip file of {directory} not found")
+    content = get_annotation_store(directory).get(view)
+    # json error if the page is not saved
+    if content is None:
+        abort(404, f"json file {view:04}.json not found in {directory}")
 
-    zip_name = f'{view:04}.json'
-    mkdtmp = tmp.mkdtemp()
-    with zipfile.ZipFile(directory_path) as zip_obj:
-        # json error if json doesn't exist in zip
-        if zip_name not in zip_obj.namelist():
-            abort(404, f"json file {zip_name} not found in {directory}")
-        zip_path = zip_obj.extract(zip_name, mkdtmp)
+    def write(json_path):
+        with open(json_path, 'w', encoding='utf-8') as json_file:
+            json_file.write(content)
 
     # Return json file
-    return send_file(zip_path, as_attachment=True, mimetype='text/plain')
+    return send_temporary_file(write, f'{view:04}.json', mimetype='text/plain')
+
+
+def send_temporary_file(write, filename, **kwargs):
+    '''
+    Send the file written by write(path) in a temporary directory as an attachment. The directory is removed before the
+    response is sent: the open file stays readable and send_file closes it with the response.
+    '''
+    with tmp.TemporaryDirectory() as tmp_dir:
+        path = osp.join(tmp_dir, filename)
+        write(path)
+        data = open(path, 'rb')
+    return send_file(data, as_attachment=True, attachment_filename=filename, **kwargs)
 
 def download_computed_page(directory, view, content):
     proxy = io.StringIO()
@@ -205,6 +249,80 @@ def download_computed_page(directory, view, content):
     attachment_filename=  f'{view:04}' + '_' + get_stem_with_extension(directory, "json"),
     mimetype= 'text/json')
 
+def get_jobs():
+    global jobs
+    if jobs is None:
+        jobs = JobManager(bp_directories.config.get('SODUCO_JOB_WORKERS', 1))
+    return jobs
+
+
+@bp_directories.route('/<directory>/<int:view>/jobs', methods=['POST'])
+def submit_job(directory, view):
+    '''
+    Start the processing of a page in background and return the id of the job at once (poll /jobs/<job_id>).
+    '''
+    directory_path = safe_join(bp_directories.config['SODUCO_DIRECTORIES_PATH'], get_stem_with_extension(directory, "pdf"))
+    if not osp.exists(directory_path):
+        abort(404, f"pdf file of {directory} not found")
+    job_id = get_jobs().submit(directory_path, view)
+    job_pages[job_id] = (directory, view)
+
+    # Forget the jobs whose result has never been taken (they are released by the manager after a while)
+    for j in list(job_pages):
+        try:
+            get_jobs().status(j)
+        except IndexError:
+            del job_pages[j]
+    return jsonify({ "job": job_id }), 202
+
+
+@bp_directories.route('/jobs/<int:job_id>', methods=['GET', 'DELETE'])
+def access_job(job_id):
+    '''
+    GET: status of the job ({ state, progress, error })
+    DELETE: cancel the job (or release a finished job)
+    '''
+    if request.method == 'GET':
+        try:
+            return jsonify(get_jobs().status(job_id))
+        except IndexError:
+            job_pages.pop(job_id, None)
+            abort(404, f"job {job_id} not found")
+    elif request.method == 'DELETE':
+        if not get_jobs().cancel(job_id):
+            abort(404, f"job {job_id} not found")
+        job_pages.pop(job_id, None)
+        return "Job canceled", 200
+
+
+@bp_directories.route('/jobs/<int:job_id>/result', methods=['GET'])
+def get_job_result(job_id):
+    '''
+    Return the content computed by the job (same as the annotation route) and cache it if it is not already cached.
+    The job is released. While the job is running, return its status with the code 202.
+    '''
+    try:
+        app = get_jobs().result(job_id)
+    except IndexError:
+        job_pages.pop(job_id, None)
+        abort(404, f"job {job_id} not found")
+    except RuntimeError as e:
+        job_pages.pop(job_id, None)
+        abort(500, description=str(e))
+
+    if app is None:
+        return jsonify(get_jobs().status(job_id)), 202
+
+    # The page of the job is unknown if another request has taken the result in the meantime
+    page = job_pages.pop(job_id, None)
+    if page is None:
+        abort(404, f"job {job_id} not found")
+    directory, view = page
+    content = app.GetDocument()
+    get_annotation_store(directory).put(view, json.dumps(content, ensure_ascii=False), overwrite=False)
+    return jsonify({ "content": content, "mode": "computed" })
+
+
 def turn_to_bool(action):
     if not action or action == '0':
         return False
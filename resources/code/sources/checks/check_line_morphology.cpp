@@ -0,0 +1,201 @@
+// Check that the line morphology (line_morphology.hpp) gives the same results as a brute-force definition and as
+// Pylene, and compare their timings.
+//
+//   check-line-morphology [iterations]
+
+#include "checks.hpp"
+#include "config.hpp"
+#include "line_morphology.hpp"
+
+#include <mln/core/se/periodic_line2d.hpp>
+#include <mln/core/se/rect2d.hpp>
+#include <mln/morpho/closing.hpp>
+#include <mln/morpho/dilation.hpp>
+#include <mln/morpho/erosion.hpp>
+#include <mln/morpho/opening.hpp>
+
+#include <cstdlib>
+#include <functional>
+
+
+namespace
+{
+  using image_t = mln::image2d<uint8_t>;
+  using op_t    = std::function<uint8_t(uint8_t, uint8_t)>;
+
+  const op_t kMin = [](uint8_t a, uint8_t b) { return std::min(a, b); };
+  const op_t kMax = [](uint8_t a, uint8_t b) { return std::max(a, b); };
+
+  // Min/max over the window [x - kx, x + kx] x [y - ky, y + ky] restricted to the domain
+  image_t brute_rect(const image_t& f, int kx, int ky, const op_t& op)
+  {
+    image_t out;
+    mln::resize(out, f);
+    for (int y = 0; y < f.height(); ++y)
+      for (int x = 0; x < f.width(); ++x)
+      {
+        uint8_t v = f.buffer()[y * f.stride() + x];
+        for (int yy = std::max(y - ky, 0); yy <= std::min(y + ky, f.height() - 1); ++yy)
+          for (int xx = std::max(x - kx, 0); xx <= std::min(x + kx, f.width() - 1); ++xx)
+            v = op(v, f.buffer()[yy * f.stride() + xx]);
+        out.buffer()[y * out.stride() + x] = v;
+      }
+    return out;
+  }
+
+  std::string fmt_case(const std::string& name, const image_t& f)
+  {
+    char buf[128];
+    std::snprintf(buf, sizeof(buf), "%s (%dx%d+%d+%d)", name.c_str(), f.width(), f.height(), f.domain().x(),
+                  f.domain().y());
+    return buf;
+  }
+
+  std::string fmt_case(const char* name, const image_t& f, int kx, int ky)
+  {
+    return fmt_case(std::string(name) + " kx=" + std::to_string(kx) + " ky=" + std::to_string(ky), f);
+  }
+
+  struct operator_t
+  {
+    const char*                                      name;
+    std::function<image_t(const image_t&, int, int)> ours; // (f, kx, ky)
+    std::function<image_t(const image_t&, int, int)> brute;
+    std::function<image_t(const image_t&, int, int)> pylene;
+  };
+
+  mln::se::periodic_line2d hline(int k) { return mln::se::periodic_line2d(mln::point2d{1, 0}, k); }
+  mln::se::periodic_line2d vline(int k) { return mln::se::periodic_line2d(mln::point2d{0, 1}, k); }
+  mln::se::rect2d          rect(int kx, int ky) { return mln::se::rect2d(2 * kx + 1, 2 * ky + 1); }
+
+  // The horizontal operators use kx, the vertical ones ky and the rectangles both
+  const std::vector<operator_t>& operators()
+  {
+    static const std::vector<operator_t> ops = {
+      {"hline_erosion", [](auto& f, int kx, int) { return hline_erosion(f, kx); },
+       [](auto& f, int kx, int) { return brute_rect(f, kx, 0, kMin); },
+       [](auto& f, int kx, int) -> image_t { return mln::morpho::erosion(f, hline(kx)); }},
+      {"hline_dilation", [](auto& f, int kx, int) { return hline_dilation(f, kx); },
+       [](auto& f, int kx, int) { return brute_rect(f, kx, 0, kMax); },
+       [](auto& f, int kx, int) -> image_t { return mln::morpho::dilation(f, hline(kx)); }},
+      {"vline_erosion", [](auto& f, int, int ky) { return vline_erosion(f, ky); },
+       [](auto& f, int, int ky) { return brute_rect(f, 0, ky, kMin); },
+       [](auto& f, int, int ky) -> image_t { return mln::morpho::erosion(f, vline(ky)); }},
+      {"vline_dilation", [](auto& f, int, int ky) { return vline_dilation(f, ky); },
+       [](auto& f, int, int ky) { return brute_rect(f, 0, ky, kMax); },
+       [](auto& f, int, int ky) -> image_t { return mln::morpho::dilation(f, vline(ky)); }},
+      {"hline_opening", [](auto& f, int kx, int) { return hline_opening(f, kx); },
+       [](auto& f, int kx, int) { return brute_rect(brute_rect(f, kx, 0, kMin), kx, 0, kMax); },
+       [](auto& f, int kx, int) -> image_t { return mln::morpho::opening(f, hline(kx)); }},
+      {"vline_opening", [](auto& f, int, int ky) { return vline_opening(f, ky); },
+       [](auto& f, int, int ky) { return brute_rect(brute_rect(f, 0, ky, kMin), 0, ky, kMax); },
+       [](auto& f, int, int ky) -> image_t { return mln::morpho::opening(f, vline(ky)); }},
+      {"hline_closing", [](auto& f, int kx, int) { return hline_closing(f, kx); },
+       [](auto& f, int kx, int) { return brute_rect(brute_rect(f, kx, 0, kMax), kx, 0, kMin); },
+       [](auto& f, int kx, int) -> image_t { return mln::morpho::closing(f, hline(kx)); }},
+      {"vline_closing", [](auto& f, int, int ky) { return vline_closing(f, ky); },
+       [](auto& f, int, int ky) { return brute_rect(brute_rect(f, 0, ky, kMax), 0, ky, kMin); },
+       [](auto& f, int, int ky) -> image_t { return mln::morpho::closing(f, vline(ky)); }},
+      {"rect_opening", [](auto& f, int kx, int ky) { return rect_opening(f, 2 * kx + 1, 2 * ky + 1); },
+       [](auto& f, int kx, int ky) { return brute_rect(brute_rect(f, kx, ky, kMin), kx, ky, kMax); },
+       [](auto& f, int kx, int ky) -> image_t { return mln::morpho::opening(f, rect(kx, ky)); }},
+      {"rect_closing", [](auto& f, int kx, int ky) { return rect_closing(f, 2 * kx + 1, 2 * ky + 1); },
+       [](auto& f, int kx, int ky) { return brute_rect(brute_rect(f, kx, ky, kMax), kx, ky, kMin); },
+       [](auto& f, int kx, int ky) -> image_t { return mln::morpho::closing(f, rect(kx, ky)); }},
+    };
+    return ops;
+  }
+
+  struct layout_call_t
+  {
+    std::string                             name;
+    std::function<image_t(const image_t&)> ours;
+    std::function<image_t(const image_t&)> brute;
+    std::function<image_t(const image_t&)> pylene;
+  };
+
+  // The calls of the layout analysis, with the SE sizes of config.hpp (crop, make_blocks and the line segmentation)
+  std::vector<layout_call_t> layout_calls()
+  {
+    std::vector<layout_call_t> calls;
+    for (int k : {kLayoutPageOpeningHeight / 2, kLayoutBlockOpeningHeight, kLayoutBlockOpeningHeight / 2})
+      calls.push_back({"vline_opening k=" + std::to_string(k), [k](auto& f) { return vline_opening(f, k); },
+                       [k](auto& f) { return brute_rect(brute_rect(f, 0, k, kMin), 0, k, kMax); },
+                       [k](auto& f) -> image_t { return mln::morpho::opening(f, vline(k)); }});
+    for (int k : {kLayoutPageOpeningWidth / 2, kLayoutBlockOpeningWidth / 2})
+      calls.push_back({"hline_opening k=" + std::to_string(k), [k](auto& f) { return hline_opening(f, k); },
+                       [k](auto& f) { return brute_rect(brute_rect(f, k, 0, kMin), k, 0, kMax); },
+                       [k](auto& f) -> image_t { return mln::morpho::opening(f, hline(k)); }});
+
+    // rect2d(width, height) with an even width, as in the line segmentation
+    const int w = static_cast<int>((kWordWidth / 2.f) + 0.5f);
+    const int h = static_cast<int>((kLineHeight / 2.f) / 3.f + 0.5f);
+    calls.push_back({"rect_closing " + std::to_string(w) + "x" + std::to_string(h),
+                     [w, h](auto& f) { return rect_closing(f, w, h); },
+                     [w, h](auto& f) { return brute_rect(brute_rect(f, w / 2, h / 2, kMax), w / 2, h / 2, kMin); },
+                     [w, h](auto& f) -> image_t { return mln::morpho::closing(f, mln::se::rect2d(w, h)); }});
+    return calls;
+  }
+} // namespace
+
+
+int main(int argc, char** argv)
+{
+  const int    iterations = (argc > 1) ? std::atoi(argv[1]) : 200;
+  std::mt19937 rng(42);
+  int          failures = 0;
+
+  // 1. Random images (and sub-images, whose outside pixels must be ignored) with random SE sizes, including sizes
+  //    larger than the image
+  std::uniform_int_distribution<int> size(1, 150), half(0, 40), levels(2, 256);
+  for (int i = 0; i < iterations; ++i)
+  {
+    image_t f = checks::random_image(size(rng), size(rng), levels(rng), rng);
+    if (i % 2)
+      f = f.clip(checks::random_box(f.domain(), rng));
+
+    const int kx = half(rng), ky = half(rng);
+    for (const auto& op : operators())
+    {
+      auto what = fmt_case(op.name, f, kx, ky);
+      auto r    = op.ours(f, kx, ky);
+      failures += !checks::same(r, op.brute(f, kx, ky), what + " vs brute force");
+      failures += !checks::same(r, op.pylene(f, kx, ky), what + " vs Pylene");
+    }
+  }
+  std::printf("%d random cases: %d failure(s)\n", iterations, failures);
+
+  // 2. The calls of the layout analysis on ROIs of a page (the pixels around the ROI exist in the buffer but are
+  //    outside the domain, as in the line segmentation of a column). The first ROI is the whole page.
+  {
+    image_t page       = checks::page_image(600, 800, rng);
+    int     nfailures0 = failures;
+    for (int i = 0; i < iterations / 10 + 1; ++i)
+    {
+      image_t f = (i == 0) ? page : page.clip(checks::random_box(page.domain(), rng));
+      for (const auto& call : layout_calls())
+      {
+        auto what = fmt_case(call.name, f);
+        auto r    = call.ours(f);
+        failures += !checks::same(r, call.brute(f), what + " vs brute force");
+        failures += !checks::same(r, call.pylene(f), what + " vs Pylene");
+      }
+    }
+    std::printf("%d ROIs with the layout SE sizes: %d failure(s)\n", iterations / 10 + 1, failures - nfailures0);
+  }
+
+  // 3. Timings on a page with the sizes of the layout analysis
+  {
+    image_t page = checks::page_image(2500, 3500, rng);
+    std::printf("\n%-16s %5s %5s %12s %12s\n", "operator", "kx", "ky", "ours (ms)", "Pylene (ms)");
+    for (auto [kx, ky] : {std::pair{3, 5}, std::pair{100, 100}, std::pair{30, 5}})
+      for (const auto& op : operators())
+      {
+        double ours   = checks::time_ms([&] { op.ours(page, kx, ky); });
+        double pylene = checks::time_ms([&] { op.pylene(page, kx, ky); }, 1);
+        std::printf("%-16s %5d %5d %12.1f %12.1f\n", op.name, kx, ky, ours, pylene);
+      }
+  }
+
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,89 @@
+// Check that the watershed specialized for 8-bit images gives the same labels as the generic implementation (flooding
+// with the Pylene priority queue, both in watershed.hpp), and compare their timings.
+//
+//   check-watershed [iterations]
+
+#include "checks.hpp"
+#include "watershed.hpp"
+
+#include <mln/core/neighborhood/c4.hpp>
+
+#include <cstdlib>
+
+
+namespace
+{
+  // Labels in [1, nlabel] on random pixels, 0 elsewhere
+  mln::image2d<int16_t> random_markers(mln::box2d domain, int nlabel, double density, std::mt19937& rng)
+  {
+    mln::image2d<int16_t> m;
+    mln::resize(m, mln::image2d<uint8_t>(domain)).set_init_value(int16_t(0));
+
+    std::bernoulli_distribution        marked(density);
+    std::uniform_int_distribution<int> label(1, nlabel);
+    for (int y = 0; y < m.height(); ++y)
+      for (int x = 0; x < m.width(); ++x)
+        if (marked(rng))
+          m.buffer()[y * m.stride() + x] = static_cast<int16_t>(label(rng));
+    return m;
+  }
+
+  mln::image2d<int16_t> copy_of(const mln::image2d<int16_t>& m)
+  {
+    mln::image2d<int16_t> out;
+    mln::resize(out, m);
+    for (int y = 0; y < m.height(); ++y)
+      std::copy_n(m.buffer() + y * m.stride(), m.width(), out.buffer() + y * out.stride());
+    return out;
+  }
+
+  // Run both watersheds on copies of the markers and compare the labels
+  bool compare(const mln::image2d<uint8_t>& f, const mln::image2d<int16_t>& markers, int nlabel,
+               const std::string& what)
+  {
+    auto generic = copy_of(markers);
+    auto ours    = copy_of(markers);
+    impl::watershed(f, mln::c4, generic, nlabel);
+    impl::watershed_u8(f, ours, nlabel);
+    return checks::same(ours, generic, what);
+  }
+} // namespace
+
+
+int main(int argc, char** argv)
+{
+  const int    iterations = (argc > 1) ? std::atoi(argv[1]) : 500;
+  std::mt19937 rng(42);
+  int          failures = 0;
+
+  // 1. Random images (few levels make plateaus, where the FIFO order decides the labels and the waterlines)
+  std::uniform_int_distribution<int>    size(1, 150), levels(2, 256), nlabel(1, 50);
+  std::uniform_real_distribution<double> density(0.0001, 0.2);
+  for (int i = 0; i < iterations; ++i)
+  {
+    auto f = checks::random_image(size(rng), size(rng), levels(rng), rng);
+    int  n = nlabel(rng);
+    auto m = random_markers(f.domain(), n, density(rng), rng);
+
+    char what[64];
+    std::snprintf(what, sizeof(what), "watershed #%d (%dx%d)", i, f.width(), f.height());
+    failures += !compare(f, m, n, what);
+  }
+  std::printf("%d random cases: %d failure(s)\n", iterations, failures);
+
+  // 2. Timings on a column-sized image (including the copy of the markers)
+  {
+    auto f = checks::page_image(1000, 3500, rng);
+    auto m = random_markers(f.domain(), 1000, 0.0003, rng);
+    failures += !compare(f, m, 1000, "watershed (page)");
+
+    double generic = checks::time_ms([&] { impl::watershed(f, mln::c4, copy_of(m), 1000); });
+    double ours    = checks::time_ms([&] {
+      auto markers = copy_of(m);
+      impl::watershed_u8(f, markers, 1000);
+    });
+    std::printf("\n1000x3500: generic %.1f ms, watershed_u8 %.1f ms\n", generic, ours);
+  }
+
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <mln/core/image/ndimage.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+
+/// Helpers of the programs that check the optimized operators against Pylene and brute-force definitions
+///
+/// The pixels are accessed relatively to the domain (buffer() + y * stride() + x), so the images can be sub-images.
+namespace checks
+{
+  /// Random image with \p levels gray levels (few levels make plateaus and ties)
+  inline mln::image2d<uint8_t> random_image(int width, int height, int levels, std::mt19937& rng)
+  {
+    mln::image2d<uint8_t>              f(width, height);
+    std::uniform_int_distribution<int> level(0, levels - 1);
+    for (int y = 0; y < height; ++y)
+      for (int x = 0; x < width; ++x)
+        f.buffer()[y * f.stride() + x] = static_cast<uint8_t>(level(rng) * 255 / std::max(levels - 1, 1));
+    return f;
+  }
+
+  /// Image that looks like a page: white background and dark text-like strokes
+  inline mln::image2d<uint8_t> page_image(int width, int height, std::mt19937& rng)
+  {
+    mln::image2d<uint8_t>              f(width, height);
+    std::uniform_int_distribution<int> noise(200, 255);
+    for (int y = 0; y < height; ++y)
+      for (int x = 0; x < width; ++x)
+        f.buffer()[y * f.stride() + x] = static_cast<uint8_t>(noise(rng));
+
+    std::uniform_int_distribution<int> gap(2, 12), len(3, 40), dark(0, 120);
+    for (int y0 = 20; y0 + 20 < height; y0 += 30)
+      for (int x = gap(rng); x + 40 < width; x += len(rng) + gap(rng))
+        for (int y = y0; y < y0 + 14; ++y)
+          for (int i = 0; i < 3; ++i)
+            f.buffer()[y * f.stride() + x + i] = static_cast<uint8_t>(dark(rng));
+    return f;
+  }
+
+  /// Random box included in \p domain
+  inline mln::box2d random_box(mln::box2d domain, std::mt19937& rng)
+  {
+    std::uniform_int_distribution<int> x0(0, domain.width() - 1), y0(0, domain.height() - 1);
+    int                                x = x0(rng), y = y0(rng);
+    std::uniform_int_distribution<int> w(1, domain.width() - x), h(1, domain.height() - y);
+    return mln::box2d(domain.x() + x, domain.y() + y, w(rng), h(rng));
+  }
+
+  /// Compare two images pixel by pixel (print the first difference)
+  template <class T>
+  bool same(const mln::image2d<T>& a, const mln::image2d<T>& b, const std::string& what)
+  {
+    if (a.width() != b.width() || a.height() != b.height())
+    {
+      std::printf("FAILED %s: %dx%d vs %dx%d\n", what.c_str(), a.width(), a.height(), b.width(), b.height());
+      return false;
+    }
+    for (int y = 0; y < a.height(); ++y)
+      for (int x = 0; x < a.width(); ++x)
+      {
+        int va = a.buffer()[y * a.stride() + x];
+        int vb = b.buffer()[y * b.stride() + x];
+        if (va != vb)
+        {
+          std::printf("FAILED %s: (%d,%d) %d vs %d\n", what.c_str(), x, y, va, vb);
+          return false;
+        }
+      }
+    return true;
+  }
+
+  /// Median time of \p runs calls of \p f (in ms)
+  template <class F>
+  double time_ms(F f, int runs = 5)
+  {
+    std::vector<double> t(runs);
+    for (auto& v : t)
+    {
+      auto start = std::chrono::steady_clock::now();
+      f();
+      v = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+    std::nth_element(t.begin(), t.begin() + runs / 2, t.end());
+    return t[runs / 2];
+  }
+} // namespace checks
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+/// Append-only store of the annotated pages of a directory (.annot)
+///
+/// All the integers are little-endian. The file is:
+///
+///   header  : annot_file_header_t
+///   records : annot_record_t + content of the page (json, UTF-8), padded to a multiple of 8 bytes
+///
+/// Saving a page appends a record and then updates the committed size of the header, with a fsync after each step:
+/// the bytes after the committed size (an interrupted write) are ignored and overwritten by the next write. The last
+/// record of a page wins (a record with the REMOVED flag removes the page). The file is compacted (the live records
+/// are copied in a new file that replaces it) when the records that are overwritten take most of the file.
+///
+/// The writes are serialized by a lock on the file (flock), held only for the time of the append, so saving a page
+/// costs the size of the page. The readers do not take the lock: the committed records are never modified.
+namespace AnnotationStore
+{
+  inline constexpr char     kMagic[8] = {'S', 'O', 'D', 'U', 'C', 'O', 'A', 'S'};
+  inline constexpr uint32_t kVersion  = 1;
+
+  /// Flags of a record
+  enum : uint32_t
+  {
+    REMOVED = 1,
+  };
+
+  struct annot_file_header_t
+  {
+    char     magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t committed; // Size of the file that holds complete records
+  };
+
+  struct annot_record_t
+  {
+    int32_t  page_id;
+    uint32_t flags;
+    uint32_t checksum; // CRC-32 of the content
+    uint32_t reserved;
+    uint64_t size; // Size of the content in bytes
+  };
+
+  static_assert(sizeof(annot_file_header_t) == 24);
+  static_assert(sizeof(annot_record_t) == 24);
+
+
+  class Store
+  {
+  public:
+    /// Open the store (it is created if it does not exist)
+    /// \throw std::runtime_error if the file cannot be opened or is not a valid store
+    explicit Store(std::string path);
+    ~Store();
+
+    Store(const Store&) = delete;
+    Store& operator=(const Store&) = delete;
+
+    /// Ids of the pages (sorted)
+    std::vector<int> pages();
+
+    /// Return true if the store has the page
+    bool has_page(int page_id);
+
+    /// Content of the page (std::nullopt if the store does not have the page)
+    /// \throw std::runtime_error if the record is corrupted
+    std::optional<std::string> get(int page_id);
+
+    /// Save the page. Return false (and do nothing) if the page exists and \p overwrite is false.
+    /// \throw std::runtime_error if the record cannot be written
+    bool put(int page_id, std::string_view content, bool overwrite = true);
+
+    /// Remove the page. Return false if the store does not have the page.
+    bool remove(int page_id);
+
+    /// Copy the live records in a new file that replaces the store
+    void compact();
+
+    /// Write the pages in a zip file (entries NNNN.json, not compressed) as saved by the zip saver
+    void export_zip(const std::string& path);
+
+  private:
+    struct entry_t
+    {
+      uint64_t offset; // Offset of the content
+      uint64_t size;
+      uint32_t checksum;
+    };
+
+    void     open_file();
+    void     refresh();
+    void     lock_for_write();
+    void     append(int page_id, std::string_view content, uint32_t flags);
+    void     compact_locked();
+    uint64_t dead_size() const;
+
+    std::string            m_path;
+    int                    m_fd = -1;
+    uint64_t               m_scanned   = 0; // Size of the file that has been indexed
+    uint64_t               m_live_size = 0; // Size of the live records
+    std::map<int, entry_t> m_index;
+    std::mutex             m_mutex;
+  };
+} // namespace AnnotationStore
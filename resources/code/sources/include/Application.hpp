@@ -1,9 +1,12 @@
 #pragma once
 
 #include <DOMTypes.hpp>
+#include <FlatDOM.hpp>
 #include <CoreTypes.hpp>
 #include <mln/core/image/ndimage_fwd.hpp>
 #include <atomic>
+#include <memory>
+#include <span>
 
 struct ApplicationData;
 
@@ -24,10 +27,29 @@ private:
 };
 
 
+/// Engine of the line segmentation
+enum class LineSegmentation
+{
+  WATERSHED,  // Blur, closing and watershed on every column (robust to noise and skew)
+  PROJECTION, // Split the columns at the valleys of their horizontal projection (fast, needs clean columns)
+  AUTO,       // Projection on the columns where its lines are regular, watershed on the others
+};
+
+
+/// Stage of the processing from which a region is processed again (the following stages are run too)
+enum class ProcessingStage
+{
+  LINES,   // Line segmentation of the columns
+  ENTRIES, // Grouping of the lines in entries
+  TEXT,    // OCR of the entries and the titles
+};
+
+
 class Application
 {
 public:
-  Application(std::string uri, int page, Progress* progress, bool deskew_only = false);
+  Application(std::string uri, int page, Progress* progress, bool deskew_only = false,
+              LineSegmentation lines = LineSegmentation::WATERSHED);
   ~Application();
 
 
@@ -40,11 +62,36 @@ public:
   // Return the root document object
   DOMElement*         GetDocument();
 
+  // Return the document in its flat representation (as it was at the end of the processing)
+  const FlatDOM&      GetFlatDocument() const;
+
+
+  // Process again the columns (and the titles for the TEXT stage) that intersect the region (in the coordinates of
+  // the document) from the given stage. The cached images of the page are reused, so it only costs the processing of
+  // the region. The flat document is updated.
+  void                ReprocessRegion(Box region, ProcessingStage from = ProcessingStage::LINES);
+
+  // Replace the document by a corrected one (in the coordinates of the document) and process all its columns again
+  // from the given stage. The stages before the blocks are not run again, so the application can be created with
+  // deskew_only. The boxes are intersected with the page; a box outside the page throws std::invalid_argument.
+  void                SetDocument(std::unique_ptr<DOMElement> document,
+                                  ProcessingStage from = ProcessingStage::ENTRIES);
+
 
   // Return internal application data
   ApplicationData*    GetApplicationData();
 
 private:
+  // Prepare the input of the layout analysis (subsampled deskewed image)
+  void PrepareInput();
+
+  // Run the stages from \p from on the columns and the titles
+  void Reprocess(std::span<DOM::column_level_2* const> columns, std::span<DOMElement* const> titles,
+                 ProcessingStage from);
+
   std::unique_ptr<ApplicationData> m_app_data;
   std::unique_ptr<DOMElement>      m_document;
+  FlatDOM                          m_flat_document;
+  int                              m_scale = 0;
+  LineSegmentation                 m_lines = LineSegmentation::WATERSHED;
 };
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+
+/// Helpers of the binary files made of blocks (.sdom, .gaz)
+///
+/// Such a file is a header, an index with one entry per block and the blocks (each starting on a multiple of 8 bytes
+/// so that the records can be accessed in place). The file is memory-mapped for reading and written at once.
+namespace BlockFile
+{
+  /// Read-only memory map of a whole file
+  class MappedFile
+  {
+  public:
+    /// \param kind Name of the kind of file in the messages (e.g. "gazetteer")
+    /// \throw std::runtime_error if the file cannot be mapped or is smaller than \p min_size
+    MappedFile(const std::string& path, std::size_t min_size, const char* kind);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const std::byte* data() const { return m_data; }
+    std::size_t      size() const { return m_size; }
+
+    /// Log why the file is invalid and throw std::runtime_error
+    [[noreturn]] void invalid(const char* msg) const;
+
+  private:
+    std::string      m_path;
+    const char*      m_kind;
+    const std::byte* m_data = nullptr;
+    std::size_t      m_size = 0;
+  };
+
+
+  /// Append the bytes of a record
+  template <class T>
+  void append(std::string& out, const T& v)
+  {
+    out.append(reinterpret_cast<const char*>(&v), sizeof(T));
+  }
+
+  /// Content of a file: \p header, the index and the blocks. `make_entry(i, offset)` returns the index entry of the
+  /// block i, which starts at \p offset in the file.
+  template <class Header, class MakeEntry>
+  std::string pack(const Header& header, const std::vector<std::string_view>& blocks, MakeEntry make_entry);
+
+
+  /******************************************/
+  /****          Implementation          ****/
+  /******************************************/
+
+  template <class Header, class MakeEntry>
+  std::string pack(const Header& header, const std::vector<std::string_view>& blocks, MakeEntry make_entry)
+  {
+    using entry_t = std::invoke_result_t<MakeEntry, std::size_t, uint64_t>;
+
+    std::string out;
+    append(out, header);
+
+    // The offsets are known once the index is laid out
+    uint64_t offset = sizeof(Header) + blocks.size() * sizeof(entry_t);
+    for (std::size_t i = 0; i < blocks.size(); ++i)
+    {
+      append(out, make_entry(i, offset));
+      offset = (offset + blocks[i].size() + 7) & ~uint64_t(7);
+    }
+    for (auto block : blocks)
+    {
+      out.append(block);
+      out.resize((out.size() + 7) & ~std::size_t(7), '\0');
+    }
+    return out;
+  }
+} // namespace BlockFile
@@ -0,0 +1,161 @@
+#pragma once
+
+#include <BlockFile.hpp>
+#include <DOMTypes.hpp>
+#include <FlatDOM.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+/// Binary format of a directory of page DOMs (.sdom)
+///
+/// All the integers are little-endian. The file is:
+///
+///   header      : dom_file_header_t
+///   index       : dom_page_index_t[num_pages]        (sorted by page id)
+///   pages       : for each page, at index[i].offset:
+///                   dom_page_header_t
+///                   dom_node_record_t[num_nodes]     (in the order of the json array)
+///                   char[strings_size]               (string table, UTF-8)
+///
+/// A node record holds the fields of the json schema of the annotations (id, parent, type, box, text). The other keys
+/// of the json object (and the core fields that do not have the expected type) are stored as a json object in the
+/// string table (extra), so that the conversion from/to json is lossless.
+namespace DOMBinary
+{
+  inline constexpr char     kMagic[8] = {'S', 'O', 'D', 'U', 'C', 'O', 'D', 'M'};
+  inline constexpr uint32_t kVersion  = 1;
+
+  /// Type code of a node whose type is not a DOMCategory (the type is in the extra object)
+  inline constexpr uint8_t kUnknownType = 0xFF;
+
+  /// Fields of a node record that are set
+  enum : uint8_t
+  {
+    HAS_ID     = 1,
+    HAS_PARENT = 2,
+    HAS_TYPE   = 4,
+    HAS_BOX    = 8,
+    HAS_TEXT   = 16,
+  };
+
+  struct dom_file_header_t
+  {
+    char     magic[8];
+    uint32_t version;
+    uint32_t num_pages;
+  };
+
+  struct dom_page_index_t
+  {
+    int32_t  page_id;
+    uint32_t reserved;
+    uint64_t offset; // From the beginning of the file
+    uint64_t size;   // Size of the page block in bytes
+  };
+
+  struct dom_page_header_t
+  {
+    uint32_t num_nodes;
+    uint32_t strings_size;
+  };
+
+  struct dom_node_record_t
+  {
+    int32_t  id;
+    int32_t  parent;
+    int32_t  box[4]; // x, y, width, height
+    uint32_t text_offset, text_size;
+    uint32_t extra_offset, extra_size;
+    uint8_t  type; // DOMCategory (or kUnknownType)
+    uint8_t  flags;
+    uint16_t reserved;
+  };
+
+  static_assert(sizeof(dom_file_header_t) == 16);
+  static_assert(sizeof(dom_page_index_t) == 24);
+  static_assert(sizeof(dom_page_header_t) == 8);
+  static_assert(sizeof(dom_node_record_t) == 44);
+
+
+  /// Read-only view on a page of a mapped file
+  class PageView
+  {
+  public:
+    PageView() = default;
+    PageView(const dom_node_record_t* nodes, std::size_t n, std::string_view strings);
+
+    std::size_t              size() const { return m_size; }
+    const dom_node_record_t& node(std::size_t i) const { return m_nodes[i]; }
+    std::string_view         text(std::size_t i) const;
+    std::string_view         extra(std::size_t i) const;
+
+    /// Rebuild the tree of the page (the nodes are linked with their parent ids; the extra attributes are dropped)
+    /// \throw std::runtime_error if a node has an unknown type or if the parent links do not make a tree (several roots
+    /// or none, parent cycle; see DOMElement::create_tree)
+    std::unique_ptr<DOMElement> to_tree() const;
+
+  private:
+    const dom_node_record_t* m_nodes = nullptr;
+    std::size_t              m_size  = 0;
+    std::string_view         m_strings;
+  };
+
+
+  /// Memory-mapped .sdom file
+  class Reader
+  {
+  public:
+    /// \throw std::runtime_error if the file cannot be mapped or is invalid
+    explicit Reader(const std::string& path);
+
+    /// Ids of the pages (sorted)
+    std::vector<int> pages() const;
+
+    /// Return true if the file has the page
+    bool has_page(int page_id) const;
+
+    /// View on a page (valid as long as the reader)
+    /// \throw std::out_of_range if the file does not have the page
+    PageView page(int page_id) const;
+
+    /// Encoded block of a page (to copy it to a Writer)
+    /// \throw std::out_of_range if the file does not have the page
+    std::string_view page_block(int page_id) const;
+
+  private:
+    const dom_page_index_t* find(int page_id) const;
+
+    BlockFile::MappedFile m_file;
+  };
+
+
+  /// Writer of .sdom files (the pages are kept in memory and written by save())
+  class Writer
+  {
+  public:
+    /// Add (or replace) a page from a document
+    void add_page(int page_id, const FlatDOM& doc);
+
+    /// Add (or replace) a page from an encoded page block (e.g. copied from another file)
+    void add_page_block(int page_id, std::string block);
+
+    /// Add the pages of a file that are not in the writer (the pages of the writer are kept: they are the newer ones)
+    void merge(const Reader& file);
+
+    /// Write the file (the file is written in a temporary file with a unique name then renamed). The file is not
+    /// locked: a caller that updates an existing file holds the lock of the file (`<path>.lock`) from the read to the
+    /// write, as the python saver does.
+    /// \throw std::runtime_error if the file cannot be written
+    void save(const std::string& path) const;
+
+  private:
+    std::map<int, std::string> m_pages; // Page id -> page block
+  };
+} // namespace DOMBinary
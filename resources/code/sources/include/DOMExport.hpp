@@ -0,0 +1,16 @@
+#pragma once
+#include <DOMTypes.hpp>
+#include <FlatDOM.hpp>
+#include <ostream>
+#include <string>
+
+/// Export a document as a json array of elements (ids are 256 + the index of the element in document order)
+///
+/// The elements are written to the output as the document is scanned (no intermediate json document).
+/// \{
+void DOMExport(const FlatDOM& doc, std::ostream& out);
+void DOMExport(const FlatDOM& doc, const std::string& path);
+void DOMExport(const DOMElement* doc, const std::string& path);
+
+std::string DOMExportToString(const FlatDOM& doc);
+/// \}
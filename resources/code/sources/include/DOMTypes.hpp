@@ -1,6 +1,8 @@
 #pragma once
 
+#include <cstddef>
 #include <memory>
+#include <type_traits>
 #include <vector>
 #include <string_view>
 
@@ -20,6 +22,9 @@ enum class DOMCategory
   //WORD,
 };
 
+/// Name of a category (e.g. "COLUMN_LEVEL_1")
+std::string_view to_string(DOMCategory cat);
+
 
 namespace DOM
 {
@@ -48,11 +53,12 @@ class DOMElement
 {
 protected:
   /// Constructor made private
-  DOMElement() = default;
+  explicit DOMElement(DOMCategory cat) : m_category{cat} {}
 
 public:
   DOMElement(DOMElement&&) = default;
   DOMElement& operator= (DOMElement&&) = default;
+  virtual ~DOMElement() = default;
 
 
   /// Factory
@@ -60,6 +66,13 @@ public:
   static std::unique_ptr<DOMElement> create_document(Box roi);
   static std::unique_ptr<DOMElement> create_node(DOMCategory cat);
   static std::unique_ptr<DOMElement> create_node(std::string_view cat);
+
+  /// Link \p nodes into a tree: \p parents[i] is the position of the parent of nodes[i] in \p nodes (-1 for the root)
+  /// and the siblings keep the order of \p nodes. The links are checked before any node is attached.
+  /// \throw std::invalid_argument if there is not exactly one root, if a parent is invalid, or if a node is its own
+  /// ancestor or is not reachable from the root (parent cycle)
+  static std::unique_ptr<DOMElement> create_tree(std::vector<std::unique_ptr<DOMElement>> nodes,
+                                                 const std::vector<int>& parents);
   /// \}
 
   /// Modifiers
@@ -87,7 +100,7 @@ public:
   bool has_children() const;
   /// \}
 
-  virtual DOMCategory      type() const = 0;
+  DOMCategory              type() const { return m_category; }
   std::string_view         type_str() const;
 
 public:
@@ -97,6 +110,8 @@ public:
 private:
   friend class DOMElementVisitor;
   friend class DOMConstElementVisitor;
+
+  DOMCategory m_category;
 };
 
 
@@ -138,26 +153,35 @@ namespace DOM
   struct TextualElement : DOMElement
   {
     std::string text;
+
+  protected:
+    using DOMElement::DOMElement;
   };
 
 
   struct page : DOMElement
   {
-    virtual DOMCategory      type() const final { return DOMCategory::PAGE; }
+    static constexpr DOMCategory category = DOMCategory::PAGE;
+    page() : DOMElement(category) {}
+
     virtual void             accept(DOMElementVisitor& vis, void* extra) final { vis.visit(this, extra); }
     virtual void             accept(DOMConstElementVisitor& vis, void* extra) const final { vis.visit(this, extra); }
   };
 
   struct title_level_1 : TextualElement
   {
-    virtual DOMCategory      type() const final { return DOMCategory::TITLE_LEVEL_1; }
+    static constexpr DOMCategory category = DOMCategory::TITLE_LEVEL_1;
+    title_level_1() : TextualElement(category) {}
+
     virtual void             accept(DOMElementVisitor& vis, void* extra) final { vis.visit(this, extra); }
     virtual void             accept(DOMConstElementVisitor& vis, void* extra) const final { vis.visit(this, extra); }
   };
 
   struct title_level_2 : TextualElement
   {
-    virtual DOMCategory      type() const final { return DOMCategory::TITLE_LEVEL_2; }
+    static constexpr DOMCategory category = DOMCategory::TITLE_LEVEL_2;
+    title_level_2() : TextualElement(category) {}
+
     virtual void             accept(DOMElementVisitor& vis, void* extra) final { vis.visit(this, extra); }
     virtual void             accept(DOMConstElementVisitor& vis, void* extra) const final { vis.visit(this, extra); }
   };
@@ -165,49 +189,138 @@ namespace DOM
 
   struct section_level_1 : DOMElement
   {
-    virtual DOMCategory      type() const final { return DOMCategory::SECTION_LEVEL_1; }
+    static constexpr DOMCategory category = DOMCategory::SECTION_LEVEL_1;
+    section_level_1() : DOMElement(category) {}
+
     virtual void             accept(DOMElementVisitor& vis, void* extra) final { vis.visit(this, extra); }
     virtual void             accept(DOMConstElementVisitor& vis, void* extra) const final { vis.visit(this, extra); }
   };
 
   struct section_level_2 : DOMElement
   {
-    virtual DOMCategory      type() const final { return DOMCategory::SECTION_LEVEL_2; }
+    static constexpr DOMCategory category = DOMCategory::SECTION_LEVEL_2;
+    section_level_2() : DOMElement(category) {}
+
     virtual void             accept(DOMElementVisitor& vis, void* extra) final { vis.visit(this, extra); }
     virtual void             accept(DOMConstElementVisitor& vis, void* extra) const final { vis.visit(this, extra); }
   };
 
   struct column_level_1 : DOMElement
   {
-    virtual DOMCategory      type() const final { return DOMCategory::COLUMN_LEVEL_1; }
+    static constexpr DOMCategory category = DOMCategory::COLUMN_LEVEL_1;
+    column_level_1() : DOMElement(category) {}
+
     virtual void             accept(DOMElementVisitor& vis, void* extra) final { vis.visit(this, extra); }
     virtual void             accept(DOMConstElementVisitor& vis, void* extra) const final { vis.visit(this, extra); }
   };
 
   struct column_level_2 : DOMElement
   {
-    virtual DOMCategory      type() const final { return DOMCategory::COLUMN_LEVEL_2; }
+    static constexpr DOMCategory category = DOMCategory::COLUMN_LEVEL_2;
+    column_level_2() : DOMElement(category) {}
+
     virtual void             accept(DOMElementVisitor& vis, void* extra) final { vis.visit(this, extra); }
     virtual void             accept(DOMConstElementVisitor& vis, void* extra) const final { vis.visit(this, extra); }
   };
 
   struct entry : TextualElement
   {
-    virtual DOMCategory      type() const final { return DOMCategory::ENTRY; }
+    static constexpr DOMCategory category = DOMCategory::ENTRY;
+    entry() : TextualElement(category) {}
+
     virtual void             accept(DOMElementVisitor& vis, void* extra) final { vis.visit(this, extra); }
     virtual void             accept(DOMConstElementVisitor& vis, void* extra) const final { vis.visit(this, extra); }
   };
 
   struct line : TextualElement
   {
-    virtual DOMCategory      type() const final { return DOMCategory::LINE; }
+    static constexpr DOMCategory category = DOMCategory::LINE;
+    line() : TextualElement(category) {}
+
     virtual void             accept(DOMElementVisitor& vis, void* extra) final { vis.visit(this, extra); }
     virtual void             accept(DOMConstElementVisitor& vis, void* extra) const final { vis.visit(this, extra); }
 
-    int  label;
-    bool indented;
-    bool reach_EOL;
+    int  label     = 0;
+    bool indented  = false;
+    bool reach_EOL = false;
   };
 
 
 } // namespace sections
+
+
+/// Visitor with static dispatch
+///
+/// The node type is resolved by a switch on the category (no virtual call) and the visit functions of the derived
+/// class are called directly, so they can be inlined. Derived defines visit(N* e, Context ctx) for the node types N it
+/// handles (a template overload can serve as a fallback) and the nodes without a matching visit are recursed into with
+/// the same context. Element is DOMElement or const DOMElement; Context is a typed state passed by value to every
+/// visit (e.g. the depth or the index of the parent).
+///
+///   struct LineCounter : DOMStaticVisitor<LineCounter, const DOMElement>
+///   {
+///     int  count = 0;
+///     void visit(const DOM::line*, std::nullptr_t) { count++; }
+///   };
+///
+///   LineCounter viz;
+///   viz.traverse(document);
+template <class Derived, class Element = DOMElement, class Context = std::nullptr_t>
+class DOMStaticVisitor
+{
+public:
+  /// Visit the element \p e
+  void traverse(Element* e, Context ctx = {}) { dispatch(e, ctx); }
+
+  /// Call the visit function of the derived class that matches the type of \p e
+  void dispatch(Element* e, Context ctx);
+
+  /// Visit the children of \p e
+  void recurse(Element* e, Context ctx)
+  {
+    for (auto& c : e->children)
+      dispatch(c.get(), ctx);
+  }
+
+private:
+  template <class Node>
+  void call(Element* e, Context ctx);
+};
+
+
+/******************************************/
+/****          Implementation          ****/
+/******************************************/
+
+template <class Derived, class Element, class Context>
+template <class Node>
+void DOMStaticVisitor<Derived, Element, Context>::call(Element* e, Context ctx)
+{
+  using N = std::conditional_t<std::is_const_v<Element>, const Node, Node>;
+
+  auto* node = static_cast<N*>(e);
+  auto& self = static_cast<Derived&>(*this);
+  if constexpr (requires(Derived& d, N* n, Context c) { d.visit(n, c); })
+    self.visit(node, ctx);
+  else
+    this->recurse(e, ctx);
+}
+
+template <class Derived, class Element, class Context>
+void DOMStaticVisitor<Derived, Element, Context>::dispatch(Element* e, Context ctx)
+{
+  // clang-format off
+  switch (e->type())
+  {
+  case DOMCategory::PAGE:              return call<DOM::page>(e, ctx);
+  case DOMCategory::TITLE_LEVEL_1:     return call<DOM::title_level_1>(e, ctx);
+  case DOMCategory::TITLE_LEVEL_2:     return call<DOM::title_level_2>(e, ctx);
+  case DOMCategory::SECTION_LEVEL_1:   return call<DOM::section_level_1>(e, ctx);
+  case DOMCategory::SECTION_LEVEL_2:   return call<DOM::section_level_2>(e, ctx);
+  case DOMCategory::COLUMN_LEVEL_1:    return call<DOM::column_level_1>(e, ctx);
+  case DOMCategory::COLUMN_LEVEL_2:    return call<DOM::column_level_2>(e, ctx);
+  case DOMCategory::ENTRY:             return call<DOM::entry>(e, ctx);
+  case DOMCategory::LINE:              return call<DOM::line>(e, ctx);
+  }
+  // clang-format on
+}
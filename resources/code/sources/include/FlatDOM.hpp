@@ -0,0 +1,88 @@
+#pragma once
+
+#include <DOMTypes.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+/// Read-only DOM stored in contiguous arrays
+///
+/// The nodes are numbered in pre-order (document order) from the root (0), so the subtree of the node i is the range
+/// [i, end(i)) and a traversal of the document is a loop over the indices. Every attribute is stored in its own array
+/// and the texts are packed in a single arena. It is built from the tree once the processing is done and is the
+/// representation used by the exports.
+class FlatDOM
+{
+public:
+  static constexpr int32_t kNone = -1;
+
+  /// Flags of a LINE
+  enum : uint8_t
+  {
+    INDENTED  = 1,
+    REACH_EOL = 2,
+  };
+
+  FlatDOM() = default;
+
+  /// Flatten a document
+  explicit FlatDOM(const DOMElement* document);
+
+  /// Rebuild the tree (e.g. to run the visitors)
+  std::unique_ptr<DOMElement> to_tree() const;
+
+  /// Number of nodes
+  int  size() const { return static_cast<int>(m_type.size()); }
+  bool empty() const { return m_type.empty(); }
+
+  /// Attributes of the node i
+  /// \{
+  DOMCategory      type(int i) const { return m_type[i]; }
+  std::string_view type_str(int i) const;
+  const Box&       bbox(int i) const { return m_bbox[i]; }
+  int32_t          parent(int i) const { return m_parent[i]; }
+  int32_t          first_child(int i) const { return m_first_child[i]; }
+  int32_t          next_sibling(int i) const { return m_next_sibling[i]; }
+  int32_t          end(int i) const { return m_end[i]; } ///< One past the last node of the subtree
+  std::string_view text(int i) const;                     ///< Empty if the node is not textual
+  int32_t          label(int i) const { return m_label[i]; }
+  uint8_t          flags(int i) const { return m_flags[i]; }
+  /// \}
+
+  /// Columns (one value per node)
+  /// \{
+  std::span<const DOMCategory> types() const { return m_type; }
+  std::span<const Box>         bboxes() const { return m_bbox; }
+  std::span<const int32_t>     parents() const { return m_parent; }
+  std::span<const int32_t>     labels() const { return m_label; }
+  std::span<const uint8_t>     line_flags() const { return m_flags; }
+  std::span<const uint32_t>    text_offsets() const { return m_text_offsets; } ///< size() + 1 offsets in text_arena()
+  std::string_view             text_arena() const { return m_text; }
+  /// \}
+
+  /// Nodes in post-order (the children before their parent)
+  std::vector<int32_t> post_order() const;
+
+  /// Scale the bounding boxes by the given factor
+  void scale(float s);
+
+  /// Return true if the elements of this category have a text
+  static bool is_textual(DOMCategory cat);
+
+private:
+  std::vector<DOMCategory> m_type;
+  std::vector<Box>         m_bbox;
+  std::vector<int32_t>     m_parent;
+  std::vector<int32_t>     m_first_child;
+  std::vector<int32_t>     m_next_sibling;
+  std::vector<int32_t>     m_end;
+  std::vector<int32_t>     m_label;
+  std::vector<uint8_t>     m_flags;
+  std::vector<uint32_t>    m_text_offsets;
+  std::string              m_text;
+};
@@ -0,0 +1,155 @@
+#pragma once
+
+#include <BlockFile.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+/// Compiled gazetteer of the street names (.gaz)
+///
+/// The file holds several dictionaries (word -> value, e.g. the normalized street name -> its typography) and is
+/// memory-mapped so that the processes share it. All the integers are little-endian. The file is:
+///
+///   header      : gaz_file_header_t
+///   index       : gaz_dict_index_t[num_dicts]
+///   dictionaries: for each dictionary, at index[i].offset:
+///                   gaz_dict_header_t
+///                   gaz_word_record_t[num_words]     (sorted by word)
+///                   gaz_node_record_t[num_nodes]     (trie of the words, the children of a node are contiguous and
+///                                                     sorted by code point, the root is the first node)
+///                   char[strings_size]               (string table, UTF-8)
+namespace Gazetteer
+{
+  inline constexpr char     kMagic[8] = {'S', 'O', 'D', 'U', 'C', 'O', 'G', 'Z'};
+  inline constexpr uint32_t kVersion  = 2;
+
+  struct gaz_file_header_t
+  {
+    char     magic[8];
+    uint32_t version;
+    uint32_t num_dicts;
+  };
+
+  struct gaz_dict_index_t
+  {
+    uint64_t offset; // From the beginning of the file
+    uint64_t size;   // Size of the dictionary block in bytes
+  };
+
+  struct gaz_dict_header_t
+  {
+    uint32_t num_words;
+    uint32_t num_nodes;
+    uint32_t strings_size;
+    uint32_t max_word_length; // Length of the longest word (in code points)
+  };
+
+  struct gaz_word_record_t
+  {
+    uint32_t word_offset, word_size;
+    uint32_t value_offset, value_size;
+  };
+
+  struct gaz_node_record_t
+  {
+    uint32_t first_child;
+    uint32_t num_children;
+    uint32_t cp;   // Code point of the edge from the parent
+    int32_t  word; // Index of the word ending at this node (-1 if none)
+  };
+
+  static_assert(sizeof(gaz_file_header_t) == 16);
+  static_assert(sizeof(gaz_dict_index_t) == 16);
+  static_assert(sizeof(gaz_dict_header_t) == 16);
+  static_assert(sizeof(gaz_word_record_t) == 16);
+  static_assert(sizeof(gaz_node_record_t) == 16);
+
+
+  struct match_t
+  {
+    std::string_view word;
+    int              distance; // Levenshtein distance (in code points)
+    int              count;    // Number of words at this distance (ambiguity)
+  };
+
+
+  /// Read-only view on a dictionary of a mapped file
+  class Dictionary
+  {
+  public:
+    Dictionary() = default;
+    explicit Dictionary(const gaz_dict_header_t* header);
+
+    std::size_t size() const { return m_num_words; }
+
+    /// Length of the longest word (in code points). A word longer than max_word_length() + max_distance has no match
+    /// (the distance is at least the difference of the lengths).
+    std::size_t max_word_length() const { return m_max_word_length; }
+    std::string_view word(std::size_t i) const;
+    std::string_view value(std::size_t i) const;
+
+    /// Return true if the dictionary has the word
+    bool contains(std::string_view word) const;
+
+    /// Value of the word (std::nullopt if the dictionary does not have the word)
+    std::optional<std::string_view> get(std::string_view word) const;
+
+    /// Closest word at a distance of at most max_distance (the first in lexicographic order among the words at the
+    /// same distance), std::nullopt if there is none
+    std::optional<match_t> best_match(std::string_view word, int max_distance) const;
+
+    /// Same as best_match for several words (in parallel)
+    std::vector<std::optional<match_t>> best_matches(std::span<const std::string> words, int max_distance) const;
+
+  private:
+    int find(std::string_view word) const;
+
+    const gaz_word_record_t* m_words           = nullptr;
+    const gaz_node_record_t* m_nodes           = nullptr;
+    const char*              m_strings         = nullptr;
+    std::size_t              m_num_words       = 0;
+    std::size_t              m_max_word_length = 0;
+  };
+
+
+  /// Memory-mapped .gaz file
+  class Reader
+  {
+  public:
+    /// \throw std::runtime_error if the file cannot be mapped or is invalid
+    explicit Reader(const std::string& path);
+
+    /// Number of dictionaries
+    std::size_t size() const;
+
+    /// View on a dictionary (valid as long as the reader)
+    /// \throw std::out_of_range if the file does not have the dictionary
+    Dictionary dictionary(std::size_t i) const;
+
+  private:
+    BlockFile::MappedFile m_file;
+  };
+
+
+  /// Writer of .gaz files
+  class Writer
+  {
+  public:
+    /// Add a dictionary (word -> value)
+    void add_dictionary(const std::map<std::string, std::string>& entries);
+
+    /// Write the file (the file is written in a temporary file then renamed)
+    /// \throw std::runtime_error if the file cannot be written
+    void save(const std::string& path) const;
+
+  private:
+    std::vector<std::string> m_dicts; // Dictionary blocks
+  };
+} // namespace Gazetteer
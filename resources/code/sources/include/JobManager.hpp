@@ -0,0 +1,98 @@
+#pragma once
+
+#include <Application.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+/// Options of the processing of a page (same as the Application constructor)
+struct JobOptions
+{
+  bool             deskew_only = false;
+  LineSegmentation lines       = LineSegmentation::WATERSHED;
+};
+
+
+/// Processing of pages in background threads
+///
+/// A job runs the whole pipeline (the Application constructor) on a page. Its progress is kept in atomics, so the
+/// status can be polled from any thread at any time without callbacks. The jobs are processed in submission order by
+/// a fixed number of workers (each pipeline is already parallel, see ThreadPool).
+///
+/// The finished jobs (done, failed or canceled) are kept until their result is taken. The ones that are never taken
+/// are released after a delay, and the oldest ones are released when there are too many (this is applied when a job
+/// is submitted or polled).
+class JobManager
+{
+public:
+  enum class State
+  {
+    PENDING,  // Waiting for a worker
+    RUNNING,  // Being processed
+    DONE,     // The result is available
+    FAILED,   // The pipeline has thrown (see Status::error)
+    CANCELED, // Canceled before the end of the processing
+  };
+
+  struct Status
+  {
+    State       state;
+    int         progress; // In pourcent (range 0-100)
+    std::string error;    // Message of the exception of a failed job
+  };
+
+  /// \param workers Number of jobs processed at the same time
+  /// \param ttl Delay after which a finished job is released
+  /// \param max_finished Maximal number of finished jobs kept
+  explicit JobManager(int workers = 1, std::chrono::seconds ttl = std::chrono::minutes(30),
+                      std::size_t max_finished = 256);
+
+  /// Cancel the jobs and wait for the workers
+  ~JobManager();
+
+  JobManager(const JobManager&) = delete;
+  JobManager& operator=(const JobManager&) = delete;
+
+  /// Queue the processing of a page and return the id of the job
+  int submit(std::string uri, int page, JobOptions options = {});
+
+  /// Current status of a job (the expired jobs are released first)
+  /// \throw std::out_of_range if the job does not exist
+  Status status(int job_id);
+
+  /// Take the result of a finished job (the job is released). Return nullptr if the job is not finished.
+  /// \throw std::out_of_range if the job does not exist
+  /// \throw std::runtime_error if the job has failed or has been canceled (the job is released)
+  std::unique_ptr<Application> result(int job_id);
+
+  /// Cancel a pending or running job (a running job stops at the next step of the pipeline). A job that is already
+  /// finished is released. Return false if the job does not exist.
+  bool cancel(int job_id);
+
+private:
+  struct Job;
+
+  void worker_loop();
+
+  // Release the finished jobs that have expired or are in excess (with the mutex locked)
+  void evict();
+
+  mutable std::mutex                  m_mutex;
+  std::condition_variable             m_cv;
+  std::map<int, std::shared_ptr<Job>> m_jobs;
+  std::deque<std::shared_ptr<Job>>    m_queue;
+  std::vector<std::thread>            m_workers;
+  std::chrono::seconds                m_ttl;
+  std::size_t                         m_max_finished;
+  int                                 m_next_id = 1;
+  bool                                m_stop    = false;
+};
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+/// Native implementation of the text processing of the entry parser (back/Parser2.py)
+///
+/// The functions give the same results as their python counterparts for the texts made of ASCII, Latin-1 and the usual
+/// typographic characters (the characters of the directories). A text with another character is not handled (the
+/// result is std::nullopt) and must be processed by the python implementation.
+namespace TextNormalize
+{
+  struct options_t
+  {
+    bool force_ascii  = false; ///< Replace the non-ASCII characters (as unidecode)
+    bool block        = false; ///< Remove the linebreaks
+    bool remove_abbrv = false; ///< Replace the abbreviations
+    bool strip_dashes = true;  ///< Replace the dashes by spaces
+  };
+
+  /// Same as text_normalize()
+  std::optional<std::string> normalize(std::string_view text, const options_t& opts);
+
+  /// Same as _split_fields()
+  std::optional<std::vector<std::string>> split_fields(std::string_view text);
+
+  /// Normalize every text in parallel
+  std::vector<std::optional<std::string>> normalize(std::span<const std::string> texts, const options_t& opts);
+
+  /// Normalize (as the entry parser) and split every entry in parallel
+  std::vector<std::optional<std::vector<std::string>>> split_entries(std::span<const std::string> texts);
+} // namespace TextNormalize
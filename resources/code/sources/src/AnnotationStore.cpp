@@ -0,0 +1,451 @@
+#include <AnnotationStore.hpp>
+
+#include "file_io.hpp"
+
+#include <fmt/format.h>
+#include <spdlog/spdlog.h>
+#include <array>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+namespace AnnotationStore
+{
+  namespace
+  {
+    // The store is compacted when the overwritten records take more space than the live ones (and this threshold)
+    constexpr uint64_t kCompactionMinDeadSize = 1 << 20;
+
+    [[noreturn]] void invalid_file(const std::string& path, const char* msg)
+    {
+      spdlog::error("Invalid annotation store '{}': {}", path, msg);
+      throw std::runtime_error("Invalid annotation store (see logs)");
+    }
+
+    [[noreturn]] void io_error(const std::string& path, const char* what)
+    {
+      spdlog::error("Unable to {} the annotation store '{}' ({})", what, path, std::strerror(errno));
+      throw std::runtime_error("I/O error on the annotation store (see logs)");
+    }
+
+    uint64_t padded(uint64_t n)
+    {
+      return (n + 7) & ~uint64_t(7);
+    }
+
+    // CRC-32 (same as zlib/zip)
+    uint32_t crc32(std::string_view data)
+    {
+      static const auto table = [] {
+        std::array<uint32_t, 256> t;
+        for (uint32_t i = 0; i < 256; ++i)
+        {
+          uint32_t c = i;
+          for (int k = 0; k < 8; ++k)
+            c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : (c >> 1);
+          t[i] = c;
+        }
+        return t;
+      }();
+
+      uint32_t c = 0xFFFFFFFFu;
+      for (unsigned char x : data)
+        c = table[(c ^ x) & 0xFF] ^ (c >> 8);
+      return c ^ 0xFFFFFFFFu;
+    }
+
+    bool read_at(int fd, void* buf, std::size_t n, uint64_t offset)
+    {
+      auto* p = static_cast<char*>(buf);
+      while (n > 0)
+      {
+        ssize_t r = ::pread(fd, p, n, offset);
+        if (r <= 0)
+          return false;
+        p += r;
+        n -= r;
+        offset += r;
+      }
+      return true;
+    }
+
+    bool write_at(int fd, const void* buf, std::size_t n, uint64_t offset)
+    {
+      auto* p = static_cast<const char*>(buf);
+      while (n > 0)
+      {
+        ssize_t r = ::pwrite(fd, p, n, offset);
+        if (r <= 0)
+          return false;
+        p += r;
+        n -= r;
+        offset += r;
+      }
+      return true;
+    }
+
+    // Return true if the path still refers to the open file (it is replaced by the compaction)
+    bool same_file(int fd, const std::string& path)
+    {
+      struct stat a, b;
+      return ::fstat(fd, &a) == 0 && ::stat(path.c_str(), &b) == 0 && a.st_dev == b.st_dev && a.st_ino == b.st_ino;
+    }
+
+    // Make the rename of a file durable
+    void sync_directory(const std::string& path)
+    {
+      auto dir = std::filesystem::path(path).parent_path();
+      int  fd  = ::open(dir.empty() ? "." : dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+      if (fd >= 0)
+      {
+        ::fsync(fd);
+        ::close(fd);
+      }
+    }
+
+    template <class T>
+    void put_le(std::string& out, T v)
+    {
+      out.append(reinterpret_cast<const char*>(&v), sizeof(T));
+    }
+  } // namespace
+
+
+  Store::Store(std::string path)
+    : m_path{std::move(path)}
+  {
+    open_file();
+  }
+
+  Store::~Store()
+  {
+    if (m_fd >= 0)
+      ::close(m_fd);
+  }
+
+  void Store::open_file()
+  {
+    if (m_fd >= 0)
+      ::close(m_fd);
+    m_index.clear();
+    m_live_size = 0;
+
+    m_fd = ::open(m_path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (m_fd < 0)
+      io_error(m_path, "open");
+
+    // Initialize a new store (another process may be doing the same)
+    struct stat st;
+    if (::fstat(m_fd, &st) == 0 && st.st_size == 0)
+    {
+      ::flock(m_fd, LOCK_EX);
+      if (::fstat(m_fd, &st) == 0 && st.st_size == 0)
+      {
+        annot_file_header_t h = {};
+        std::memcpy(h.magic, kMagic, sizeof(kMagic));
+        h.version   = kVersion;
+        h.committed = sizeof(annot_file_header_t);
+        if (!write_at(m_fd, &h, sizeof(h), 0) || ::fsync(m_fd) != 0)
+        {
+          ::flock(m_fd, LOCK_UN);
+          io_error(m_path, "initialize");
+        }
+      }
+      ::flock(m_fd, LOCK_UN);
+    }
+
+    annot_file_header_t h;
+    if (!read_at(m_fd, &h, sizeof(h), 0))
+      invalid_file(m_path, "file too small");
+    if (std::memcmp(h.magic, kMagic, sizeof(kMagic)) != 0)
+      invalid_file(m_path, "bad magic number");
+    if (h.version != kVersion)
+      invalid_file(m_path, "unsupported version");
+
+    m_scanned = sizeof(annot_file_header_t);
+    refresh();
+  }
+
+  void Store::refresh()
+  {
+    if (!same_file(m_fd, m_path))
+    {
+      open_file();
+      return;
+    }
+
+    // Index the records committed by the other writers
+    uint64_t committed;
+    if (!read_at(m_fd, &committed, sizeof(committed), offsetof(annot_file_header_t, committed)))
+      invalid_file(m_path, "file too small");
+
+    while (m_scanned < committed)
+    {
+      annot_record_t r;
+      if (m_scanned + sizeof(r) > committed || !read_at(m_fd, &r, sizeof(r), m_scanned))
+        invalid_file(m_path, "truncated record");
+      uint64_t end = m_scanned + sizeof(r) + padded(r.size);
+      if (r.size > committed || end > committed)
+        invalid_file(m_path, "truncated record");
+
+      if (auto it = m_index.find(r.page_id); it != m_index.end())
+      {
+        m_live_size -= sizeof(r) + padded(it->second.size);
+        m_index.erase(it);
+      }
+      if (!(r.flags & REMOVED))
+      {
+        m_index[r.page_id] = {m_scanned + sizeof(r), r.size, r.checksum};
+        m_live_size += sizeof(r) + padded(r.size);
+      }
+      m_scanned = end;
+    }
+  }
+
+  void Store::lock_for_write()
+  {
+    while (true)
+    {
+      if (::flock(m_fd, LOCK_EX) != 0)
+        io_error(m_path, "lock");
+      if (same_file(m_fd, m_path))
+        break;
+      // Compacted while waiting for the lock
+      ::flock(m_fd, LOCK_UN);
+      open_file();
+    }
+    refresh();
+  }
+
+  uint64_t Store::dead_size() const
+  {
+    return m_scanned - sizeof(annot_file_header_t) - m_live_size;
+  }
+
+  void Store::append(int page_id, std::string_view content, uint32_t flags)
+  {
+    annot_record_t r = {};
+    r.page_id        = page_id;
+    r.flags          = flags;
+    r.checksum       = crc32(content);
+    r.size           = content.size();
+
+    std::string buf;
+    buf.reserve(sizeof(r) + padded(content.size()));
+    buf.append(reinterpret_cast<const char*>(&r), sizeof(r));
+    buf.append(content);
+    buf.resize(sizeof(r) + padded(content.size()), '\0');
+
+    // The record is written after the committed records (over an interrupted write if any), then committed
+    uint64_t committed = m_scanned + buf.size();
+    if (!write_at(m_fd, buf.data(), buf.size(), m_scanned) || ::fdatasync(m_fd) != 0)
+      io_error(m_path, "write");
+    if (!write_at(m_fd, &committed, sizeof(committed), offsetof(annot_file_header_t, committed)) ||
+        ::fdatasync(m_fd) != 0)
+      io_error(m_path, "commit");
+    refresh();
+  }
+
+  std::vector<int> Store::pages()
+  {
+    std::lock_guard lock(m_mutex);
+    refresh();
+
+    std::vector<int> ids;
+    ids.reserve(m_index.size());
+    for (const auto& [id, e] : m_index)
+      ids.push_back(id);
+    return ids;
+  }
+
+  bool Store::has_page(int page_id)
+  {
+    std::lock_guard lock(m_mutex);
+    refresh();
+    return m_index.count(page_id) > 0;
+  }
+
+  std::optional<std::string> Store::get(int page_id)
+  {
+    std::lock_guard lock(m_mutex);
+    refresh();
+
+    auto it = m_index.find(page_id);
+    if (it == m_index.end())
+      return std::nullopt;
+
+    std::string content(it->second.size, '\0');
+    if (!read_at(m_fd, content.data(), content.size(), it->second.offset) || crc32(content) != it->second.checksum)
+    {
+      spdlog::error("Corrupted record of the page {} in the annotation store '{}'", page_id, m_path);
+      throw std::runtime_error("Corrupted annotation store (see logs)");
+    }
+    return content;
+  }
+
+  bool Store::put(int page_id, std::string_view content, bool overwrite)
+  {
+    std::lock_guard lock(m_mutex);
+    lock_for_write();
+    try
+    {
+      if (!overwrite && m_index.count(page_id))
+      {
+        ::flock(m_fd, LOCK_UN);
+        return false;
+      }
+      append(page_id, content, 0);
+      if (dead_size() > m_live_size && dead_size() > kCompactionMinDeadSize)
+        compact_locked();
+    }
+    catch (...)
+    {
+      ::flock(m_fd, LOCK_UN);
+      throw;
+    }
+    ::flock(m_fd, LOCK_UN);
+    return true;
+  }
+
+  bool Store::remove(int page_id)
+  {
+    std::lock_guard lock(m_mutex);
+    lock_for_write();
+    bool found = m_index.count(page_id) > 0;
+    try
+    {
+      if (found)
+        append(page_id, {}, REMOVED);
+    }
+    catch (...)
+    {
+      ::flock(m_fd, LOCK_UN);
+      throw;
+    }
+    ::flock(m_fd, LOCK_UN);
+    return found;
+  }
+
+  void Store::compact()
+  {
+    std::lock_guard lock(m_mutex);
+    lock_for_write();
+    try
+    {
+      compact_locked();
+    }
+    catch (...)
+    {
+      ::flock(m_fd, LOCK_UN);
+      throw;
+    }
+    ::flock(m_fd, LOCK_UN);
+  }
+
+  // The lock on the file is held: the new file is written aside then renamed (see replace_file), so that the readers
+  // keep a consistent view on the old file and the writers waiting for the lock reopen the new one.
+  void Store::compact_locked()
+  {
+    annot_file_header_t h = {};
+    std::memcpy(h.magic, kMagic, sizeof(kMagic));
+    h.version   = kVersion;
+    h.committed = sizeof(h) + m_live_size;
+
+    std::string data(reinterpret_cast<const char*>(&h), sizeof(h));
+    data.reserve(h.committed);
+    for (const auto& [id, e] : m_index)
+    {
+      annot_record_t r = {};
+      r.page_id        = id;
+      r.checksum       = e.checksum;
+      r.size           = e.size;
+
+      std::size_t start = data.size();
+      data.append(reinterpret_cast<const char*>(&r), sizeof(r));
+      data.resize(start + sizeof(r) + padded(e.size), '\0');
+      if (!read_at(m_fd, data.data() + start + sizeof(r), e.size, e.offset))
+        io_error(m_path, "read");
+    }
+    replace_file(m_path, data);
+    sync_directory(m_path);
+
+    // The lock is released with the old file
+    open_file();
+  }
+
+  void Store::export_zip(const std::string& path)
+  {
+    std::lock_guard lock(m_mutex);
+    refresh();
+
+    if (m_index.size() > 0xFFFF)
+      throw std::runtime_error("Too many pages for a zip file");
+
+    std::string data;
+    std::string central;
+    uint64_t    offset = 0;
+
+    // Entries without compression (as written by the zip saver), with the date 1980-01-01
+    for (const auto& [id, e] : m_index)
+    {
+      std::string content(e.size, '\0');
+      if (!read_at(m_fd, content.data(), content.size(), e.offset) || crc32(content) != e.checksum)
+      {
+        spdlog::error("Corrupted record of the page {} in the annotation store '{}'", id, m_path);
+        throw std::runtime_error("Corrupted annotation store (see logs)");
+      }
+      if (offset + content.size() > 0xFFFFFFFFu)
+        throw std::runtime_error("The pages are too large for a zip file");
+
+      auto        name = fmt::format("{:04}.json", id);
+      std::string local;
+      put_le<uint32_t>(local, 0x04034b50);
+      put_le<uint16_t>(local, 20);   // Version needed
+      put_le<uint16_t>(local, 0);    // Flags
+      put_le<uint16_t>(local, 0);    // Stored
+      put_le<uint16_t>(local, 0);    // Time
+      put_le<uint16_t>(local, 0x21); // Date
+      put_le<uint32_t>(local, e.checksum);
+      put_le<uint32_t>(local, static_cast<uint32_t>(e.size));
+      put_le<uint32_t>(local, static_cast<uint32_t>(e.size));
+      put_le<uint16_t>(local, static_cast<uint16_t>(name.size()));
+      put_le<uint16_t>(local, 0);
+      local.append(name);
+
+      put_le<uint32_t>(central, 0x02014b50);
+      put_le<uint16_t>(central, 20); // Version made by
+      central.append(local, 4, 26);  // Same fields as the local header
+      put_le<uint16_t>(central, 0);  // Comment
+      put_le<uint16_t>(central, 0);  // Disk
+      put_le<uint16_t>(central, 0);  // Internal attributes
+      put_le<uint32_t>(central, 0);  // External attributes
+      put_le<uint32_t>(central, static_cast<uint32_t>(offset));
+      central.append(name);
+
+      data.append(local);
+      data.append(content);
+      offset += local.size() + content.size();
+    }
+
+    std::string end;
+    put_le<uint32_t>(end, 0x06054b50);
+    put_le<uint16_t>(end, 0);
+    put_le<uint16_t>(end, 0);
+    put_le<uint16_t>(end, static_cast<uint16_t>(m_index.size()));
+    put_le<uint16_t>(end, static_cast<uint16_t>(m_index.size()));
+    put_le<uint32_t>(end, static_cast<uint32_t>(central.size()));
+    put_le<uint32_t>(end, static_cast<uint32_t>(offset));
+    put_le<uint16_t>(end, 0);
+    data.append(central);
+    data.append(end);
+    replace_file(path, data);
+  }
+} // namespace AnnotationStore
@@ -1,6 +1,9 @@
 #include <Application.hpp>
 
+#include <algorithm>
 #include <exception>
+#include <optional>
+#include <stdexcept>
 
 #include "load_pages.hpp"
 #include "detect_separators.hpp"
@@ -62,7 +65,8 @@ void handle_and_update_scale(int& scale, int width, int /*height*/)
 }
 
 
-Application::Application(std::string uri, int page_number, Progress* progress, bool deskew_only)
+Application::Application(std::string uri, int page_number, Progress* progress, bool deskew_only,
+                         LineSegmentation lines)
 {
   const char* time_str = "'{}' computed in {:} ms";
   int scale = INT_MAX;
@@ -76,7 +80,7 @@ Application::Application(std::string uri, int page_number, Progress* progress, b
   // Load the document and the page
   {
     c.restart();
-    auto doc = open_document(uri.c_str());
+    auto doc = open_document_cached(uri.c_str());
     if (doc == nullptr)
       throw std::runtime_error("Invalid document (see logs)");
     auto   pp_ = load_page(doc.get(), page_number);
@@ -88,6 +92,8 @@ Application::Application(std::string uri, int page_number, Progress* progress, b
 
     handle_and_update_scale(scale, pp_->image.width(), pp_->image.height());
     m_app_data->original = std::move(pp_.value());
+    m_scale              = scale;
+    m_lines              = lines;
   }
 
   if (progress && progress->IsCanceled())
@@ -128,23 +134,7 @@ Application::Application(std::string uri, int page_number, Progress* progress, b
 
 
   // 3. Subsample input
-  {
-    c.restart();
-    if (scale == 0)
-    {
-      m_app_data->input = subsample(m_app_data->deskewed.image);
-      m_app_data->segments = m_app_data->deskewed.segments;
-      auto& segs = m_app_data->segments;
-      std::for_each(segs.begin(), segs.end(), [](auto& seg) { seg.scale(0.5f); });
-
-      spdlog::info(time_str, "Subsampling", c.GetElapsedTimeMilliSeconds());
-    }
-    else if (scale == 1)
-    {
-      m_app_data->input    = m_app_data->deskewed.image;
-      m_app_data->segments = m_app_data->deskewed.segments;
-    }
-  }
+  PrepareInput();
 
   // 4. Block detection
   {
@@ -162,7 +152,7 @@ Application::Application(std::string uri, int page_number, Progress* progress, b
   // 5. Line detection
   {
     c.restart();
-    DOMLinesExtraction(m_document.get(), m_app_data.get());
+    DOMLinesExtraction(m_document.get(), m_app_data.get(), lines);
     spdlog::info(time_str, "Lines detection", c.GetElapsedTimeMilliSeconds());
   }
 
@@ -210,6 +200,8 @@ Application::Application(std::string uri, int page_number, Progress* progress, b
     spdlog::info(time_str, "Text extraction", c.GetElapsedTimeMilliSeconds());
   }
 
+  m_flat_document = FlatDOM(m_document.get());
+
   if (progress)
     progress->Update(100);
 }
@@ -219,6 +211,187 @@ Application::~Application()
 {
 }
 
+
+namespace
+{
+  // Collect the columns (column_level_2 nodes) and the titles that intersect a region (or all of them if there is no
+  // region)
+  struct RegionCollector : public DOMStaticVisitor<RegionCollector>
+  {
+    std::optional<Box>                region;
+    std::vector<DOM::column_level_2*> columns;
+    std::vector<DOMElement*>          titles;
+
+    void visit(DOM::title_level_1* e, std::nullptr_t) { add_title(e); }
+    void visit(DOM::title_level_2* e, std::nullptr_t) { add_title(e); }
+    void visit(DOM::column_level_2* e, std::nullptr_t)
+    {
+      if (!region || e->bbox.intersects(*region))
+        columns.push_back(e);
+    }
+    void visit(DOM::entry*, std::nullptr_t) {}
+    void visit(DOM::line*, std::nullptr_t) {}
+
+    void add_title(DOMElement* e)
+    {
+      if (!region || e->bbox.intersects(*region))
+        titles.push_back(e);
+    }
+  };
+
+  // Replace the entries of a column by their lines (the other nodes are dropped)
+  void ungroup_entries(DOM::column_level_2* col)
+  {
+    auto children = std::move(col->children);
+    col->children.clear();
+
+    auto add_line = [col](std::unique_ptr<DOMElement>& e) {
+      if (e->type() != DOMCategory::LINE)
+      {
+        spdlog::warn("A {} node in a column (x={},y={}) is not a line and is dropped.", e->type_str(), e->bbox.x,
+                     e->bbox.y);
+        return;
+      }
+      static_cast<DOM::line*>(e.get())->indented = false;
+      col->children.push_back(std::move(e));
+    };
+
+    for (auto& c : children)
+    {
+      if (c->type() != DOMCategory::ENTRY)
+        add_line(c);
+      else
+        for (auto& l : c->children)
+          add_line(l);
+    }
+  }
+
+  // Intersect the boxes of a document with the page (the stages access the images inside the boxes)
+  void clip_to_page(DOMElement* e, Box page)
+  {
+    Box& b  = e->bbox;
+    int  x0 = std::max(b.x0(), page.x0());
+    int  y0 = std::max(b.y0(), page.y0());
+    int  x1 = std::min(b.x1(), page.x1());
+    int  y1 = std::min(b.y1(), page.y1());
+    if (x1 <= x0 || y1 <= y0)
+    {
+      spdlog::error("The box (x={},y={},w={},h={}) of a {} node is outside the page ({}x{}).", b.x, b.y, b.width,
+                    b.height, e->type_str(), page.width, page.height);
+      throw std::invalid_argument("A box of the document is outside the page (see logs)");
+    }
+    b = {x0, y0, x1 - x0, y1 - y0};
+
+    for (auto& c : e->children)
+      clip_to_page(c.get(), page);
+  }
+} // namespace
+
+
+void Application::PrepareInput()
+{
+  clocker c;
+  if (m_scale == 0)
+  {
+    m_app_data->input = subsample(m_app_data->deskewed.image);
+    m_app_data->segments = m_app_data->deskewed.segments;
+    auto& segs = m_app_data->segments;
+    std::for_each(segs.begin(), segs.end(), [](auto& seg) { seg.scale(0.5f); });
+
+    spdlog::info("'{}' computed in {:} ms", "Subsampling", c.GetElapsedTimeMilliSeconds());
+  }
+  else if (m_scale == 1)
+  {
+    m_app_data->input    = m_app_data->deskewed.image;
+    m_app_data->segments = m_app_data->deskewed.segments;
+  }
+}
+
+
+void Application::Reprocess(std::span<DOM::column_level_2* const> columns, std::span<DOMElement* const> titles,
+                            ProcessingStage from)
+{
+  const char* time_str = "'{}' computed in {:} ms";
+  clocker     c;
+
+  if (from == ProcessingStage::LINES)
+  {
+    c.restart();
+    for (auto* col : columns)
+      col->children.clear();
+    DOMLinesExtraction(m_document.get(), columns, m_app_data.get(), m_lines, (m_scale == 0) ? 2 : 1);
+    spdlog::info(time_str, "Lines detection", c.GetElapsedTimeMilliSeconds());
+  }
+
+  if (from <= ProcessingStage::ENTRIES)
+  {
+    c.restart();
+    for (auto* col : columns)
+      ungroup_entries(col);
+    DOMEntriesExtraction(columns, m_app_data.get());
+    spdlog::info(time_str, "Entries detection", c.GetElapsedTimeMilliSeconds());
+  }
+
+  {
+    c.restart();
+    std::vector<DOMElement*> nodes(columns.begin(), columns.end());
+    nodes.insert(nodes.end(), titles.begin(), titles.end());
+    DOMTextExtraction(nodes, m_app_data.get());
+    spdlog::info(time_str, "Text extraction", c.GetElapsedTimeMilliSeconds());
+  }
+
+  m_flat_document = FlatDOM(m_document.get());
+}
+
+
+void Application::ReprocessRegion(Box region, ProcessingStage from)
+{
+  if (!m_document)
+    throw std::runtime_error("The document has not been processed");
+
+  RegionCollector collector;
+  collector.region = region;
+  collector.traverse(m_document.get());
+
+  spdlog::info("Reprocess {} columns and {} titles in the region (x={},y={},w={},h={})", collector.columns.size(),
+               collector.titles.size(), region.x, region.y, region.width, region.height);
+  Reprocess(collector.columns, collector.titles, from);
+}
+
+
+void Application::SetDocument(std::unique_ptr<DOMElement> document, ProcessingStage from)
+{
+  if (!document || document->type() != DOMCategory::PAGE)
+  {
+    spdlog::error("The root of the document must be a PAGE node.");
+    throw std::runtime_error("Invalid document (see logs)");
+  }
+
+  // Before any change of the application, so that an invalid document leaves it as it was
+  const auto& page = m_app_data->deskewed.image;
+  clip_to_page(document.get(), Box{0, 0, page.width(), page.height()});
+
+  // The application may have been created with deskew_only
+  if (from == ProcessingStage::LINES)
+  {
+    if (m_app_data->input.domain().empty())
+      PrepareInput();
+
+    // The labels of the previous lines are meaningless for the new layout
+    const auto& domain = (m_scale == 0) ? m_app_data->deskewed.image : m_app_data->input;
+    mln::resize(m_app_data->ws, domain).set_init_value(int16_t(0));
+  }
+
+  m_document = std::move(document);
+
+  RegionCollector collector;
+  collector.traverse(m_document.get());
+
+  spdlog::info("Process the document set with {} columns and {} titles", collector.columns.size(),
+               collector.titles.size());
+  Reprocess(collector.columns, collector.titles, from);
+}
+
 ApplicationData* Application::GetApplicationData()
 {
   return m_app_data.get();
@@ -229,6 +402,11 @@ DOMElement* Application::GetDocument()
   return m_document.get();
 }
 
+const FlatDOM& Application::GetFlatDocument() const
+{
+  return m_flat_document;
+}
+
 // Get the input page as a 8-bits graylevel image
 mln::ndbuffer_image  Application::GetInputImage()
 {
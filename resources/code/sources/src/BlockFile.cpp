@@ -0,0 +1,55 @@
+#include <BlockFile.hpp>
+
+#include <fmt/format.h>
+#include <spdlog/spdlog.h>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+namespace BlockFile
+{
+  MappedFile::MappedFile(const std::string& path, std::size_t min_size, const char* kind)
+    : m_path{path}
+    , m_kind{kind}
+  {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+      spdlog::error("Unable to open the {} '{}'", kind, path);
+      throw std::runtime_error(fmt::format("Unable to open the {} (see logs)", kind));
+    }
+
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(min_size))
+    {
+      ::close(fd);
+      invalid("file too small");
+    }
+
+    void* p = ::mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED)
+    {
+      spdlog::error("Unable to map the {} '{}'", kind, path);
+      throw std::runtime_error(fmt::format("Unable to open the {} (see logs)", kind));
+    }
+    m_data = static_cast<const std::byte*>(p);
+    m_size = st.st_size;
+  }
+
+  MappedFile::~MappedFile()
+  {
+    if (m_data)
+      ::munmap(const_cast<std::byte*>(m_data), m_size);
+  }
+
+  void MappedFile::invalid(const char* msg) const
+  {
+    spdlog::error("Invalid {} '{}': {}", m_kind, m_path, msg);
+    throw std::runtime_error(fmt::format("Invalid {} (see logs)", m_kind));
+  }
+} // namespace BlockFile
@@ -53,7 +53,7 @@ namespace
 
 bool Box::intersects(Box o) const
 {
-  return ::intersects(this->x, this->x1(), o.x, o.x1()) || //
+  return ::intersects(this->x, this->x1(), o.x, o.x1()) && //
          ::intersects(this->y, this->y1(), o.y, o.y1());
 }
 
@@ -0,0 +1,238 @@
+#include <DOMBinary.hpp>
+#include "file_io.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <unordered_map>
+
+
+namespace DOMBinary
+{
+  namespace
+  {
+    constexpr int kFirstId = 0x100; // Same ids as the json export
+  } // namespace
+
+
+  PageView::PageView(const dom_node_record_t* nodes, std::size_t n, std::string_view strings)
+    : m_nodes{nodes}
+    , m_size{n}
+    , m_strings{strings}
+  {
+  }
+
+  std::string_view PageView::text(std::size_t i) const
+  {
+    return m_strings.substr(m_nodes[i].text_offset, m_nodes[i].text_size);
+  }
+
+  std::string_view PageView::extra(std::size_t i) const
+  {
+    return m_strings.substr(m_nodes[i].extra_offset, m_nodes[i].extra_size);
+  }
+
+  std::unique_ptr<DOMElement> PageView::to_tree() const
+  {
+    std::vector<std::unique_ptr<DOMElement>> nodes(m_size);
+    std::unordered_map<int32_t, std::size_t> index;
+
+    for (std::size_t i = 0; i < m_size; ++i)
+    {
+      const auto& r = m_nodes[i];
+      if (!(r.flags & HAS_TYPE) || r.type > static_cast<uint8_t>(DOMCategory::LINE))
+        throw std::runtime_error("Unknown DOM node type");
+
+      auto cat = static_cast<DOMCategory>(r.type);
+      nodes[i] = DOMElement::create_node(cat);
+      if (r.flags & HAS_BOX)
+        nodes[i]->bbox = {r.box[0], r.box[1], r.box[2], r.box[3]};
+      if ((r.flags & HAS_TEXT) && FlatDOM::is_textual(cat))
+        static_cast<DOM::TextualElement*>(nodes[i].get())->text = text(i);
+      if (r.flags & HAS_ID)
+        index[r.id] = i;
+    }
+
+    // A node without parent (or whose parent id is unknown) is the root. The parent links are checked before the tree
+    // is built (a parent cycle would make an ownership cycle).
+    std::vector<int> parents(m_size, -1);
+    for (std::size_t i = 0; i < m_size; ++i)
+    {
+      const auto& r  = m_nodes[i];
+      auto        it = (r.flags & HAS_PARENT) ? index.find(r.parent) : index.end();
+      if (it != index.end())
+        parents[i] = static_cast<int>(it->second);
+    }
+
+    try
+    {
+      return DOMElement::create_tree(std::move(nodes), parents);
+    }
+    catch (const std::invalid_argument& e)
+    {
+      throw std::runtime_error(std::string("Invalid DOM page: ") + e.what());
+    }
+  }
+
+
+  Reader::Reader(const std::string& path)
+    : m_file(path, sizeof(dom_file_header_t), "DOM file")
+  {
+    // Validate the header and the index once so that the accesses are plain pointer offsets
+    const std::byte*  data = m_file.data();
+    const std::size_t size = m_file.size();
+    auto              fail = [&](const char* msg) { m_file.invalid(msg); };
+
+    auto* h = reinterpret_cast<const dom_file_header_t*>(data);
+    if (std::memcmp(h->magic, kMagic, sizeof(kMagic)) != 0)
+      fail("bad magic number");
+    if (h->version != kVersion)
+      fail("unsupported version");
+    if (sizeof(dom_file_header_t) + std::size_t(h->num_pages) * sizeof(dom_page_index_t) > size)
+      fail("truncated index");
+
+    auto* index = reinterpret_cast<const dom_page_index_t*>(h + 1);
+    for (uint32_t i = 0; i < h->num_pages; ++i)
+    {
+      const auto& e = index[i];
+      if (i > 0 && index[i - 1].page_id >= e.page_id)
+        fail("unsorted index");
+      if (e.offset % 8 != 0 || e.offset > size || e.size > size - e.offset || e.size < sizeof(dom_page_header_t))
+        fail("page out of bounds");
+
+      auto* ph = reinterpret_cast<const dom_page_header_t*>(data + e.offset);
+      if (sizeof(dom_page_header_t) + std::size_t(ph->num_nodes) * sizeof(dom_node_record_t) + ph->strings_size >
+          e.size)
+        fail("truncated page");
+
+      auto* nodes = reinterpret_cast<const dom_node_record_t*>(ph + 1);
+      for (uint32_t k = 0; k < ph->num_nodes; ++k)
+      {
+        const auto& r = nodes[k];
+        if (uint64_t(r.text_offset) + r.text_size > ph->strings_size ||
+            uint64_t(r.extra_offset) + r.extra_size > ph->strings_size)
+          fail("string out of bounds");
+      }
+    }
+  }
+
+  const dom_page_index_t* Reader::find(int page_id) const
+  {
+    auto* h     = reinterpret_cast<const dom_file_header_t*>(m_file.data());
+    auto* begin = reinterpret_cast<const dom_page_index_t*>(h + 1);
+    auto* end   = begin + h->num_pages;
+    auto* it    = std::lower_bound(begin, end, page_id, [](const auto& e, int v) { return e.page_id < v; });
+    return (it != end && it->page_id == page_id) ? it : nullptr;
+  }
+
+  std::vector<int> Reader::pages() const
+  {
+    auto* h     = reinterpret_cast<const dom_file_header_t*>(m_file.data());
+    auto* index = reinterpret_cast<const dom_page_index_t*>(h + 1);
+
+    std::vector<int> ids(h->num_pages);
+    for (uint32_t i = 0; i < h->num_pages; ++i)
+      ids[i] = index[i].page_id;
+    return ids;
+  }
+
+  bool Reader::has_page(int page_id) const
+  {
+    return find(page_id) != nullptr;
+  }
+
+  PageView Reader::page(int page_id) const
+  {
+    auto* e = find(page_id);
+    if (!e)
+      throw std::out_of_range("No such page in the DOM file");
+
+    auto* ph      = reinterpret_cast<const dom_page_header_t*>(m_file.data() + e->offset);
+    auto* nodes   = reinterpret_cast<const dom_node_record_t*>(ph + 1);
+    auto* strings = reinterpret_cast<const char*>(nodes + ph->num_nodes);
+    return PageView(nodes, ph->num_nodes, std::string_view(strings, ph->strings_size));
+  }
+
+  std::string_view Reader::page_block(int page_id) const
+  {
+    auto* e = find(page_id);
+    if (!e)
+      throw std::out_of_range("No such page in the DOM file");
+    return std::string_view(reinterpret_cast<const char*>(m_file.data() + e->offset), e->size);
+  }
+
+
+  void Writer::add_page(int page_id, const FlatDOM& doc)
+  {
+    std::string strings;
+
+    // Same order and ids as the json export
+    std::vector<dom_node_record_t> records;
+    records.reserve(doc.size());
+    for (int i : doc.post_order())
+    {
+      dom_node_record_t r = {};
+      const auto&       b = doc.bbox(i);
+      r.id                = kFirstId + i;
+      r.type              = static_cast<uint8_t>(doc.type(i));
+      r.box[0]            = b.x;
+      r.box[1]            = b.y;
+      r.box[2]            = b.width;
+      r.box[3]            = b.height;
+      r.flags             = HAS_ID | HAS_TYPE | HAS_BOX;
+      if (doc.parent(i) != FlatDOM::kNone)
+      {
+        r.parent = kFirstId + doc.parent(i);
+        r.flags |= HAS_PARENT;
+      }
+      if (FlatDOM::is_textual(doc.type(i)))
+      {
+        auto text     = doc.text(i);
+        r.text_offset = static_cast<uint32_t>(strings.size());
+        r.text_size   = static_cast<uint32_t>(text.size());
+        r.flags |= HAS_TEXT;
+        strings.append(text);
+      }
+      records.push_back(r);
+    }
+
+    std::string       block;
+    dom_page_header_t ph = {static_cast<uint32_t>(records.size()), static_cast<uint32_t>(strings.size())};
+    BlockFile::append(block, ph);
+    block.append(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(dom_node_record_t));
+    block.append(strings);
+    add_page_block(page_id, std::move(block));
+  }
+
+  void Writer::add_page_block(int page_id, std::string block)
+  {
+    m_pages[page_id] = std::move(block);
+  }
+
+  void Writer::merge(const Reader& file)
+  {
+    for (int id : file.pages())
+      if (!m_pages.count(id))
+        m_pages.emplace(id, file.page_block(id));
+  }
+
+  void Writer::save(const std::string& path) const
+  {
+    dom_file_header_t h = {};
+    std::memcpy(h.magic, kMagic, sizeof(kMagic));
+    h.version   = kVersion;
+    h.num_pages = static_cast<uint32_t>(m_pages.size());
+
+    std::vector<int>              ids;
+    std::vector<std::string_view> blocks;
+    for (const auto& [id, block] : m_pages)
+    {
+      ids.push_back(id);
+      blocks.push_back(block);
+    }
+
+    replace_file(path, BlockFile::pack(h, blocks, [&](std::size_t i, uint64_t offset) {
+                   return dom_page_index_t{ids[i], 0, offset, blocks[i].size()};
+                 }));
+  }
+} // namespace DOMBinary
@@ -5,13 +5,16 @@
 #include "config.hpp"
 #include "DOMBuilder_helpers.hpp"
 #include "Interval.hpp"
+#include "line_morphology.hpp"
+#include "thread_pool.hpp"
 
 #include <mln/core/se/periodic_line2d.hpp>
-#include <mln/morpho/opening.hpp>
 #include <mln/morpho/rank_filter.hpp>
 #include <mln/io/imsave.hpp>
 
+#include <algorithm>
 #include <climits>
+#include <ratio>
 
 
 namespace
@@ -47,16 +50,16 @@ namespace
 
 
 
-  struct DOMBlocksExtractor : public DOMElementVisitor
+  struct DOMBlocksExtractor : public DOMStaticVisitor<DOMBlocksExtractor, DOMElement, int>
   {
 
     static constexpr int kExtraMargin = 2; // Add this as a margin to block
 
     DOMBlocksExtractor() = default;
 
-    std::vector<Segment>  segments;
-    mln::image2d<uint8_t> blocks1; // Image prerpocessed for block processing
-    mln::image2d<uint8_t> blocks2; // Image prerpocessed for block processing (with vertical lines removed)
+    std::vector<Segment>       segments;
+    const BlackPixelsIntegral* blocks1; // Black pixels (< kWhiteThreshold) of the image preprocessed for block processing
+    const BlackPixelsIntegral* blocks2; // Same with the vertical lines removed (black = below kLayoutWhiteLevel)
 
 
     // Split vertically - (horizontal separation)
@@ -97,7 +100,7 @@ namespace
       if (hsec->type() == DOMCategory::PAGE)
       {
         //ysum = rank_along_x_axis(blocks1.clip(region), 0.05f);
-        ysum = is_number_of_black_pixels_less_than(blocks1.clip(region), kWhiteThreshold, 0.10f, Axis::X);
+        ysum = blocks1->is_number_of_black_pixels_less_than(region, 0.10f, Axis::X);
       }
       else
       {
@@ -107,12 +110,12 @@ namespace
 
         box2d roi = region;
         roi.set_width(w / 3);
-        is_number_of_black_pixels_less_than(blocks1.clip(roi), kWhiteThreshold, 0.05f, Axis::X, ysum.data()); // 95% on 1st third
+        blocks1->is_number_of_black_pixels_less_than(roi, 0.05f, Axis::X, ysum.data()); // 95% on 1st third
         // rank_along_x_axis(blocks1.clip(roi), 0.05f, ysum.data());
 
         roi.tl().x() = region.x() + w / 3;
         roi.br().x() = region.x() + 2 * (w / 3);
-        is_number_of_black_pixels_less_than(blocks1.clip(roi), kWhiteThreshold, 0.3f, Axis::X, ysum.data() + h); // 70% on the 2nd third
+        blocks1->is_number_of_black_pixels_less_than(roi, 0.3f, Axis::X, ysum.data() + h); // 70% on the 2nd third
         // rank_along_x_axis(blocks1.clip(roi), 0.3f, ysum.data() + h); // 50% on 2nd third
 
         for (int i = 0; i < h; ++i)
@@ -204,16 +207,20 @@ namespace
       }
 
 
-      int new_level = level + 1;
+      // The sub-sections are independent (each task only writes in its own subtree), process them in parallel
+      TaskGroup tasks;
       for (auto& sec : hsec->children)
       {
         spdlog::debug("{:<{}} Processing y-section [y={},h={}]", "", level * 2, sec->bbox.y, sec->bbox.height);
-        DOMBlocksExtractor parser;
-        parser.segments = region_segments;
-        parser.blocks1 = this->blocks1;
-        parser.blocks2 = this->blocks2;
-        sec->accept(parser, static_cast<void*>(&new_level));
+        tasks.run([this, sec = sec.get(), &region_segments, level]() {
+          DOMBlocksExtractor parser;
+          parser.segments = region_segments;
+          parser.blocks1 = this->blocks1;
+          parser.blocks2 = this->blocks2;
+          parser.traverse(sec, level + 1);
+        });
       }
+      tasks.wait();
     }
 
     // Split horizontally (vertical separation)
@@ -238,7 +245,7 @@ namespace
         }
 
 
-      auto rnks = is_number_of_black_pixels_less_than(blocks2.clip(region), kLayoutWhiteLevel, 0.02f, Axis::Y);
+      auto rnks = blocks2->is_number_of_black_pixels_less_than(region, 0.02f, Axis::Y);
       // std::vector<int> rnks    = rank_along_y_axis(blocks2.clip(region), 0.02f);
 
 
@@ -277,24 +284,29 @@ namespace
         vsec->add_child_node(std::move(sec));
       }
 
-      int new_level = level + 1;
+      // The parser state is read-only during the recursion, so the columns can share it
+      TaskGroup tasks;
       for (auto& sec : vsec->children)
       {
         spdlog::debug("{:<{}} Processing x-section [x={},w={}]", "", level * 2, sec->bbox.x, sec->bbox.width);
-        sec->accept(*this, static_cast<void*>(&new_level));
+        tasks.run([this, sec = sec.get(), level]() {
+          this->traverse(sec, level + 1);
+        });
       }
+      tasks.wait();
     }
 
 
-    void visit(DOM::page* sec, void* extra)  final { this->vsplit(sec, *static_cast<int*>(extra)); }
-    void visit(DOM::title_level_1*, void*)  final {}
-    void visit(DOM::title_level_2*, void*) final {}
-    void visit(DOM::section_level_1* sec, void* extra)  final { this->hsplit(sec, *static_cast<int*>(extra)); }
-    void visit(DOM::section_level_2* sec, void* extra)  final { this->hsplit(sec, *static_cast<int*>(extra)); }
-    void visit(DOM::column_level_1* sec, void* extra)  final { this->vsplit(sec, *static_cast<int*>(extra)); }
-    void visit(DOM::column_level_2*, void*)  final { }
-    void visit(DOM::entry*, void*)  final { }
-    void visit(DOM::line*, void*)  final { }
+    void visit(DOM::page* sec, int level) { this->vsplit(sec, level); }
+    void visit(DOM::section_level_1* sec, int level) { this->hsplit(sec, level); }
+    void visit(DOM::section_level_2* sec, int level) { this->hsplit(sec, level); }
+    void visit(DOM::column_level_1* sec, int level) { this->vsplit(sec, level); }
+
+    // The other nodes are leaves of the layout
+    template <class T>
+    void visit(T*, int)
+    {
+    }
   };
 
 
@@ -317,8 +329,7 @@ namespace
       mln::image2d<uint8_t> vblock, hblock;
       // Detect left/right border
       {
-        mln::se::periodic_line2d l(point2d{0, 1}, kLayoutPageOpeningHeight / 2);
-        hblock = mln::morpho::opening(input, l);
+        hblock = layout::vline_opening(input, kLayoutPageOpeningHeight / 2);
         auto sum = sum_along_y_axis(hblock);
         auto [a,b] = detect_border(sum.data(), width, height);
         roi.tl().x() = a;
@@ -326,16 +337,10 @@ namespace
       }
       // Detect bottom/top border
       {
-        {
-          mln::se::periodic_line2d l(point2d{1, 0}, kLayoutPageOpeningWidth / 2);
-          vblock = mln::morpho::opening(input, l);
-        }
-        mln::image2d<uint8_t> vblock2;
+        vblock = layout::hline_opening(input, kLayoutPageOpeningWidth / 2);
+
         // Opening with a vertical SE to connect lines (makes block)
-        {
-          mln::se::periodic_line2d l(point2d{0, 1}, kLayoutBlockOpeningHeight);
-          vblock2 = mln::morpho::opening(vblock, l);
-        }
+        mln::image2d<uint8_t> vblock2 = layout::vline_opening(vblock, kLayoutBlockOpeningHeight);
 
         std::vector<int> sum = sum_along_x_axis(vblock2);
         auto [a, b]          = detect_border(sum.data(), height, width);
@@ -354,6 +359,107 @@ namespace
     return roi;
   }
 
+
+  // Rank (in [0, n)) of the value selected by the rank filter among n values (same as mln::morpho::rank_filter<R>)
+  template <class R>
+  constexpr int rank_index(int n)
+  {
+    return std::min(n - 1, static_cast<int>((n * R::num) / R::den));
+  }
+
+  ///
+  /// Compute the block images of the (cropped) input in a single tiled pass:
+  ///  * blocks  = opening by a vertical line then by a horizontal line (connect letters/words and lines)
+  ///  * blocks2 = rank filter 5/7 of blocks along a horizontal line (remove vertical line separators)
+  ///
+  /// Every tile is processed with halos large enough for the SE extents so that the intermediate images stay in
+  /// cache and never have to be materialized for the whole page. The tiles are processed in parallel.
+  ///
+  /// The tiles use the native line morphology: without kNativeLineMorphology, the three operators of Pylene are applied
+  /// to the whole page instead.
+  void make_blocks(const mln::image2d<uint8_t>& input, mln::image2d<uint8_t>& blocks, mln::image2d<uint8_t>& blocks2)
+  {
+    using R = std::ratio<5, 7>;
+
+    constexpr int kTileWidth     = 512; // Tile size (with the halos the scratch buffers fit in L2)
+    constexpr int kTileHeight    = 64;
+    constexpr int kRankHalfSize  = 3;   // Rank filter on 2*3+1 pixels
+    const int     kv             = kLayoutBlockOpeningHeight / 2;
+    const int     kh             = kLayoutBlockOpeningWidth / 2;
+    const int     halo_x         = 2 * kh + kRankHalfSize;
+    const int     halo_y         = 2 * kv;
+    constexpr int kRank          = rank_index<R>(2 * kRankHalfSize + 1);
+
+    if (!kNativeLineMorphology)
+    {
+      blocks  = layout::hline_opening(layout::vline_opening(input, kv), kh);
+      blocks2 = mln::morpho::rank_filter<R>(blocks, mln::se::periodic_line2d(mln::point2d{1, 0}, kRankHalfSize),
+                                            mln::extension::bm::fill(uint8_t(255)));
+      return;
+    }
+
+    mln::resize(blocks, input);
+    mln::resize(blocks2, input);
+
+    const int width    = input.width();
+    const int height   = input.height();
+    const int ntiles_x = (width + kTileWidth - 1) / kTileWidth;
+    const int ntiles_y = (height + kTileHeight - 1) / kTileHeight;
+
+    auto process_tile = [&](int t) {
+      const int tx0 = (t % ntiles_x) * kTileWidth;
+      const int ty0 = (t / ntiles_x) * kTileHeight;
+      const int tx1 = std::min(width, tx0 + kTileWidth);
+      const int ty1 = std::min(height, ty0 + kTileHeight);
+
+      // Tile + halos (clipped to the domain: outside pixels are ignored as in the non-tiled operators)
+      const int ix0 = std::max(0, tx0 - halo_x);
+      const int ix1 = std::min(width, tx1 + halo_x);
+      const int iy0 = std::max(0, ty0 - halo_y);
+      const int iy1 = std::min(height, ty1 + halo_y);
+      const int iw  = ix1 - ix0;
+      const int ih  = iy1 - iy0;
+      const int th  = ty1 - ty0;
+
+      std::vector<uint8_t> buffer(2 * iw * ih + iw + 2 * kRankHalfSize);
+      uint8_t*             tmp1 = buffer.data();
+      uint8_t*             tmp2 = buffer.data() + iw * ih;
+      uint8_t*             row  = buffer.data() + 2 * iw * ih;
+
+      // 1. Vertical opening (exact on the rows of the tile)
+      const uint8_t* in = input.buffer() + iy0 * input.stride() + ix0;
+      impl::vline_erosion(in, input.stride(), tmp1, iw, iw, ih, kv);
+      impl::vline_dilation(tmp1, iw, tmp2, iw, iw, ih, kv);
+
+      // 2. Horizontal opening on the rows of the tile (exact on the tile + the rank filter halo)
+      const uint8_t* vopen = tmp2 + (ty0 - iy0) * iw;
+      impl::hline_erosion(vopen, iw, tmp1, iw, iw, th, kh);
+      impl::hline_dilation(tmp1, iw, tmp2, iw, iw, th, kh);
+
+      // 3. Rank filter (outside pixels are white) + store
+      std::fill_n(row, iw + 2 * kRankHalfSize, uint8_t(255));
+      for (int y = 0; y < th; ++y)
+      {
+        const uint8_t* hopen = tmp2 + y * iw;
+        uint8_t*       out1  = blocks.buffer() + (ty0 + y) * blocks.stride();
+        uint8_t*       out2  = blocks2.buffer() + (ty0 + y) * blocks2.stride();
+
+        std::copy(hopen + (tx0 - ix0), hopen + (tx1 - ix0), out1 + tx0);
+        std::copy_n(hopen, iw, row + kRankHalfSize);
+        for (int x = tx0; x < tx1; ++x)
+        {
+          uint8_t        win[2 * kRankHalfSize + 1];
+          const uint8_t* w = row + (x - ix0);
+          std::copy_n(w, 2 * kRankHalfSize + 1, win);
+          std::nth_element(win, win + kRank, win + 2 * kRankHalfSize + 1);
+          out2[x] = win[kRank];
+        }
+      }
+    };
+
+    ThreadPool::global().parallel_for(ntiles_x * ntiles_y, process_tile);
+  }
+
 } // namespace
 
 
@@ -363,8 +469,6 @@ namespace
 
 std::unique_ptr<DOMElement> DOMBlocksExtraction(ApplicationData* data)
 {
-  using mln::point2d;
-
   auto input0 = data->input;
 
   if (kDebugLevel > 1)
@@ -374,31 +478,14 @@ std::unique_ptr<DOMElement> DOMBlocksExtraction(ApplicationData* data)
   input0   = input0.clip(roi);
 
   // 2. Make blocks (connect letters/word and lines)
-  mln::image2d<uint8_t> blocks;
-  {
-    // Opening with a vertical SE to connect lines (makes block)
-    {
-      mln::se::periodic_line2d l(point2d{0,1}, kLayoutBlockOpeningHeight / 2);
-      blocks = mln::morpho::opening(input0, l);
-    }
-    // Opening with a horizontal SE to connect lines (makes block)
-    {
-      mln::se::periodic_line2d l(point2d{1,0}, kLayoutBlockOpeningWidth / 2);
-      blocks = mln::morpho::opening(blocks, l);
-    }
-    if (kDebugLevel > 1)
-      mln::io::imsave(blocks, "tmp-2-blocks.tiff");
-  }
-
-
   // 3. Remove vertical line separator
-  mln::image2d<uint8_t> blocks2;
+  mln::image2d<uint8_t> blocks, blocks2;
+  make_blocks(input0, blocks, blocks2);
+
+  if (kDebugLevel > 1)
   {
-    mln::se::periodic_line2d l(point2d{1,0}, 3); // was 3
-    using R = std::ratio<5,7>;
-    blocks2 = mln::morpho::rank_filter<R>(blocks, l, mln::extension::bm::fill(uint8_t(255)));
-    if (kDebugLevel > 1)
-      mln::io::imsave(blocks2, "tmp-3-blocks.tiff");
+    mln::io::imsave(blocks, "tmp-2-blocks.tiff");
+    mln::io::imsave(blocks2, "tmp-3-blocks.tiff");
   }
 
   data->blocks  = blocks;
@@ -412,11 +499,14 @@ std::unique_ptr<DOMElement> DOMBlocksExtraction(ApplicationData* data)
   auto& scaled_segments = data->segments;
   std::sort(scaled_segments.begin(), scaled_segments.end(), [](auto& s1, auto& s2) { return s1.start.y < s2.start.y; });
   parser.segments = scaled_segments;
-  parser.blocks1 = std::move(blocks);
-  parser.blocks2 = std::move(blocks2);
 
-  int level = 0;
-  doc->accept(parser, static_cast<void*>(&level));
+  // Black pixel counts of the regions are answered by integral images built once for the whole recursion
+  BlackPixelsIntegral blocks1_black(BitImage(blocks, kWhiteThreshold));
+  BlackPixelsIntegral blocks2_black(BitImage(blocks2, kLayoutWhiteLevel));
+  parser.blocks1 = &blocks1_black;
+  parser.blocks2 = &blocks2_black;
+
+  parser.traverse(doc.get(), 0);
 
   // Set to right scale (x2 for each coords because of the initial subsampling)
   // doc->scale(2);
@@ -161,25 +161,27 @@ std::vector<float> count_less_than(const mln::experimental::image2d<uint8_t>& in
 
 void is_number_of_black_pixels_less_than(mln::image2d<uint8_t> input, int white_level, float percentile,
                                          Axis axis, uint8_t* out)
+{
+  is_number_of_black_pixels_less_than(BitImage(input, white_level), input.domain(), percentile, axis, out);
+}
+
+void is_number_of_black_pixels_less_than(const BitImage& black, mln::box2d roi, float percentile, Axis axis,
+                                         uint8_t* out)
 {
   std::vector<int> count;
   int              n;
 
   if (axis == Axis::Y)
   {
-    int x0 = input.domain().x();
-    n = input.height();
-    count.resize(input.width(), 0);
-    mln_foreach (auto px, input.pixels())
-      count[px.point().x() - x0] += (px.val() < white_level);
+    n = roi.height();
+    count.resize(roi.width());
+    black.count_along_y(roi, count.data());
   }
   else
   {
-    int y0 = input.domain().y();
-    n = input.width();
-    count.resize(input.height(), 0);
-    mln_foreach (auto px, input.pixels())
-      count[px.point().y() - y0] += (px.val() < white_level);
+    n = roi.width();
+    count.resize(roi.height());
+    black.count_along_x(roi, count.data());
   }
 
   float np = percentile * n;
@@ -196,6 +198,73 @@ std::vector<uint8_t> is_number_of_black_pixels_less_than(mln::image2d<uint8_t> i
 }
 
 
+BlackPixelsIntegral::BlackPixelsIntegral(const mln::image2d<uint8_t>& input, int white_level)
+  : BlackPixelsIntegral(BitImage(input, white_level))
+{
+}
+
+BlackPixelsIntegral::BlackPixelsIntegral(const BitImage& black)
+{
+  int width  = black.width();
+  int height = black.height();
+
+  m_x0    = black.domain().x();
+  m_y0    = black.domain().y();
+  m_width = width;
+  m_sat.assign((width + 1) * (height + 1), 0);
+
+  for (int y = 0; y < height; ++y)
+  {
+    const uint64_t* words = black.row(y);
+    const int*      prev  = m_sat.data() + y * (width + 1);
+    int*            cur   = m_sat.data() + (y + 1) * (width + 1);
+    int             row   = 0;
+    for (int x = 0; x < width; ++x)
+    {
+      row += (words[x >> 6] >> (x & 63)) & 1;
+      cur[x + 1] = prev[x + 1] + row;
+    }
+  }
+}
+
+void BlackPixelsIntegral::is_number_of_black_pixels_less_than(mln::box2d roi, float percentile, Axis axis,
+                                                              uint8_t* out) const
+{
+  const int x0 = roi.x() - m_x0;
+  const int y0 = roi.y() - m_y0;
+  const int x1 = x0 + roi.width();
+  const int y1 = y0 + roi.height();
+
+  if (axis == Axis::Y)
+  {
+    float np = percentile * roi.height();
+    for (int x = x0; x < x1; ++x)
+    {
+      int c = sum(x + 1, y1) - sum(x, y1) - sum(x + 1, y0) + sum(x, y0);
+      out[x - x0] = c < np;
+    }
+  }
+  else
+  {
+    float np = percentile * roi.width();
+    for (int y = y0; y < y1; ++y)
+    {
+      int c = sum(x1, y + 1) - sum(x0, y + 1) - sum(x1, y) + sum(x0, y);
+      out[y - y0] = c < np;
+    }
+  }
+}
+
+std::vector<uint8_t> BlackPixelsIntegral::is_number_of_black_pixels_less_than(mln::box2d roi, float percentile,
+                                                                              Axis axis) const
+{
+  std::vector<uint8_t> out;
+  out.resize((axis == Axis::Y) ? roi.width() : roi.height());
+  is_number_of_black_pixels_less_than(roi, percentile, axis, out.data());
+  return out;
+}
+
+
 
 
 namespace
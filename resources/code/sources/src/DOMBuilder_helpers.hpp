@@ -3,6 +3,8 @@
 #include <mln/core/image/ndimage.hpp>
 #include <vector>
 
+#include "bit_image.hpp"
+
 
 
 
@@ -58,6 +60,37 @@ void is_number_of_black_pixels_less_than(mln::image2d<uint8_t> input, int white_
 std::vector<uint8_t> is_number_of_black_pixels_less_than(mln::image2d<uint8_t> input, int white_level, float percentile,
                                                          Axis axis);
 
+/// Same with the black pixels of \p roi in an already thresholded image
+void is_number_of_black_pixels_less_than(const BitImage& black, mln::box2d roi, float percentile, Axis axis,
+                                         uint8_t* out);
+
+
+/// Summed-area table of the black pixels (below white_level) of an image
+///
+/// It is built once per page and then answers the black pixel counts of any row or column of a region in O(1), so
+/// the projection profiles of a region cost O(height) or O(width) instead of O(area) (whatever the recursion depth).
+class BlackPixelsIntegral
+{
+public:
+  BlackPixelsIntegral() = default;
+  BlackPixelsIntegral(const mln::image2d<uint8_t>& input, int white_level);
+  explicit BlackPixelsIntegral(const BitImage& black);
+
+  /// Same as is_number_of_black_pixels_less_than(input.clip(roi), white_level, percentile, axis, out)
+  /// \p roi must be included in the domain of the image
+  void is_number_of_black_pixels_less_than(mln::box2d roi, float percentile, Axis axis, uint8_t* out) const;
+  std::vector<uint8_t> is_number_of_black_pixels_less_than(mln::box2d roi, float percentile, Axis axis) const;
+
+private:
+  // Number of black pixels in the image in [0,x) x [0,y) (coordinates relative to the domain)
+  int sum(int x, int y) const { return m_sat[y * (m_width + 1) + x]; }
+
+  int              m_x0    = 0;
+  int              m_y0    = 0;
+  int              m_width = 0;
+  std::vector<int> m_sat;
+};
+
 /*
 /// Compute the rank value of an image along the given axes
 /// \param rank Rank value in the range [0,1)
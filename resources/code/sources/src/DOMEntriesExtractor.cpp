@@ -2,6 +2,8 @@
 
 #include "config.hpp"
 #include "DOMBuilder_helpers.hpp"
+#include "entry_model.hpp"
+#include "thread_pool.hpp"
 
 #include <spdlog/spdlog.h>
 #include <algorithm>
@@ -9,151 +11,45 @@
 namespace
 {
 
-  struct DOMEntriesExtractor : public DOMElementVisitor
+  struct DOMEntriesExtractor : public DOMStaticVisitor<DOMEntriesExtractor>
   {
     const mln::image2d<uint8_t>* input;
     e_force_indent               force_indent = FORCE_NONE;
 
-    void visit(DOM::page* sec, void* extra) final { this->recurse(sec, extra); }
-    void visit(DOM::title_level_1* sec, void* extra) final { this->recurse(sec, extra); }
-    void visit(DOM::title_level_2* sec, void* extra) final { this->recurse(sec, extra); }
-    void visit(DOM::section_level_1* sec, void* extra) final { this->recurse(sec, extra); }
-    void visit(DOM::section_level_2* sec, void* extra) final { this->recurse(sec, extra); }
-    void visit(DOM::column_level_1* sec, void* extra) final { this->recurse(sec, extra); }
-    void visit(DOM::column_level_2* sec, void* extra) final;
-    void visit(DOM::entry* sec, void* extra) final { this->recurse(sec, extra); }
-    void visit(DOM::line* sec, void* extra) final { this->recurse(sec, extra); }
-  };
-
-  /*
-  constexpr int kNFilter = 6;
-
-  static constexpr float lw[3][kNFilter] = {-0.02755463, 4.5238338,  -3.2384014, -1.030055,   0.50755626, -0.6941753,
-                                            -3.973867,   -6.4046874, -2.8687444, -0.55866617, 4.835583,   -4.723095,
-                                            -2.4710116,  3.3544345,  1.7902824,  -3.3563163,  2.620387,   0.53217036};
-
-  static constexpr float rw[3][kNFilter] = {1.020765,   2.2055726,   1.2751873,   -0.13907719, -0.7650537, 2.1323185,
-                                            1.5263116,  -1.1369838,  -0.10114026, 1.6989342,   -1.9447949, -0.04686181,
-                                            0.09115282, -0.14541107, 0.54059523,  -0.05082651, 0.07130285, 0.25157788};
+    void visit(DOM::column_level_2* sec, std::nullptr_t) { columns.push_back(sec); }
 
-  static constexpr float w2[3 * kNFilter] = {1.9570931,  -0.93785703, -0.4777993, 2.7529087,   -1.8349427, -0.10945565,
-                                             2.0794728,  2.094579,    2.607956,   0.02096402,  -2.0741167, 2.746651,
-                                             -0.8180196, -1.4098756,  1.6255764,  -0.08534542, 0.60639817, -0.03582852};
-
-  static constexpr float b1[kNFilter] = {0.334649, 0.7842396, 0.31722787, 0.3184551, 0.43029153, 0.3035369};
-  static constexpr float b2           = -1.0919825;
+    /// Group the lines of a column in entries given the output of the classifiers for every line
+    void process(DOM::column_level_2* sec, const float* p0, const float* p1) const;
 
+    std::vector<DOM::column_level_2*> columns; // Columns collected by the visit (document order)
+  };
 
-  float _4_conv_3x2(const float* lm, const float* rm, int i)
+  // Features of the lines of a column (one row of EntryModel::kNumFeatures values per line, the first row is unused)
+  void column_features(const DOM::column_level_2* sec, float* out)
   {
+    const int   xmin     = sec->bbox.x;
+    const int   xmax     = sec->bbox.x1();
+    const float colwidth = sec->bbox.width;
+    const int   nf       = EntryModel::kNumFeatures;
 
-
-    // First conv
-    float f[3][kNFilter];
-    for (int k = 0; k < kNFilter; ++k)
+    float lm_prev = 0, rm_prev = 0;
+    for (std::size_t i = 0; i < sec->children.size(); ++i)
     {
-      f[0][k] = lm[i - 2] * lw[0][k] + lm[i - 1] * lw[1][k] + lm[i] * lw[2][k] + //
-                rm[i - 2] * rw[0][k] + rm[i - 1] * rw[1][k] + rm[i] * rw[2][k] + b1[k];
-
-      f[1][k] = lm[i - 1] * lw[0][k] + lm[i] * lw[1][k] + lm[i+1] * lw[2][k] + //
-                rm[i - 1] * rw[0][k] + rm[i] * rw[1][k] + rm[i+1] * rw[2][k] + b1[k];
-
-      f[2][k] = lm[i] * lw[0][k] + lm[i+1] * lw[1][k] + lm[i + 2] * lw[2][k] + //
-                rm[i] * rw[0][k] + rm[i+1] * rw[1][k] + rm[i + 2] * rw[2][k] + b1[k];
-
-      f[0][k] = std::max(0.f, f[0][k]);
-      f[1][k] = std::max(0.f, f[1][k]);
-      f[2][k] = std::max(0.f, f[2][k]);
+      const auto& bbox = sec->children[i]->bbox;
+      float       lm   = (bbox.x - xmin);
+      float       rm   = (xmax - bbox.x1());
+
+      float* x = out + i * nf;
+      x[0]     = lm;                    // lspace_abs
+      x[1]     = std::abs(lm - lm_prev); // grad
+      x[2]     = rm_prev / colwidth;     // prspace
+      lm_prev  = lm;
+      rm_prev  = rm;
     }
-
-    float* ravel = &f[0][0];
-    float  out   = b2;
-    for (int i = 0; i < 3 * kNFilter; ++i)
-      out += ravel[i] * w2[i];
-    out = 1 / (1 + std::exp(-out));
-    return out;
-  }
-
-  void entry_predictor(const float* lm, const float* rm, std::size_t n, uint8_t* out)
-  {
-    for (std::size_t i = 0; i < n; ++i)
-    {
-      float pred  = _4_conv_3x2(lm, rm, i);
-      out[i] = pred > 0.5;
-
-      spdlog::debug("Prediction for line {} is {}", i, (int)out[i]);
-    }
-  }
-  */
-
-
-  float classify_0(float lspace_abs, float grad, float prspace)
-  {
-  if (prspace <= 0.050192078575491905) {
-    if (grad <= 7.0) {
-      if (lspace_abs <= 5.0) {
-        return 0.2806137080585029;
-      } else /* (lspace_abs > 5.0) */ {
-        return 0.009406046080173251;
-      }
-    } else /* (grad > 7.0) */ {
-      if (prspace <= 0.023809523321688175) {
-        return 0.5186166688750498;
-      } else /* (prspace > 0.023809523321688175) */ {
-        return 0.8073099294583558;
-      }
-    }
-  } else /* (prspace > 0.050192078575491905) */ {
-    if (lspace_abs <= 15.0) {
-      return 0.9956150117952923;
-    } else /* (lspace_abs > 15.0) */ {
-      if (grad <= 6.0) {
-        return 0.287751801205705;
-      } else /* (grad > 6.0) */ {
-        if (grad <= 17.0) {
-          return 0.8895712641566001;
-        } else /* (grad > 17.0) */ {
-          return 0.5709700948212982;
-        }
-      }
-    }
-  }
   }
 
-  float classify_1(float lspace_abs, float grad, float prspace)
-  {
-  if (grad <= 5.0) {
-    if (prspace <= 0.015286649111658335) {
-      if (lspace_abs <= 1.0) {
-        if (prspace <= 0.0012019231216982007) {
-          return 0.23448713324461126;
-        } else /* (prspace > 0.0012019231216982007) */ {
-          return 0.5701066700938181;
-        }
-      } else /* (lspace_abs > 1.0) */ {
-        return 0.7509394870522096;
-      }
-    } else /* (prspace > 0.015286649111658335) */ {
-      if (lspace_abs <= 15.0) {
-        return 0.9902016678266132;
-      } else /* (lspace_abs > 15.0) */ {
-        if (prspace <= 0.05302507430315018) {
-          return 0.3559050064184852;
-        } else /* (prspace > 0.05302507430315018) */ {
-          return 0.9729120552826217;
-        }
-      }
-    }
-  } else /* (grad > 5.0) */ {
-    if (prspace <= 0.05557460896670818) {
-      return 0.00886907320584195;
-    } else /* (prspace > 0.05557460896670818) */ {
-      return 0.8568592722907037;
-    }
-  }
-  }
-
-  void entry_predictor(const float* lm, const float* rm, float colwidth, std::size_t n, uint8_t* out)
+  // Viterbi decoding of the entry starts knowing p[k][i] = p(line i starts an entry | line i-1 is in state k)
+  void entry_predictor(const float* p0, const float* p1, std::size_t n, uint8_t* out)
   {
     if (n == 0)
       return;
@@ -172,14 +68,7 @@ namespace
 
     for (std::size_t i = 1; i < n; ++i)
     {
-      float lspace_abs = lm[i];
-      float grad       = std::abs(lm[i] - lm[i - 1]);
-      float prspace    = rm[i - 1] / colwidth;
-
-      float p[2] = {
-        classify_0(lspace_abs, grad, prspace),
-        classify_1(lspace_abs, grad, prspace)
-      };
+      float p[2] = {p0[i], p1[i]};
 
       {
         float a = proba[0][i - 1] * p[0];
@@ -207,38 +96,13 @@ namespace
 
 
 
-  void DOMEntriesExtractor::visit(DOM::column_level_2* sec, void*)
+  void DOMEntriesExtractor::process(DOM::column_level_2* sec, const float* p0, const float* p1) const
   {
-    using mln::box2d;
-
-
-    int ymin   = sec->bbox.y;
-    int xmin   = sec->bbox.x;
-    int xmax   = sec->bbox.x1();
-
-    spdlog::debug("Start column x={}--{} y={} indent detection", xmin, xmax, ymin);
-
+    spdlog::debug("Start column x={}--{} y={} indent detection", sec->bbox.x, sec->bbox.x1(), sec->bbox.y);
 
-    std::size_t              nlines = sec->children.size();
-    std::vector<uint8_t>        is_entry_start(nlines, false);
-
-    // Compute the features
-    {
-      std::vector<float>       feat_buffer_1((nlines + 4), 0); // 2 rows for padding
-      std::vector<float>       feat_buffer_2((nlines + 4), 0); // 2 rows for padding
-
-      int                      colwidth = sec->bbox.width;
-      int i = 2;
-      for (auto& child : sec->children)
-      {
-        feat_buffer_1[i] = (child->bbox.x - xmin);  // float(colwidth);
-        feat_buffer_2[i] = (xmax - child->bbox.x1()); // float(colwidth);
-        i += 1;
-      }
-
-
-      entry_predictor(feat_buffer_1.data() + 2, feat_buffer_2.data() + 2, colwidth, nlines, is_entry_start.data());
-    }
+    std::size_t          nlines = sec->children.size();
+    std::vector<uint8_t> is_entry_start(nlines, false);
+    entry_predictor(p0, p1, nlines, is_entry_start.data());
 
 
     auto entry = std::make_unique<DOM::entry>();
@@ -276,9 +140,45 @@ namespace
 
 /// Detect the entries by merging lines (bottom -> up)
 void DOMEntriesExtraction(DOMElement* document, ApplicationData* data)
+{
+  DOMEntriesExtractor viz;
+  viz.traverse(document);
+  DOMEntriesExtraction(viz.columns, data);
+}
+
+void DOMEntriesExtraction(std::span<DOM::column_level_2* const> columns, ApplicationData* data)
 {
   DOMEntriesExtractor viz;
   viz.input = &(data->blocks);
   //viz.force_indent = force_indent;
-  document->accept(viz, nullptr);
+
+  const auto& model = EntryModel::current();
+  const int   nf    = EntryModel::kNumFeatures;
+  const int   ncol  = static_cast<int>(columns.size());
+
+  // The lines of all the columns are classified in a single batch (the column i owns the samples [offsets[i],
+  // offsets[i+1]))
+  std::vector<int> offsets(ncol + 1, 0);
+  for (int i = 0; i < ncol; ++i)
+    offsets[i + 1] = offsets[i] + static_cast<int>(columns[i]->children.size());
+
+  const int          n = offsets[ncol];
+  std::vector<float> features(n * nf);
+  std::vector<float> proba(2 * n);
+
+  auto& pool = ThreadPool::global();
+  pool.parallel_for(ncol, [&](int i) { column_features(columns[i], features.data() + offsets[i] * nf); });
+
+  constexpr int kChunkSize = 1024;
+  pool.parallel_for((n + kChunkSize - 1) / kChunkSize, [&](int c) {
+    int begin = c * kChunkSize;
+    int count = std::min(kChunkSize, n - begin);
+    for (int k = 0; k < 2; ++k)
+      model.classifier[k].predict(features.data() + begin * nf, count, proba.data() + k * n + begin);
+  });
+
+  // The decoding of the columns is independent
+  pool.parallel_for(ncol, [&](int i) {
+    viz.process(columns[i], proba.data() + offsets[i], proba.data() + n + offsets[i]);
+  });
 }
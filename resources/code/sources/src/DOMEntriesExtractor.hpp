@@ -3,6 +3,11 @@
 #include <DOMTypes.hpp>
 #include "InternalTypes.hpp"
 
+#include <span>
+
 
 /// Detect the entries by merging lines (bottom -> up)
 void DOMEntriesExtraction(DOMElement* document, ApplicationData* data);
+
+/// Detect the entries of some columns (the children of the columns must be lines)
+void DOMEntriesExtraction(std::span<DOM::column_level_2* const> columns, ApplicationData* data);
@@ -1,79 +1,210 @@
-#include "DOMExport.hpp"
+#include <DOMExport.hpp>
 
 #include <fstream>
-#include <nlohmann/json.hpp>
+#include <stdexcept>
 #include <fmt/format.h>
+#include <spdlog/spdlog.h>
 
 namespace
 {
-  // for convenience
-  using json = nlohmann::json;
+  constexpr int kFirstId = 0x100; // Elements 0-256 are reserved
 
-  class JSonExportVisitor : public DOMConstElementVisitor
+  /// Minimal JSON writer that appends to a buffer flushed to the output stream by chunks (or kept in memory if there
+  /// is no output stream)
+  class JsonWriter
   {
-    json* add_entry_base(const DOMElement* e, void* parent_id)
+  public:
+    static constexpr std::size_t kChunkSize = 1 << 16;
+
+    explicit JsonWriter(std::ostream* out)
+      : m_out{out}
     {
-      json  element;
+      if (m_out)
+        m_buffer.reserve(kChunkSize + 1024);
+    }
 
-      auto b          = e->bbox;
-      int  id         = m_id++;
-      element["id"]   = id;
+    ~JsonWriter() { flush(); }
 
-      if (parent_id)
-        element["parent"] = (int)(intptr_t)parent_id;
-      element["type"] = e->type_str();
-      element["box"]  = {b.x, b.y, b.width, b.height};
+    void raw(std::string_view s)
+    {
+      m_buffer.append(s);
+      if (m_buffer.size() >= kChunkSize)
+        flush();
+    }
 
-      if (!e->children.empty())
-        recurse(e, (void*)(intptr_t)id);
+    void raw(char c) { m_buffer.push_back(c); }
 
-      m_elements.push_back(std::move(element));
-      return &m_elements.back();
-    }
+    void integer(int v) { fmt::format_to(std::back_inserter(m_buffer), "{}", v); }
 
-    void add_entry(const DOMElement* e, void* parent_id)
+    void key(std::string_view k)
     {
-      add_entry_base(e, parent_id);
+      string(k);
+      raw(':');
     }
 
-    void add_entry(const DOM::TextualElement* e, void* parent_id)
+    /// Write a quoted string. The control characters, quotes and backslashes are escaped as in nlohmann::json and the
+    /// other characters are kept as is (UTF-8); an invalid UTF-8 sequence is replaced by U+FFFD.
+    void string(std::string_view s);
+
+    void flush()
     {
-      json* element       = add_entry_base(e, parent_id);
-      (*element)["text"] = e->text;
+      if (!m_out)
+        return;
+      m_out->write(m_buffer.data(), m_buffer.size());
+      m_buffer.clear();
     }
 
-  public:
-    JSonExportVisitor() = default;
+    /// Content of the buffer (everything that was written if there is no output stream)
+    std::string take() { return std::move(m_buffer); }
 
+  private:
+    std::ostream* m_out;
+    std::string   m_buffer;
+  };
 
-    virtual void visit(const DOM::page* e, void* parent_id) override { add_entry(e, parent_id); };
-    virtual void visit(const DOM::title_level_1* e, void* parent_id) override { add_entry(e, parent_id); };
-    virtual void visit(const DOM::title_level_2* e, void* parent_id) override { add_entry(e, parent_id); };
-    virtual void visit(const DOM::section_level_1* e, void* parent_id) override { add_entry(e, parent_id); };
-    virtual void visit(const DOM::section_level_2* e, void* parent_id) override { add_entry(e, parent_id); };
-    virtual void visit(const DOM::column_level_1* e, void* parent_id) override { add_entry(e, parent_id); };
-    virtual void visit(const DOM::column_level_2* e, void* parent_id) override { add_entry(e, parent_id); };
-    virtual void visit(const DOM::entry* e, void* parent_id) override { add_entry(e, parent_id); };
-    virtual void visit(const DOM::line* e, void* parent_id) override { add_entry(e, parent_id); };
 
+  // Length of the valid UTF-8 sequence at the beginning of s (0 if invalid)
+  int utf8_sequence_length(std::string_view s)
+  {
+    auto byte = [&](std::size_t i) { return static_cast<unsigned char>(s[i]); };
+    auto cont = [&](std::size_t i) { return i < s.size() && (byte(i) & 0xC0) == 0x80; };
+
+    unsigned char c = byte(0);
+    if (c < 0x80)
+      return 1;
+    if (c >= 0xC2 && c <= 0xDF)
+      return cont(1) ? 2 : 0;
+    if (c >= 0xE0 && c <= 0xEF)
+    {
+      if (!cont(1) || !cont(2))
+        return 0;
+      if ((c == 0xE0 && byte(1) < 0xA0) || (c == 0xED && byte(1) > 0x9F)) // Overlong or surrogate
+        return 0;
+      return 3;
+    }
+    if (c >= 0xF0 && c <= 0xF4)
+    {
+      if (!cont(1) || !cont(2) || !cont(3))
+        return 0;
+      if ((c == 0xF0 && byte(1) < 0x90) || (c == 0xF4 && byte(1) > 0x8F)) // Overlong or > U+10FFFF
+        return 0;
+      return 4;
+    }
+    return 0;
+  }
 
-    json get_root() const { return m_elements; }
+  void JsonWriter::string(std::string_view s)
+  {
+    raw('"');
+    std::size_t i = 0;
+    while (i < s.size())
+    {
+      const unsigned char c = s[i];
+      switch (c)
+      {
+      case '"':  raw("\\\""); i++; continue;
+      case '\\': raw("\\\\"); i++; continue;
+      case '\b': raw("\\b"); i++; continue;
+      case '\f': raw("\\f"); i++; continue;
+      case '\n': raw("\\n"); i++; continue;
+      case '\r': raw("\\r"); i++; continue;
+      case '\t': raw("\\t"); i++; continue;
+      }
+
+      if (c < 0x20)
+      {
+        fmt::format_to(std::back_inserter(m_buffer), "\\u{:04x}", c);
+        i++;
+        continue;
+      }
+
+      int n = utf8_sequence_length(s.substr(i));
+      if (n == 0)
+      {
+        raw("\xEF\xBF\xBD"); // U+FFFD
+        i++;
+        continue;
+      }
+      m_buffer.append(s.data() + i, n);
+      i += n;
+    }
+    raw('"');
+  }
 
 
-  private:
-    json        m_elements = json::array();
-    int         m_id = 0x100; // Elements 0-256 are reserved
-  };
+  void write_json(const FlatDOM& doc, JsonWriter& w)
+  {
+    // The children are listed before their parent. The keys are sorted (same output as a nlohmann::json dump).
+    w.raw('[');
+    bool first = true;
+    for (int i : doc.post_order())
+    {
+      if (!first)
+        w.raw(',');
+      first = false;
+
+      auto b = doc.bbox(i);
+      w.raw('{');
+      w.key("box");
+      w.raw('[');
+      w.integer(b.x);
+      w.raw(',');
+      w.integer(b.y);
+      w.raw(',');
+      w.integer(b.width);
+      w.raw(',');
+      w.integer(b.height);
+      w.raw("],");
+      w.key("id");
+      w.integer(kFirstId + i);
+      if (doc.parent(i) != FlatDOM::kNone)
+      {
+        w.raw(',');
+        w.key("parent");
+        w.integer(kFirstId + doc.parent(i));
+      }
+      if (FlatDOM::is_textual(doc.type(i)))
+      {
+        w.raw(',');
+        w.key("text");
+        w.string(doc.text(i));
+      }
+      w.raw(',');
+      w.key("type");
+      w.string(doc.type_str(i));
+      w.raw('}');
+    }
+    w.raw(']');
+  }
 } // namespace
 
 
-void DOMExport(const DOMElement* doc, const std::string& path)
+void DOMExport(const FlatDOM& doc, std::ostream& out)
 {
+  JsonWriter w(&out);
+  write_json(doc, w);
+}
 
-  JSonExportVisitor viz;
-  doc->accept(viz, nullptr);
-
+void DOMExport(const FlatDOM& doc, const std::string& path)
+{
   std::ofstream fs;
-  fs.open(path);
-  fs << viz.get_root();
+  fs.open(path, std::ios::binary);
+  if (!fs)
+  {
+    spdlog::error("Unable to open '{}' for writing.", path);
+    throw std::runtime_error("Unable to write the document (see logs)");
+  }
+  DOMExport(doc, fs);
+}
+
+void DOMExport(const DOMElement* doc, const std::string& path)
+{
+  DOMExport(FlatDOM(doc), path);
+}
+
+std::string DOMExportToString(const FlatDOM& doc)
+{
+  JsonWriter w(nullptr);
+  write_json(doc, w);
+  return w.take();
 }
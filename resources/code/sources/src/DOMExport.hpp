@@ -1,5 +0,0 @@
-#pragma once
-#include <DOMTypes.hpp>
-#include <string>
-
-void DOMExport(const DOMElement* doc, const std::string& path);
@@ -1,19 +1,23 @@
 #include "DOMLinesExtractor.hpp"
 
-#include <mln/core/image/view/operators.hpp>
+#include <mln/core/algorithm/copy.hpp>
 #include <mln/core/neighborhood/c4.hpp>
-#include <mln/core/se/periodic_line2d.hpp>
-#include <mln/core/se/rect2d.hpp>
 #include <mln/io/imsave.hpp>
 #include <mln/labeling/accumulate.hpp>
-#include <mln/morpho/closing.hpp>
 #include <mln/morpho/dynamic_filter.hpp>
-#include <mln/morpho/opening.hpp>
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <spdlog/spdlog.h>
 
 
 #include "watershed.hpp"
+#include "bit_image.hpp"
 #include "config.hpp"
 #include "gaussian_directional_2d.hpp"
+#include "line_morphology.hpp"
+#include "thread_pool.hpp"
 
 
 namespace
@@ -67,44 +71,144 @@ namespace
     return nlabel;
   }
 
-  struct BlurColumnVisitor : public DOMConstElementVisitor
+  // Collect the columns (column_level_2 nodes) of the document in the document order
+  struct ColumnCollector : public DOMStaticVisitor<ColumnCollector>
   {
-    const mln::image2d<uint8_t>* m_input;
-    mln::image2d<uint8_t>*       m_output;
-    mln::image2d<int16_t>*       m_line_markers;
-    int                                        nlabel = 0;
-
-
-    void visit(const DOM::page* e, void* extra) final { recurse(e, extra); }
-    void visit(const DOM::title_level_1* e, void* extra) final { recurse(e, extra); };
-    void visit(const DOM::title_level_2* e, void* extra) final { recurse(e, extra); };
-    void visit(const DOM::section_level_1* e, void* extra) final { recurse(e, extra); };
-    void visit(const DOM::section_level_2* e, void* extra) final { recurse(e, extra); };
-    void visit(const DOM::column_level_1* e, void* extra) final { recurse(e, extra); };
-    void visit(const DOM::entry*, void*) final{};
-    void visit(const DOM::line*, void*) final{};
-
-    void visit(const DOM::column_level_2* sec, void* extra) final;
+    std::vector<DOM::column_level_2*> columns;
+
+    void visit(DOM::column_level_2* e, std::nullptr_t) { columns.push_back(e); }
+    void visit(DOM::entry*, std::nullptr_t) {}
+    void visit(DOM::line*, std::nullptr_t) {}
   };
 
 
-  void BlurColumnVisitor::visit(const DOM::column_level_2* sec, void*)
+  // Box \p b inflated by \p dx (resp. \p dy) pixels on the left and right (resp. top and bottom) sides and clipped to
+  // the domain
+  mln::box2d inflate(mln::box2d b, int dx, int dy, mln::box2d domain)
   {
-    using mln::box2d;
+    int x0 = std::max(domain.x(), b.x() - dx);
+    int y0 = std::max(domain.y(), b.y() - dy);
+    int x1 = std::min(domain.x() + domain.width(), b.x() + b.width() + dx);
+    int y1 = std::min(domain.y() + domain.height(), b.y() + b.height() + dy);
+    return mln::box2d(x0, y0, x1 - x0, y1 - y0);
+  }
 
-    const box2d region(sec->bbox.x, sec->bbox.y, sec->bbox.width, sec->bbox.height);
 
+  // Part of each column that it owns in the label map. The columns of a split are inflated by margins, so neighbor
+  // columns overlap: the overlap is shared at its middle, along x for side-by-side columns (the overlap is narrower
+  // than high) and along y otherwise. Every pixel of the page then belongs to at most one column.
+  std::vector<mln::box2d> column_cores(const std::vector<mln::box2d>& regions)
+  {
+    std::vector<mln::box2d> cores = regions;
+
+    // Keep the part of \p b before \p mid (or after it) along the axis x (or y)
+    auto cut = [](mln::box2d b, int mid, bool along_x, bool before) {
+      int  x0 = b.x(), x1 = b.x() + b.width(), y0 = b.y(), y1 = b.y() + b.height();
+      int& lo = along_x ? x0 : y0;
+      int& hi = along_x ? x1 : y1;
+      if (before)
+        hi = std::min(hi, mid);
+      else
+        lo = std::max(lo, mid);
+      return mln::box2d(x0, y0, std::max(0, x1 - x0), std::max(0, y1 - y0));
+    };
 
-    const float kLineVerticalSigma = (kLineHeight * 0.5f) * 0.1f;
-    const float kLineHorizontalSigma = (kWordWidth * 0.5f) * 1.f;
+    const int n = static_cast<int>(regions.size());
+    for (int i = 0; i < n; ++i)
+      for (int j = i + 1; j < n; ++j)
+      {
+        const auto& a  = regions[i];
+        const auto& b  = regions[j];
+        const int   x0 = std::max(a.x(), b.x()), x1 = std::min(a.x() + a.width(), b.x() + b.width());
+        const int   y0 = std::max(a.y(), b.y()), y1 = std::min(a.y() + a.height(), b.y() + b.height());
+        if (x0 >= x1 || y0 >= y1)
+          continue;
+
+        // a is before b if its center is before the one of b
+        const bool along_x  = (x1 - x0) <= (y1 - y0);
+        const int  mid      = along_x ? (x0 + x1) / 2 : (y0 + y1) / 2;
+        const bool a_before = along_x ? (2 * a.x() + a.width() <= 2 * b.x() + b.width())
+                                      : (2 * a.y() + a.height() <= 2 * b.y() + b.height());
+        cores[i] = cut(cores[i], mid, along_x, a_before);
+        cores[j] = cut(cores[j], mid, along_x, !a_before);
+      }
+    return cores;
+  }
+
+
+  // Images of the line segmentation of a column. They are defined on the box of the column extended by a halo
+  // (except the opening that is only defined on the column).
+  struct column_lines_t
+  {
+    mln::box2d            region;
+    mln::image2d<uint8_t> opened;
+    mln::image2d<uint8_t> blurred;
+    mln::image2d<uint8_t> closed;
+    mln::image2d<int16_t> ws;         // Line labels in [1, nlabel] (0 = waterline)
+    int                   nlabel = 0;
+
+    // Intermediate images only kept for the debug outputs (kDebugLevel > 1)
+    mln::image2d<uint8_t> rect_closed; // Before the dynamic closing
+    mln::image2d<int16_t> markers;     // Before the watershed
+  };
+
+
+  // Segment the lines of a column. The result is the same as the segmentation of a page where the column would be
+  // alone: the halos are large enough for the SE extents and the blurred image is white outside the column.
+  column_lines_t segment_column_lines(const mln::image2d<uint8_t>& input, mln::box2d region)
+  {
+    const float   kLineVerticalSigma   = (kLineHeight * 0.5f) * 0.1f;
+    const float   kLineHorizontalSigma = (kWordWidth * 0.5f) * 1.f;
+    const int     kOpeningHalfWidth    = kLayoutBlockOpeningWidth / 2;
+    const int     kClosingWidth        = static_cast<int>((kWordWidth / 2.f) + 0.5f);
+    const int     kClosingHeight       = static_cast<int>((kLineHeight / 2.f) / 3.f + 0.5f);
+    constexpr int kClosingDynamic      = 15;
 
-    auto out = m_output->clip(region);
-    mln::copy(m_input->clip(region), out);
-    gaussian2d(out, kLineHorizontalSigma, kLineVerticalSigma, 255);
+    column_lines_t col;
+    col.region = region;
 
+    // 1. Opening with a horizontal SE to give matters to letters (merge letter/words but not lines)
+    {
+      auto roi   = inflate(region, 2 * kOpeningHalfWidth, 0, input.domain());
+      col.opened = layout::hline_opening(input.clip(roi), kOpeningHalfWidth).clip(region);
+    }
+
+    // 2. Blur the column and prepare WS markers
+    const mln::box2d halo = inflate(region, 2 * (kClosingWidth / 2), 2 * (kClosingHeight / 2), input.domain());
+
+    mln::image2d<int16_t> markers;
+    {
+      auto sub = input.clip(halo);
+      mln::resize(col.blurred, sub).set_init_value(uint8_t(255));
+      mln::resize(markers, sub).set_init_value(int16_t(0));
+
+      auto out = col.blurred.clip(region);
+      mln::copy(col.opened, out);
+      gaussian2d(out, kLineHorizontalSigma, kLineVerticalSigma, 255);
+
+      // Labelize the minima
+      col.nlabel = labelize_local_min_of_first_col(col.blurred, markers, region, 0);
+    }
+
+    // 3. Closing
+    col.closed = layout::rect_closing(col.blurred, kClosingWidth, kClosingHeight);
+    if (kDebugLevel > 1)
+      col.rect_closed = col.closed;
+    col.closed = mln::morpho::dynamic_closing(col.closed, mln::c4, kClosingDynamic);
+
+    // 4. Watershed transform
+    if (kDebugLevel > 1)
+    {
+      mln::resize(col.markers, markers);
+      mln::copy(markers, col.markers);
+    }
+    if (kNativeWatershed)
+      impl::watershed_u8(col.closed, markers, col.nlabel);
+    else
+      impl::watershed(col.closed, mln::c4, markers, col.nlabel);
+    col.ws = markers;
 
-    // Labelize the minima
-    nlabel = labelize_local_min_of_first_col(*m_output, *m_line_markers, region, nlabel);
+    return col;
   }
 
 
@@ -151,132 +255,360 @@ namespace
   };
 
 
-  class DOMLineBuilder : public DOMElementVisitor
+
+  // Rows ranges [y0, y1) (relative to the column) of the lines detected by projection
+  using row_ranges_t = std::vector<std::pair<int, int>>;
+
+  // Detect the lines of a column with the horizontal projection profile of its text pixels: the lines are the runs
+  // of rows with text, separated by the valleys (rows without text). Runs closer than a few pixels are merged (accents,
+  // dots) as well as the runs too thin to be a line (merged with the closest neighbor).
+  row_ranges_t detect_projection_lines(const BitImage& text, mln::box2d region)
   {
-    const mln::image2d<uint8_t>* m_input;
-    const mln::image2d<int16_t>* m_ws;
-    int                                        m_nlabel;
-
-  public:
-    DOMLineBuilder(const mln::image2d<uint8_t>& input, const mln::image2d<int16_t>& ws, int nlabel)
-      : m_input(&input)
-      , m_ws(&ws)
-      , m_nlabel(nlabel)
+    const int kMaxMergeGap    = static_cast<int>(kLineHeight / 10.f + 0.5f);
+    const int kMinLineHeight  = static_cast<int>(kLineHeight / 4.f + 0.5f);
+    const int kMaxAttachedGap = static_cast<int>(kLineHeight / 2.f + 0.5f);
+    const int kMinInk         = std::max(1, region.width() / 100); // Minimal number of text pixels of a text row
+
+    std::vector<int> profile(region.height());
+    text.count_along_x(region, profile.data());
+
+    row_ranges_t runs;
+    for (int y = 0; y < region.height();)
     {
-    }
+      if (profile[y] < kMinInk)
+      {
+        y++;
+        continue;
+      }
+      int y0 = y;
+      while (y < region.height() && profile[y] >= kMinInk)
+        y++;
 
+      if (!runs.empty() && y0 - runs.back().second < kMaxMergeGap)
+        runs.back().second = y;
+      else
+        runs.push_back({y0, y});
+    }
 
-    void visit(DOM::page* e, void* extra) final { recurse(e, extra); }
-    void visit(DOM::title_level_1* e, void* extra) final { recurse(e, extra); };
-    void visit(DOM::title_level_2* e, void* extra) final { recurse(e, extra); };
-    void visit(DOM::section_level_1* e, void* extra) final { recurse(e, extra); };
-    void visit(DOM::section_level_2* e, void* extra) final { recurse(e, extra); };
-    void visit(DOM::column_level_1* e, void* extra) final { recurse(e, extra); };
-    void visit(DOM::entry*, void*) final{/* throw std::logical_error("Unsupported op."); */};
-    void visit(DOM::line*, void*) final{/* throw std::logical_error("Unsupported op."); */};
-    void visit(DOM::column_level_2* sec, void* extra) final;
-  };
+    // Attach the thin runs to their closest neighbor
+    row_ranges_t lines;
+    for (std::size_t i = 0; i < runs.size(); ++i)
+    {
+      auto [y0, y1] = runs[i];
+      if (y1 - y0 >= kMinLineHeight)
+      {
+        lines.push_back(runs[i]);
+        continue;
+      }
 
+      int gap_before = lines.empty() ? INT_MAX : y0 - lines.back().second;
+      int gap_after  = (i + 1 < runs.size()) ? runs[i + 1].first - y1 : INT_MAX;
+      if (gap_before <= gap_after && gap_before < kMaxAttachedGap)
+        lines.back().second = y1;
+      else if (gap_after < kMaxAttachedGap)
+        runs[i + 1].first = y0;
+      else
+        lines.push_back(runs[i]);
+    }
+    return lines;
+  }
 
-  void DOMLineBuilder::visit(DOM::column_level_2* sec, void*)
+  // Return true if the lines detected by projection look reliable: enough lines, none of them is higher than a text
+  // line (touching lines or residual skew) and the line pitch is regular
+  bool are_projection_lines_regular(const row_ranges_t& lines)
   {
-    using mln::box2d;
-    using namespace mln::view::ops;
+    constexpr std::size_t kMinNumberOfLines = 3;
+    constexpr float       kMaxPitchCV       = 0.2f; // Maximal coefficient of variation of the line pitch
 
-    const box2d region(sec->bbox.x, sec->bbox.y, sec->bbox.width, sec->bbox.height);
+    if (lines.size() < kMinNumberOfLines)
+      return false;
 
-    //const float kLineVerticalSigma = (kLineHeight / 2.f) / 10.f;
-    //const float kLineHorizontalSigma = (kWordWidth / 2.f);
+    for (auto [y0, y1] : lines)
+      if (y1 - y0 > 1.5f * kLineHeight)
+        return false;
 
-    auto ws = m_ws->clip(region);
-    auto input = m_input->clip(region);
-    auto tmp = mln::view::ifelse(input < kLayoutWhiteLevel, ws, int16_t(0));
-    auto boxes = mln::labeling::accumulate(tmp, m_nlabel, bbox{});
+    float sum = 0, sum2 = 0;
+    int   n   = static_cast<int>(lines.size()) - 1;
+    for (int i = 0; i < n; ++i)
+    {
+      float pitch = (lines[i + 1].first + lines[i + 1].second - lines[i].first - lines[i].second) / 2.f;
+      sum += pitch;
+      sum2 += pitch * pitch;
+    }
+    float mean = sum / n;
+    float var  = std::max(0.f, sum2 / n - mean * mean);
+    return std::sqrt(var) <= kMaxPitchCV * mean;
+  }
+
+  // Label map of a column segmented by projection: the rows between two lines are split at the middle of the valley
+  // (waterline) and the rows before the first line/after the last line go to the first/last one
+  column_lines_t make_projection_column_lines(const mln::image2d<uint8_t>& input, mln::box2d region,
+                                               const row_ranges_t& lines)
+  {
+    column_lines_t col;
+    col.region = region;
+    col.nlabel = static_cast<int>(lines.size());
+    mln::resize(col.ws, input.clip(region)).set_init_value(int16_t(0));
 
-    for (int i = 1; i <= m_nlabel; ++i)
+    int y = 0;
+    for (int i = 0; i < col.nlabel; ++i)
     {
-      if (!boxes[i].empty())
+      int end = (i + 1 < col.nlabel) ? (lines[i].second + lines[i + 1].first) / 2 : region.height();
+      for (; y < end; ++y)
       {
-        auto node = std::make_unique<DOM::line>();
+        int16_t* lineptr = col.ws.buffer() + y * col.ws.stride();
+        std::fill_n(lineptr, region.width(), static_cast<int16_t>(i + 1));
+      }
+      y = end + 1; // Waterline
+    }
+    return col;
+  }
+
+
+  // Bounding boxes of the text pixels of every label of the page (single pass, only the set bits of the mask are
+  // visited)
+  std::vector<mln::box2d> line_bboxes(const BitImage& text, const mln::image2d<int16_t>& ws, int nlabel)
+  {
+    std::vector<bbox> acc(nlabel + 1);
+    text.for_each_set(text.domain(), [&](mln::point2d p) { acc[ws(p)].take(p); });
 
-        node->label = i;
-        node->bbox  = {boxes[i].x(), boxes[i].y(), boxes[i].width(), boxes[i].height()};
-        sec->add_child_node(std::move(node));
+    std::vector<mln::box2d> boxes(nlabel + 1);
+    std::transform(acc.begin(), acc.end(), boxes.begin(), [](const bbox& a) { return a.to_result(); });
+    return boxes;
+  }
+
+
+  // Segment the lines of a column with the engine \p mode
+  column_lines_t segment_column(const mln::image2d<uint8_t>& input, const BitImage& text, mln::box2d region,
+                                LineSegmentation mode)
+  {
+    if (mode != LineSegmentation::WATERSHED)
+    {
+      auto lines = detect_projection_lines(text, region);
+      if (mode == LineSegmentation::PROJECTION || are_projection_lines_regular(lines))
+      {
+        spdlog::debug("Column x={} y={}: {} lines detected by projection", region.x(), region.y(), lines.size());
+        return make_projection_column_lines(input, region, lines);
       }
     }
+    return segment_column_lines(input, region);
+  }
+
+
+  // Copy the values of \p col in \p region (labels > 0 are shifted by \p label_offset)
+  template <class T>
+  void stitch(const mln::image2d<T>& col, mln::box2d region, mln::image2d<T>& page, int label_offset = -1)
+  {
+    if (region.empty())
+      return;
+
+    auto in  = col.clip(region);
+    auto out = page.clip(region);
+    for (int y = 0; y < region.height(); ++y)
+    {
+      const T* src = in.buffer() + y * in.stride();
+      T*       dst = out.buffer() + y * out.stride();
+      for (int x = 0; x < region.width(); ++x)
+        if (label_offset < 0)
+          dst[x] = src[x];
+        else if (src[x] > 0)
+          dst[x] = static_cast<T>(src[x] + label_offset);
+    }
   }
 
 } // namespace
 
 
 /// Detect the lines and stores them as new DOM::Line nodes
-void DOMLinesExtraction(DOMElement* document, ApplicationData* data)
+///
+/// Every column is segmented independently (in parallel) and the labels of its lines are shifted so that the labels
+/// of the page are numbered in the document order and are contiguous for each column. The page-level label map is
+/// the union of the columns ones (0 outside the columns), each column being written on its core only (see
+/// column_cores), so that a line that crosses the boundary between two columns is split at the seam instead of
+/// being overwritten by the next column.
+void DOMLinesExtraction(DOMElement* document, ApplicationData* data, LineSegmentation mode)
 {
-  using mln::point2d;
-
-  // Opening with a horizontal SE to give matters to letters (merge letter/words but not lines)
-  mln::image2d<uint8_t> f;
+  ColumnCollector collector;
+  collector.traverse(document);
+
+  auto&                       columns = collector.columns;
+  const int                   n       = static_cast<int>(columns.size());
+  std::vector<column_lines_t> results(n);
+  std::vector<mln::box2d>     regions(n);
+  for (int i = 0; i < n; ++i)
   {
-    mln::se::periodic_line2d l(point2d{1,0}, kLayoutBlockOpeningWidth / 2);
-    f = mln::morpho::opening(data->input, l);
-
-    if (kDebugLevel > 1)
-      mln::io::imsave(f, "ws-input.tiff");
+    const Box& b = columns[i]->bbox;
+    regions[i]   = mln::box2d(b.x, b.y, b.width, b.height);
   }
+  const auto cores = column_cores(regions);
 
-  mln::image2d<uint8_t> blurred;
-  mln::resize(blurred, f).set_init_value(uint8_t(255));
+  BitImage text(data->input, kLayoutWhiteLevel);
 
-  mln::image2d<int16_t> markers;
-  mln::resize(markers, f).set_init_value(0);
+  ThreadPool::global().parallel_for(n, [&](int i) {
+    results[i] = segment_column(data->input, text, regions[i], mode); //
+  });
 
+  // Labels of the column i start after label_offsets[i]
+  std::vector<int> label_offsets(n + 1, 0);
+  for (int i = 0; i < n; ++i)
+    label_offsets[i + 1] = label_offsets[i] + results[i].nlabel;
 
-  // 1. Blur the image in columns only and prepare WS markers
-  BlurColumnVisitor viz;
-  viz.m_input = &f;
-  viz.m_output = &blurred;
-  viz.m_line_markers = &markers;
-  document->accept(viz, nullptr);
+  mln::image2d<int16_t> ws;
+  mln::resize(ws, data->input).set_init_value(int16_t(0));
+  for (int i = 0; i < n; ++i)
+    stitch(results[i].ws, cores[i], ws, label_offsets[i]);
 
   if (kDebugLevel > 1)
+  {
+    mln::image2d<uint8_t> opened, blurred, rect_closed, closed;
+    mln::image2d<int16_t> markers;
+    mln::resize(opened, data->input).set_init_value(uint8_t(255));
+    mln::resize(blurred, data->input).set_init_value(uint8_t(255));
+    mln::resize(rect_closed, data->input).set_init_value(uint8_t(255));
+    mln::resize(closed, data->input).set_init_value(uint8_t(255));
+    mln::resize(markers, data->input).set_init_value(int16_t(0));
+    for (int i = 0; i < n; ++i)
+    {
+      const auto& col = results[i];
+      if (col.blurred.domain().empty()) // Segmented by projection
+        continue;
+      stitch(col.opened, cores[i], opened);
+      stitch(col.blurred, cores[i], blurred);
+      stitch(col.rect_closed, cores[i], rect_closed);
+      stitch(col.closed, cores[i], closed);
+      stitch(col.markers, cores[i], markers, label_offsets[i]);
+    }
+    mln::io::imsave(opened, "ws-input.tiff");
     mln::io::imsave(blurred, "ws-blurred.tiff");
+    mln::io::imsave(rect_closed, "ws-clo-1.tiff");
+    mln::io::imsave(closed, "ws-clo-2.tiff");
+    mln::io::imsave(markers, "markers.tiff");
+    mln::io::imsave(ws, "ws.tiff");
+  }
 
-  // 2. Closing
-  auto r   = mln::se::rect2d(static_cast<int>((kWordWidth / 2.f) + 0.5f),
-                                           static_cast<int>((kLineHeight / 2.f) / 3.f + 0.5f));
-  auto clo = mln::morpho::closing(blurred, r);
+  // Compute the bounding box and insert lines. The labels of a column are contiguous, so the lines are dispatched
+  // to their column by label range (in label order).
+  {
+    auto boxes = line_bboxes(text, ws, label_offsets[n]);
 
-  if (kDebugLevel > 1)
-    mln::io::imsave(clo, "ws-clo-1.tiff");
+    for (int i = 0; i < n; ++i)
+      for (int l = label_offsets[i] + 1; l <= label_offsets[i + 1]; ++l)
+      {
+        if (boxes[l].empty())
+          continue;
 
-  constexpr int kClosingDynamic = 15;
-  clo = mln::morpho::dynamic_closing(clo,  mln::c4, kClosingDynamic);
+        auto node = std::make_unique<DOM::line>();
 
-  if (kDebugLevel > 1)
-    mln::io::imsave(clo, "ws-clo-2.tiff");
+        node->label = l;
+        node->bbox  = {boxes[l].x(), boxes[l].y(), boxes[l].width(), boxes[l].height()};
+        columns[i]->add_child_node(std::move(node));
+      }
+  }
 
+  data->ws = ws;
+}
 
-  // 3. Watershed transform
 
-  if (kDebugLevel > 1)
-    mln::io::imsave(markers, "markers.tiff");
+/// The label map is at the scale of the document (it has been upsampled with the document), so the labels of a column
+/// are upsampled in the same way (nearest neighbor) before being written in the map. As for the whole page, a column
+/// only owns its core: the overlaps with the other columns of the document (reprocessed or not) are shared at the seam.
+void DOMLinesExtraction(DOMElement* document, std::span<DOM::column_level_2* const> columns, ApplicationData* data,
+                        LineSegmentation mode, int upscale)
+{
+  const int                   n = static_cast<int>(columns.size());
+  std::vector<column_lines_t> results(n);
+  std::vector<mln::box2d>     cores(n); // Cores of the columns in the label map
+
+  {
+    ColumnCollector collector;
+    collector.traverse(document);
 
-  int  nlabel = viz.nlabel;
-  impl::watershed(clo, mln::c4, markers, nlabel);
+    const auto&             all = collector.columns;
+    std::vector<mln::box2d> regions(all.size());
+    std::transform(all.begin(), all.end(), regions.begin(),
+                   [](auto* c) { return mln::box2d(c->bbox.x, c->bbox.y, c->bbox.width, c->bbox.height); });
+    const auto all_cores = column_cores(regions);
 
-  auto ws = markers;
+    for (int i = 0; i < n; ++i)
+    {
+      auto it  = std::find(all.begin(), all.end(), columns[i]);
+      cores[i] = (it != all.end()) ? all_cores[it - all.begin()]
+                                   : mln::box2d(columns[i]->bbox.x, columns[i]->bbox.y, columns[i]->bbox.width,
+                                                columns[i]->bbox.height);
+    }
+  }
 
-  if (kDebugLevel > 1)
-    mln::io::imsave(ws, "ws.tiff");
+  BitImage text(data->input, kLayoutWhiteLevel);
+
+  ThreadPool::global().parallel_for(n, [&](int i) {
+    const Box& b = columns[i]->bbox;
+    results[i]   = segment_column(data->input, text,
+                                  mln::box2d(b.x / upscale, b.y / upscale, b.width / upscale, b.height / upscale), mode);
+  });
 
+  // Remove the previous labels of the columns, the new labels start after the ones of the other columns
+  auto& ws = data->ws;
+  for (auto r : cores)
+  {
+    if (r.empty())
+      continue;
+    auto out = ws.clip(r);
+    for (int y = 0; y < r.height(); ++y)
+      std::fill_n(out.buffer() + y * out.stride(), r.width(), int16_t(0));
+  }
 
-  // 4. Compute the bounding box and insert lines
+  int nlabel = 0;
+  for (int y = 0; y < ws.height(); ++y)
   {
-    DOMLineBuilder viz(data->input, ws, nlabel);
-    document->accept(viz, nullptr);
+    const int16_t* lineptr = ws.buffer() + y * ws.stride();
+    nlabel                 = std::max(nlabel, static_cast<int>(*std::max_element(lineptr, lineptr + ws.width())));
   }
 
+  int total = nlabel;
+  for (const auto& col : results)
+    total += col.nlabel;
+  if (total > INT16_MAX)
+  {
+    spdlog::error("Too many lines in the label map ({}).", total);
+    throw std::runtime_error("Unable to reprocess the lines (see logs)");
+  }
 
-  //auto wsup = upsample(ws, input.domain());
-  data->ws = ws;
+  const float sx = static_cast<float>(data->input.width()) / ws.width();
+  const float sy = static_cast<float>(data->input.height()) / ws.height();
+  for (int i = 0; i < n; ++i)
+  {
+    const auto& col = results[i];
+    const auto& r   = cores[i];
+
+    // Same mapping as upsample()
+    for (int y = r.y(); y < r.y() + r.height(); ++y)
+      for (int x = r.x(); x < r.x() + r.width(); ++x)
+      {
+        mln::point2d q = {static_cast<int>(x * sx), static_cast<int>(y * sy)};
+        if (col.region.has(q) && col.ws(q) > 0)
+          ws({x, y}) = static_cast<int16_t>(col.ws(q) + nlabel);
+      }
+
+    // Bounding boxes of the lines on the core at the scale of the input, then of the document
+    const int x0 = std::max(col.region.x(), r.x() / upscale);
+    const int y0 = std::max(col.region.y(), r.y() / upscale);
+    const int x1 = std::min(col.region.x() + col.region.width(), (r.x() + r.width()) / upscale);
+    const int y1 = std::min(col.region.y() + col.region.height(), (r.y() + r.height()) / upscale);
+
+    std::vector<bbox> acc(col.nlabel + 1);
+    if (x0 < x1 && y0 < y1)
+      text.for_each_set(mln::box2d(x0, y0, x1 - x0, y1 - y0), [&](mln::point2d p) { acc[col.ws(p)].take(p); });
+    for (int l = 1; l <= col.nlabel; ++l)
+    {
+      auto b = acc[l].to_result();
+      if (b.empty())
+        continue;
+
+      auto node   = std::make_unique<DOM::line>();
+      node->label = l + nlabel;
+      node->bbox  = {b.x() * upscale, b.y() * upscale, b.width() * upscale, b.height() * upscale};
+      columns[i]->add_child_node(std::move(node));
+    }
+    nlabel += col.nlabel;
+  }
 }
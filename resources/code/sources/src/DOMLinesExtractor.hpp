@@ -1,10 +1,20 @@
 #pragma once
 
+#include <Application.hpp>
 #include <DOMTypes.hpp>
 #include <CoreTypes.hpp>
 #include "InternalTypes.hpp"
 
+#include <span>
+
 
 
 /// Detect the lines and stores them as new DOM::Line nodes
-void DOMLinesExtraction(DOMElement* document, ApplicationData* data);
+void DOMLinesExtraction(DOMElement* document, ApplicationData* data,
+                        LineSegmentation mode = LineSegmentation::WATERSHED);
+
+/// Detect again the lines of some columns of \p document (the columns must not have children). The coordinates of the
+/// document are \p upscale times the ones of the input image. The label map is updated in the columns and the new
+/// lines get labels that are not used by the other columns.
+void DOMLinesExtraction(DOMElement* document, std::span<DOM::column_level_2* const> columns, ApplicationData* data,
+                        LineSegmentation mode, int upscale);
@@ -38,7 +38,8 @@ namespace
   using Tree_t = spatial::RTree<int, tree_element_t, 2, 8, 4, Indexable>;
 
 
-  struct TextExtractorVisitor : public DOMElementVisitor
+  // The context is the y of the enclosing block (base of the line grid)
+  struct TextExtractorVisitor : public DOMStaticVisitor<TextExtractorVisitor, DOMElement, int>
   {
     Tree_t* rtree;
 
@@ -70,15 +71,16 @@ namespace
       }
     }
 
-    virtual void visit(DOM::page* e, void*) override { recurse(e, (void*)(intptr_t)e->bbox.y); };
-    virtual void visit(DOM::title_level_1* e, void*) override { extract_text(e, e->bbox.y); };
-    virtual void visit(DOM::title_level_2* e, void*) override { extract_text(e, e->bbox.y); };
-    virtual void visit(DOM::section_level_1* e, void*) override { recurse(e, (void*)(intptr_t)e->bbox.y); };
-    virtual void visit(DOM::section_level_2* e, void*) override { recurse(e, (void*)(intptr_t)e->bbox.y); };
-    virtual void visit(DOM::column_level_1* e, void*) override { recurse(e, (void*)(intptr_t)e->bbox.y); };
-    virtual void visit(DOM::column_level_2* e, void*) override { recurse(e, (void*)(intptr_t)e->bbox.y); };
-    virtual void visit(DOM::entry* e, void* arg) override { recurse(e, (void*)(intptr_t)e->bbox.y); };
-    virtual void visit(DOM::line* e, void* arg) override { extract_text(e, (intptr_t)arg); };
+    void visit(DOM::title_level_1* e, int) { extract_text(e, e->bbox.y); };
+    void visit(DOM::title_level_2* e, int) { extract_text(e, e->bbox.y); };
+    void visit(DOM::line* e, int block_base) { extract_text(e, block_base); };
+
+    // The other nodes are blocks
+    template <class T>
+    void visit(T* e, int)
+    {
+      recurse(e, e->bbox.y);
+    }
   };
 }
 
@@ -93,5 +95,5 @@ void DOMTextExtraction(DOMElement* document, ApplicationData* data)
   viz.rtree = &rtree;
 
 
-  document->accept(viz, nullptr);
+  viz.traverse(document, 0);
 }
@@ -3,6 +3,11 @@
 #include <DOMTypes.hpp>
 #include "InternalTypes.hpp"
 
+#include <span>
+
 
 /// Attach the text of the lines and stores them in DOM::Line nodes
 void DOMTextExtraction(DOMElement* document, ApplicationData* data);
+
+/// Attach the text of the textual elements of some nodes of the document
+void DOMTextExtraction(std::span<DOMElement* const> nodes, ApplicationData* data);
@@ -7,22 +7,23 @@
 
 namespace
 {
-  class TextExtractorVisitor : public DOMElementVisitor
+  class TextExtractorVisitor : public DOMStaticVisitor<TextExtractorVisitor>
   {
   private:
     tesseract::TessBaseAPI m_api;
 
   public:
 
+    // The engine is created for each page, so that the text of a page cannot depend on the pages processed before it
+    // by the same thread
     TextExtractorVisitor(ApplicationData* data)
       {
-
-        if (m_api.Init(NULL, "fra")) {
+        if (m_api.Init(NULL, "fra"))
+        {
           spdlog::error("Could not initialize tesseract.");
           throw std::runtime_error("Could not initialize tesseract");
         }
-        else
-          spdlog::info("Tesseract has been initialized.");
+        spdlog::info("Tesseract has been initialized.");
 
         auto ima = data->deskewed.image;
         m_api.SetPageSegMode(tesseract::PSM_SINGLE_BLOCK);
@@ -48,15 +49,10 @@ namespace
     }
 
 
-    virtual void visit(DOM::page* e, void*) override { recurse(e, nullptr); };
-    virtual void visit(DOM::title_level_1* e, void*) override { extract_text(e); };
-    virtual void visit(DOM::title_level_2* e, void*) override { extract_text(e); };
-    virtual void visit(DOM::section_level_1* e, void*) override { recurse(e, nullptr); };
-    virtual void visit(DOM::section_level_2* e, void*) override { recurse(e, nullptr); };
-    virtual void visit(DOM::column_level_1* e, void*) override { recurse(e, nullptr); };
-    virtual void visit(DOM::column_level_2* e, void*) override { recurse(e, nullptr); };
-    virtual void visit(DOM::entry* e, void*) override { extract_text(e); };
-    virtual void visit(DOM::line*, void*) override { ; };
+    void visit(DOM::title_level_1* e, std::nullptr_t) { extract_text(e); };
+    void visit(DOM::title_level_2* e, std::nullptr_t) { extract_text(e); };
+    void visit(DOM::entry* e, std::nullptr_t) { extract_text(e); };
+    void visit(DOM::line*, std::nullptr_t) { ; };
   };
 } // namespace
 
@@ -64,5 +60,12 @@ namespace
 void DOMTextExtraction(DOMElement* document, ApplicationData* data)
 {
   TextExtractorVisitor viz(data);
-  document->accept(viz, nullptr);
+  viz.traverse(document);
+}
+
+void DOMTextExtraction(std::span<DOMElement* const> nodes, ApplicationData* data)
+{
+  TextExtractorVisitor viz(data);
+  for (auto* e : nodes)
+    viz.traverse(e);
 }
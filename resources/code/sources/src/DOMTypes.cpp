@@ -1,4 +1,5 @@
 #include <DOMTypes.hpp>
+#include <stdexcept>
 #include <string>
 #include <unordered_map>
 
@@ -99,9 +100,84 @@ std::unique_ptr<DOMElement> DOMElement::create_node(std::string_view cat)
   return DOMElement::create_node(str2enum.at(cat));
 }
 
+std::unique_ptr<DOMElement> DOMElement::create_tree(std::vector<std::unique_ptr<DOMElement>> nodes,
+                                                    const std::vector<int>& parents)
+{
+  const int n       = static_cast<int>(nodes.size());
+  auto      element = [](int i) { return "The DOM element #" + std::to_string(i); };
+
+  int                           root = -1;
+  std::vector<std::vector<int>> children(n);
+  for (int i = 0; i < n; ++i)
+  {
+    const int p = parents[i];
+    if (p == -1)
+    {
+      if (root != -1)
+        throw std::invalid_argument("The DOM has several roots (#" + std::to_string(root) + " and #" +
+                                    std::to_string(i) + ")");
+      root = i;
+    }
+    else if (p < 0 || p >= n)
+      throw std::invalid_argument(element(i) + " has an invalid parent");
+    else if (p == i)
+      throw std::invalid_argument(element(i) + " is its own parent");
+    else
+      children[p].push_back(i);
+  }
+  if (root == -1)
+    throw std::invalid_argument("The DOM has no root");
+
+  // Every node must be reachable from the root. The others are on a parent cycle or hang from one.
+  std::vector<bool> reached(n, false);
+  std::vector<int>  stack = {root};
+  reached[root]           = true;
+  while (!stack.empty())
+  {
+    int i = stack.back();
+    stack.pop_back();
+    for (int c : children[i])
+    {
+      reached[c] = true;
+      stack.push_back(c);
+    }
+  }
+
+  for (int i = 0; i < n; ++i)
+  {
+    if (reached[i])
+      continue;
+
+    // Follow the parents until a node repeats: if it is i, i is on the cycle
+    std::vector<bool> on_path(n, false);
+    int               j = i;
+    while (!on_path[j])
+    {
+      on_path[j] = true;
+      j          = parents[j];
+    }
+    throw std::invalid_argument(element(i) + ((j == i) ? " is its own ancestor" : " is not reachable from the root") +
+                                " (parent cycle)");
+  }
+
+  // The links are valid: attach the children in the order of the nodes
+  std::vector<DOMElement*> ptrs(n);
+  for (int i = 0; i < n; ++i)
+    ptrs[i] = nodes[i].get();
+  for (int i = 0; i < n; ++i)
+    if (i != root)
+      ptrs[parents[i]]->children.push_back(std::move(nodes[i]));
+  return std::move(nodes[root]);
+}
+
+std::string_view to_string(DOMCategory cat)
+{
+  return enum2str[(int)cat];
+}
+
 std::string_view DOMElement::type_str() const
 {
-  return enum2str[(int)this->type()];
+  return to_string(this->type());
 }
 
 
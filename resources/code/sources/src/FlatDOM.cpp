@@ -0,0 +1,150 @@
+#include <FlatDOM.hpp>
+
+#include <algorithm>
+
+
+bool FlatDOM::is_textual(DOMCategory cat)
+{
+  switch (cat)
+  {
+  case DOMCategory::TITLE_LEVEL_1:
+  case DOMCategory::TITLE_LEVEL_2:
+  case DOMCategory::ENTRY:
+  case DOMCategory::LINE:
+    return true;
+  default:
+    return false;
+  }
+}
+
+
+FlatDOM::FlatDOM(const DOMElement* document)
+{
+  // Iterative depth-first traversal (the children are pushed in reverse order so that they are popped in order)
+  std::vector<std::pair<const DOMElement*, int32_t>> stack = {{document, kNone}};
+  std::vector<int32_t>                               last_child;
+
+  m_text_offsets.push_back(0);
+  while (!stack.empty())
+  {
+    auto [e, parent] = stack.back();
+    stack.pop_back();
+
+    const int32_t i   = size();
+    const auto    cat = e->type();
+    m_type.push_back(cat);
+    m_bbox.push_back(e->bbox);
+    m_parent.push_back(parent);
+    m_first_child.push_back(kNone);
+    m_next_sibling.push_back(kNone);
+    m_end.push_back(i + 1);
+    last_child.push_back(kNone);
+
+    if (parent != kNone)
+    {
+      if (last_child[parent] == kNone)
+        m_first_child[parent] = i;
+      else
+        m_next_sibling[last_child[parent]] = i;
+      last_child[parent] = i;
+    }
+
+    if (is_textual(cat))
+      m_text += static_cast<const DOM::TextualElement*>(e)->text;
+    m_text_offsets.push_back(static_cast<uint32_t>(m_text.size()));
+
+    if (cat == DOMCategory::LINE)
+    {
+      auto* l = static_cast<const DOM::line*>(e);
+      m_label.push_back(l->label);
+      m_flags.push_back((l->indented ? INDENTED : 0) | (l->reach_EOL ? REACH_EOL : 0));
+    }
+    else
+    {
+      m_label.push_back(0);
+      m_flags.push_back(0);
+    }
+
+    for (auto c = e->children.rbegin(); c != e->children.rend(); ++c)
+      stack.push_back({c->get(), i});
+  }
+
+  // A subtree ends where the subtree of its last child ends
+  for (int32_t i = size() - 1; i > 0; --i)
+    m_end[m_parent[i]] = std::max(m_end[m_parent[i]], m_end[i]);
+}
+
+
+std::unique_ptr<DOMElement> FlatDOM::to_tree() const
+{
+  if (empty())
+    return nullptr;
+
+  std::vector<std::unique_ptr<DOMElement>> nodes(size());
+  std::vector<DOMElement*>                 ptrs(size());
+
+  for (int i = 0; i < size(); ++i)
+  {
+    auto node  = DOMElement::create_node(m_type[i]);
+    node->bbox = m_bbox[i];
+    if (is_textual(m_type[i]))
+      static_cast<DOM::TextualElement*>(node.get())->text = text(i);
+    if (m_type[i] == DOMCategory::LINE)
+    {
+      auto* l      = static_cast<DOM::line*>(node.get());
+      l->label     = m_label[i];
+      l->indented  = m_flags[i] & INDENTED;
+      l->reach_EOL = m_flags[i] & REACH_EOL;
+    }
+    ptrs[i]  = node.get();
+    nodes[i] = std::move(node);
+  }
+
+  // The children are after their parent in pre-order, so they are attached in order
+  for (int i = 1; i < size(); ++i)
+    ptrs[m_parent[i]]->children.push_back(std::move(nodes[i]));
+  return std::move(nodes[0]);
+}
+
+
+std::string_view FlatDOM::type_str(int i) const
+{
+  return to_string(m_type[i]);
+}
+
+std::string_view FlatDOM::text(int i) const
+{
+  return std::string_view(m_text).substr(m_text_offsets[i], m_text_offsets[i + 1] - m_text_offsets[i]);
+}
+
+
+std::vector<int32_t> FlatDOM::post_order() const
+{
+  // A node is emitted once the scan leaves its subtree
+  std::vector<int32_t> out;
+  std::vector<int32_t> open;
+  out.reserve(size());
+  for (int32_t i = 0; i < size(); ++i)
+  {
+    while (!open.empty() && m_end[open.back()] <= i)
+    {
+      out.push_back(open.back());
+      open.pop_back();
+    }
+    open.push_back(i);
+  }
+  out.insert(out.end(), open.rbegin(), open.rend());
+  return out;
+}
+
+
+void FlatDOM::scale(float s)
+{
+  for (auto& b : m_bbox)
+  {
+    b.x *= s;
+    b.y *= s;
+    b.width *= s;
+    b.height *= s;
+  }
+}
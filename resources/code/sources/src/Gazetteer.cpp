@@ -0,0 +1,333 @@
+#include <Gazetteer.hpp>
+
+#include "file_io.hpp"
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+
+namespace Gazetteer
+{
+  namespace
+  {
+    // Code points of a UTF-8 string (the invalid bytes are kept as single code points)
+    std::u32string decode(std::string_view s)
+    {
+      std::u32string out;
+      out.reserve(s.size());
+      for (std::size_t i = 0; i < s.size();)
+      {
+        unsigned char c = s[i];
+        int           n  = (c < 0x80) ? 1 : ((c & 0xE0) == 0xC0) ? 2 : ((c & 0xF0) == 0xE0) ? 3 : ((c & 0xF8) == 0xF0) ? 4 : 0;
+        char32_t      cp = (n == 1) ? c : (n == 2) ? (c & 0x1F) : (n == 3) ? (c & 0x0F) : (c & 0x07);
+
+        bool valid = n > 0 && i + n <= s.size();
+        for (int k = 1; valid && k < n; ++k)
+        {
+          unsigned char cc = s[i + k];
+          valid            = (cc & 0xC0) == 0x80;
+          cp               = (cp << 6) | (cc & 0x3F);
+        }
+
+        if (!valid)
+        {
+          out.push_back(0xDC00 + c); // As the 'surrogateescape' error handler of python
+          i += 1;
+        }
+        else
+        {
+          out.push_back(cp);
+          i += n;
+        }
+      }
+      return out;
+    }
+
+
+    // Depth-first traversal of the trie that computes the rows of the Levenshtein matrix between the word and the
+    // prefixes (the traversal of a subtree stops when all the distances of the row exceed the bound)
+    struct search_t
+    {
+      const gaz_node_record_t* nodes;
+      std::u32string_view      word;
+      int                      max_distance;
+      std::vector<int>         rows; // One row per depth
+
+      int best  = -1; // Distance of the best match
+      int count = 0;
+      int index = -1; // Index of the best match
+
+      void visit(const gaz_node_record_t& node, std::size_t depth)
+      {
+        const std::size_t m     = word.size();
+        const int*        prev  = rows.data() + depth * (m + 1);
+        int               bound = (best < 0) ? max_distance : best;
+
+        if (node.word >= 0 && prev[m] <= bound)
+        {
+          if (prev[m] < best || best < 0)
+          {
+            best  = prev[m];
+            count = 0;
+            index = node.word;
+          }
+          ++count;
+          bound = best;
+        }
+
+        if ((depth + 2) * (m + 1) > rows.size())
+          rows.resize((depth + 2) * (m + 1));
+        prev = rows.data() + depth * (m + 1);
+
+        for (uint32_t k = 0; k < node.num_children; ++k)
+        {
+          const auto& child = nodes[node.first_child + k];
+          int*        row   = rows.data() + (depth + 1) * (m + 1);
+          row[0]            = prev[0] + 1;
+          int row_min       = row[0];
+          for (std::size_t j = 1; j <= m; ++j)
+          {
+            row[j]  = std::min({prev[j] + 1, row[j - 1] + 1, prev[j - 1] + (word[j - 1] != child.cp)});
+            row_min = std::min(row_min, row[j]);
+          }
+
+          if (row_min <= bound)
+          {
+            visit(child, depth + 1);
+            bound = (best < 0) ? max_distance : best;
+            prev  = rows.data() + depth * (m + 1); // The rows may have been reallocated
+          }
+        }
+      }
+    };
+
+
+    struct trie_node_t
+    {
+      std::map<char32_t, int> children;
+      int                     word = -1;
+    };
+  } // namespace
+
+
+  Dictionary::Dictionary(const gaz_dict_header_t* header)
+    : m_words{reinterpret_cast<const gaz_word_record_t*>(header + 1)}
+    , m_nodes{reinterpret_cast<const gaz_node_record_t*>(m_words + header->num_words)}
+    , m_strings{reinterpret_cast<const char*>(m_nodes + header->num_nodes)}
+    , m_num_words{header->num_words}
+    , m_max_word_length{header->max_word_length}
+  {
+  }
+
+  std::string_view Dictionary::word(std::size_t i) const
+  {
+    return std::string_view(m_strings + m_words[i].word_offset, m_words[i].word_size);
+  }
+
+  std::string_view Dictionary::value(std::size_t i) const
+  {
+    return std::string_view(m_strings + m_words[i].value_offset, m_words[i].value_size);
+  }
+
+  int Dictionary::find(std::string_view w) const
+  {
+    std::size_t lo = 0, hi = m_num_words;
+    while (lo < hi)
+    {
+      std::size_t mid = (lo + hi) / 2;
+      if (word(mid) < w)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+    return (lo < m_num_words && word(lo) == w) ? static_cast<int>(lo) : -1;
+  }
+
+  bool Dictionary::contains(std::string_view w) const
+  {
+    return find(w) >= 0;
+  }
+
+  std::optional<std::string_view> Dictionary::get(std::string_view w) const
+  {
+    int i = find(w);
+    if (i < 0)
+      return std::nullopt;
+    return value(i);
+  }
+
+  std::optional<match_t> Dictionary::best_match(std::string_view w, int max_distance) const
+  {
+    if (m_num_words == 0 || max_distance < 0)
+      return std::nullopt;
+
+    auto s = decode(w);
+    if (s.size() > m_max_word_length + max_distance)
+      return std::nullopt;
+
+    search_t search{m_nodes, s, max_distance, {}};
+    search.rows.resize(s.size() + 1);
+    for (std::size_t j = 0; j <= s.size(); ++j)
+      search.rows[j] = static_cast<int>(j);
+    search.visit(m_nodes[0], 0);
+
+    if (search.index < 0)
+      return std::nullopt;
+    return match_t{word(search.index), search.best, search.count};
+  }
+
+  std::vector<std::optional<match_t>> Dictionary::best_matches(std::span<const std::string> words,
+                                                               int                          max_distance) const
+  {
+    std::vector<std::optional<match_t>> out(words.size());
+    ThreadPool::global().parallel_for(static_cast<int>(words.size()),
+                                      [&](int i) { out[i] = best_match(words[i], max_distance); });
+    return out;
+  }
+
+
+  Reader::Reader(const std::string& path)
+    : m_file(path, sizeof(gaz_file_header_t), "gazetteer")
+  {
+    // Validate the whole file once so that the searches are plain pointer offsets
+    const std::byte*  data = m_file.data();
+    const std::size_t size = m_file.size();
+    auto              fail = [&](const char* msg) { m_file.invalid(msg); };
+
+    auto* h = reinterpret_cast<const gaz_file_header_t*>(data);
+    if (std::memcmp(h->magic, kMagic, sizeof(kMagic)) != 0)
+      fail("bad magic number");
+    if (h->version != kVersion)
+      fail("unsupported version");
+    if (sizeof(gaz_file_header_t) + std::size_t(h->num_dicts) * sizeof(gaz_dict_index_t) > size)
+      fail("truncated index");
+
+    auto* index = reinterpret_cast<const gaz_dict_index_t*>(h + 1);
+    for (uint32_t i = 0; i < h->num_dicts; ++i)
+    {
+      const auto& e = index[i];
+      if (e.offset % 8 != 0 || e.offset > size || e.size > size - e.offset || e.size < sizeof(gaz_dict_header_t))
+        fail("dictionary out of bounds");
+
+      auto* dh = reinterpret_cast<const gaz_dict_header_t*>(data + e.offset);
+      if (sizeof(gaz_dict_header_t) + std::size_t(dh->num_words) * sizeof(gaz_word_record_t) +
+              std::size_t(dh->num_nodes) * sizeof(gaz_node_record_t) + dh->strings_size >
+          e.size)
+        fail("truncated dictionary");
+      if (dh->num_nodes == 0)
+        fail("missing root");
+
+      auto* words = reinterpret_cast<const gaz_word_record_t*>(dh + 1);
+      auto* nodes = reinterpret_cast<const gaz_node_record_t*>(words + dh->num_words);
+      for (uint32_t k = 0; k < dh->num_words; ++k)
+      {
+        const auto& r = words[k];
+        if (uint64_t(r.word_offset) + r.word_size > dh->strings_size ||
+            uint64_t(r.value_offset) + r.value_size > dh->strings_size)
+          fail("string out of bounds");
+      }
+      // The children must follow their parent (so that the traversal of the trie terminates)
+      for (uint32_t k = 0; k < dh->num_nodes; ++k)
+      {
+        const auto& n = nodes[k];
+        if ((n.num_children > 0 && n.first_child <= k) || uint64_t(n.first_child) + n.num_children > dh->num_nodes)
+          fail("node out of bounds");
+        if (n.word >= 0 && uint32_t(n.word) >= dh->num_words)
+          fail("word out of bounds");
+      }
+    }
+  }
+
+  std::size_t Reader::size() const
+  {
+    return reinterpret_cast<const gaz_file_header_t*>(m_file.data())->num_dicts;
+  }
+
+  Dictionary Reader::dictionary(std::size_t i) const
+  {
+    if (i >= size())
+      throw std::out_of_range("No such dictionary in the gazetteer");
+
+    auto* h     = reinterpret_cast<const gaz_file_header_t*>(m_file.data());
+    auto* index = reinterpret_cast<const gaz_dict_index_t*>(h + 1);
+    return Dictionary(reinterpret_cast<const gaz_dict_header_t*>(m_file.data() + index[i].offset));
+  }
+
+
+  void Writer::add_dictionary(const std::map<std::string, std::string>& entries)
+  {
+    std::string                    strings;
+    std::vector<gaz_word_record_t> words;
+    std::vector<trie_node_t>       trie(1);
+    std::size_t                    max_word_length = 0;
+
+    // The map is sorted by word (UTF-8 byte order is the code point order)
+    words.reserve(entries.size());
+    for (const auto& [word, value] : entries)
+    {
+      gaz_word_record_t r;
+      r.word_offset = static_cast<uint32_t>(strings.size());
+      r.word_size   = static_cast<uint32_t>(word.size());
+      strings.append(word);
+      r.value_offset = static_cast<uint32_t>(strings.size());
+      r.value_size   = static_cast<uint32_t>(value.size());
+      strings.append(value);
+
+      auto cps        = decode(word);
+      max_word_length = std::max(max_word_length, cps.size());
+
+      int node = 0;
+      for (char32_t c : cps)
+      {
+        auto [it, inserted] = trie[node].children.try_emplace(c, static_cast<int>(trie.size()));
+        if (inserted)
+          trie.emplace_back();
+        node = it->second;
+      }
+      trie[node].word = static_cast<int>(words.size());
+      words.push_back(r);
+    }
+
+    // Breadth-first layout so that the children of a node are contiguous
+    std::vector<gaz_node_record_t> nodes;
+    std::vector<int>               order = {0};
+    nodes.reserve(trie.size());
+    for (std::size_t i = 0; i < order.size(); ++i)
+    {
+      const auto& n = trie[order[i]];
+      nodes.push_back({static_cast<uint32_t>(order.size()), static_cast<uint32_t>(n.children.size()), 0, n.word});
+      for (auto [c, child] : n.children)
+        order.push_back(child);
+    }
+    for (std::size_t i = 0; i < order.size(); ++i)
+    {
+      uint32_t k = nodes[i].first_child;
+      for (auto [c, child] : trie[order[i]].children)
+        nodes[k++].cp = c;
+    }
+
+    std::string       block;
+    gaz_dict_header_t dh = {static_cast<uint32_t>(words.size()), static_cast<uint32_t>(nodes.size()),
+                            static_cast<uint32_t>(strings.size()), static_cast<uint32_t>(max_word_length)};
+    BlockFile::append(block, dh);
+    block.append(reinterpret_cast<const char*>(words.data()), words.size() * sizeof(gaz_word_record_t));
+    block.append(reinterpret_cast<const char*>(nodes.data()), nodes.size() * sizeof(gaz_node_record_t));
+    block.append(strings);
+    m_dicts.push_back(std::move(block));
+  }
+
+  void Writer::save(const std::string& path) const
+  {
+    gaz_file_header_t h = {};
+    std::memcpy(h.magic, kMagic, sizeof(kMagic));
+    h.version   = kVersion;
+    h.num_dicts = static_cast<uint32_t>(m_dicts.size());
+
+    std::vector<std::string_view> blocks(m_dicts.begin(), m_dicts.end());
+    replace_file(path, BlockFile::pack(h, blocks, [&](std::size_t i, uint64_t offset) {
+                   return gaz_dict_index_t{offset, blocks[i].size()};
+                 }));
+  }
+} // namespace Gazetteer
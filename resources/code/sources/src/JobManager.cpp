@@ -0,0 +1,221 @@
+#include <JobManager.hpp>
+
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <stdexcept>
+
+
+namespace
+{
+  class JobProgress : public Progress
+  {
+  public:
+    void Update(int value) final { m_value.store(value, std::memory_order_relaxed); }
+    int  Value() const { return m_value.load(std::memory_order_relaxed); }
+
+  private:
+    std::atomic<int> m_value = 0;
+  };
+} // namespace
+
+
+struct JobManager::Job
+{
+  int                          id;
+  std::string                  uri;
+  int                          page;
+  JobOptions                   options;
+  JobProgress                  progress;
+  std::atomic<State>           state = State::PENDING;
+  std::string                  error; // Guarded by the mutex of the manager
+  std::unique_ptr<Application> result;
+
+  std::chrono::steady_clock::time_point finished; // Guarded by the mutex of the manager
+
+  bool is_finished() const { return state != State::PENDING && state != State::RUNNING; }
+};
+
+
+JobManager::JobManager(int workers, std::chrono::seconds ttl, std::size_t max_finished)
+  : m_ttl{ttl}
+  , m_max_finished{max_finished}
+{
+  for (int i = 0; i < std::max(workers, 1); ++i)
+    m_workers.emplace_back([this] { worker_loop(); });
+}
+
+JobManager::~JobManager()
+{
+  {
+    std::lock_guard lock(m_mutex);
+    m_stop = true;
+    for (auto& [id, job] : m_jobs)
+      job->progress.Cancel();
+    for (auto& job : m_queue)
+      job->state = State::CANCELED;
+    m_queue.clear();
+  }
+  m_cv.notify_all();
+  for (auto& w : m_workers)
+    w.join();
+}
+
+int JobManager::submit(std::string uri, int page, JobOptions options)
+{
+  auto job     = std::make_shared<Job>();
+  job->uri     = std::move(uri);
+  job->page    = page;
+  job->options = options;
+  {
+    std::lock_guard lock(m_mutex);
+    evict();
+    job->id = m_next_id++;
+    m_jobs.emplace(job->id, job);
+    m_queue.push_back(job);
+  }
+  m_cv.notify_one();
+  return job->id;
+}
+
+JobManager::Status JobManager::status(int job_id)
+{
+  std::lock_guard lock(m_mutex);
+  evict();
+  auto            it = m_jobs.find(job_id);
+  if (it == m_jobs.end())
+    throw std::out_of_range("No such job");
+
+  const auto& job = *it->second;
+  State       s   = job.state;
+  return {s, (s == State::DONE) ? 100 : job.progress.Value(), (s == State::FAILED) ? job.error : std::string{}};
+}
+
+std::unique_ptr<Application> JobManager::result(int job_id)
+{
+  std::lock_guard lock(m_mutex);
+  auto            it = m_jobs.find(job_id);
+  if (it == m_jobs.end())
+    throw std::out_of_range("No such job");
+
+  auto job = it->second;
+  switch (job->state.load())
+  {
+  case State::PENDING:
+  case State::RUNNING:
+    return nullptr;
+  case State::DONE:
+    m_jobs.erase(it);
+    return std::move(job->result);
+  case State::FAILED:
+    m_jobs.erase(it);
+    throw std::runtime_error("The job has failed: " + job->error);
+  case State::CANCELED:
+    break;
+  }
+  m_jobs.erase(it);
+  throw std::runtime_error("The job has been canceled");
+}
+
+bool JobManager::cancel(int job_id)
+{
+  std::lock_guard lock(m_mutex);
+  auto            it = m_jobs.find(job_id);
+  if (it == m_jobs.end())
+    return false;
+
+  auto& job = it->second;
+  switch (job->state.load())
+  {
+  case State::PENDING:
+    m_queue.erase(std::find(m_queue.begin(), m_queue.end(), job));
+    job->state    = State::CANCELED;
+    job->finished = std::chrono::steady_clock::now();
+    break;
+  case State::RUNNING:
+    job->progress.Cancel(); // The worker sets the state when the pipeline returns
+    break;
+  default:
+    m_jobs.erase(it);
+    break;
+  }
+  return true;
+}
+
+void JobManager::worker_loop()
+{
+  while (true)
+  {
+    std::shared_ptr<Job> job;
+    {
+      std::unique_lock lock(m_mutex);
+      m_cv.wait(lock, [this] { return m_stop || !m_queue.empty(); });
+      if (m_stop)
+        return;
+      job = std::move(m_queue.front());
+      m_queue.pop_front();
+      job->state = State::RUNNING;
+    }
+
+    std::unique_ptr<Application> app;
+    std::string                  error;
+    try
+    {
+      app = std::make_unique<Application>(job->uri, job->page, &job->progress, job->options.deskew_only,
+                                          job->options.lines);
+    }
+    catch (const std::exception& e)
+    {
+      spdlog::error("Job {} ({} page {}) failed: {}", job->id, job->uri, job->page, e.what());
+      error = e.what();
+      if (error.empty())
+        error = "unknown error";
+    }
+    catch (...)
+    {
+      spdlog::error("Job {} ({} page {}) failed: unknown exception", job->id, job->uri, job->page);
+      error = "unknown error";
+    }
+
+    std::lock_guard lock(m_mutex);
+    job->finished = std::chrono::steady_clock::now();
+    if (!error.empty())
+    {
+      job->error = std::move(error);
+      job->state = State::FAILED;
+    }
+    else if (job->progress.IsCanceled())
+    {
+      job->state = State::CANCELED;
+    }
+    else
+    {
+      job->result = std::move(app);
+      job->state  = State::DONE;
+    }
+  }
+}
+
+void JobManager::evict()
+{
+  const auto now = std::chrono::steady_clock::now();
+
+  std::vector<std::map<int, std::shared_ptr<Job>>::iterator> finished;
+  for (auto it = m_jobs.begin(); it != m_jobs.end();)
+  {
+    if (!it->second->is_finished())
+      ++it;
+    else if (now - it->second->finished >= m_ttl)
+      it = m_jobs.erase(it);
+    else
+      finished.push_back(it++);
+  }
+
+  if (finished.size() <= m_max_finished)
+    return;
+
+  // Release the oldest ones
+  auto excess = finished.begin() + (finished.size() - m_max_finished);
+  std::nth_element(finished.begin(), excess, finished.end(),
+                   [](const auto& a, const auto& b) { return a->second->finished < b->second->finished; });
+  std::for_each(finished.begin(), excess, [this](const auto& it) { m_jobs.erase(it); });
+}
@@ -0,0 +1,480 @@
+#include <TextNormalize.hpp>
+
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <string_view>
+
+
+namespace TextNormalize
+{
+  namespace
+  {
+    // Properties of a character (as defined by the 'regex' python module and str.isspace)
+    enum : uint8_t
+    {
+      WORD  = 1, // \w
+      UPPER = 2, // [[:upper:]]
+      LOWER = 4, // [[:lower:]]
+      SPACE = 8, // \s
+    };
+
+    struct char_info_t
+    {
+      char32_t    cp;
+      uint8_t     props;
+      char32_t    lower; // str.lower()
+      const char* ascii; // unidecode()
+    };
+
+    // Non-ASCII characters handled (sorted)
+    constexpr char_info_t kCharTable[] = {
+    {0x00A0, SPACE, 0x00A0, " "}, // space
+    {0x00AB, 0, 0x00AB, "<<"}, // «
+    {0x00B0, 0, 0x00B0, "deg"}, // °
+    {0x00BB, 0, 0x00BB, ">>"}, // »
+    {0x00C0, WORD | UPPER, 0x00E0, "A"}, // À
+    {0x00C1, WORD | UPPER, 0x00E1, "A"}, // Á
+    {0x00C2, WORD | UPPER, 0x00E2, "A"}, // Â
+    {0x00C3, WORD | UPPER, 0x00E3, "A"}, // Ã
+    {0x00C4, WORD | UPPER, 0x00E4, "A"}, // Ä
+    {0x00C5, WORD | UPPER, 0x00E5, "A"}, // Å
+    {0x00C6, WORD | UPPER, 0x00E6, "AE"}, // Æ
+    {0x00C7, WORD | UPPER, 0x00E7, "C"}, // Ç
+    {0x00C8, WORD | UPPER, 0x00E8, "E"}, // È
+    {0x00C9, WORD | UPPER, 0x00E9, "E"}, // É
+    {0x00CA, WORD | UPPER, 0x00EA, "E"}, // Ê
+    {0x00CB, WORD | UPPER, 0x00EB, "E"}, // Ë
+    {0x00CC, WORD | UPPER, 0x00EC, "I"}, // Ì
+    {0x00CD, WORD | UPPER, 0x00ED, "I"}, // Í
+    {0x00CE, WORD | UPPER, 0x00EE, "I"}, // Î
+    {0x00CF, WORD | UPPER, 0x00EF, "I"}, // Ï
+    {0x00D0, WORD | UPPER, 0x00F0, "D"}, // Ð
+    {0x00D1, WORD | UPPER, 0x00F1, "N"}, // Ñ
+    {0x00D2, WORD | UPPER, 0x00F2, "O"}, // Ò
+    {0x00D3, WORD | UPPER, 0x00F3, "O"}, // Ó
+    {0x00D4, WORD | UPPER, 0x00F4, "O"}, // Ô
+    {0x00D5, WORD | UPPER, 0x00F5, "O"}, // Õ
+    {0x00D6, WORD | UPPER, 0x00F6, "O"}, // Ö
+    {0x00D7, 0, 0x00D7, "x"}, // ×
+    {0x00D8, WORD | UPPER, 0x00F8, "O"}, // Ø
+    {0x00D9, WORD | UPPER, 0x00F9, "U"}, // Ù
+    {0x00DA, WORD | UPPER, 0x00FA, "U"}, // Ú
+    {0x00DB, WORD | UPPER, 0x00FB, "U"}, // Û
+    {0x00DC, WORD | UPPER, 0x00FC, "U"}, // Ü
+    {0x00DD, WORD | UPPER, 0x00FD, "Y"}, // Ý
+    {0x00DE, WORD | UPPER, 0x00FE, "Th"}, // Þ
+    {0x00DF, WORD | LOWER, 0x00DF, "ss"}, // ß
+    {0x00E0, WORD | LOWER, 0x00E0, "a"}, // à
+    {0x00E1, WORD | LOWER, 0x00E1, "a"}, // á
+    {0x00E2, WORD | LOWER, 0x00E2, "a"}, // â
+    {0x00E3, WORD | LOWER, 0x00E3, "a"}, // ã
+    {0x00E4, WORD | LOWER, 0x00E4, "a"}, // ä
+    {0x00E5, WORD | LOWER, 0x00E5, "a"}, // å
+    {0x00E6, WORD | LOWER, 0x00E6, "ae"}, // æ
+    {0x00E7, WORD | LOWER, 0x00E7, "c"}, // ç
+    {0x00E8, WORD | LOWER, 0x00E8, "e"}, // è
+    {0x00E9, WORD | LOWER, 0x00E9, "e"}, // é
+    {0x00EA, WORD | LOWER, 0x00EA, "e"}, // ê
+    {0x00EB, WORD | LOWER, 0x00EB, "e"}, // ë
+    {0x00EC, WORD | LOWER, 0x00EC, "i"}, // ì
+    {0x00ED, WORD | LOWER, 0x00ED, "i"}, // í
+    {0x00EE, WORD | LOWER, 0x00EE, "i"}, // î
+    {0x00EF, WORD | LOWER, 0x00EF, "i"}, // ï
+    {0x00F0, WORD | LOWER, 0x00F0, "d"}, // ð
+    {0x00F1, WORD | LOWER, 0x00F1, "n"}, // ñ
+    {0x00F2, WORD | LOWER, 0x00F2, "o"}, // ò
+    {0x00F3, WORD | LOWER, 0x00F3, "o"}, // ó
+    {0x00F4, WORD | LOWER, 0x00F4, "o"}, // ô
+    {0x00F5, WORD | LOWER, 0x00F5, "o"}, // õ
+    {0x00F6, WORD | LOWER, 0x00F6, "o"}, // ö
+    {0x00F7, 0, 0x00F7, "/"}, // ÷
+    {0x00F8, WORD | LOWER, 0x00F8, "o"}, // ø
+    {0x00F9, WORD | LOWER, 0x00F9, "u"}, // ù
+    {0x00FA, WORD | LOWER, 0x00FA, "u"}, // ú
+    {0x00FB, WORD | LOWER, 0x00FB, "u"}, // û
+    {0x00FC, WORD | LOWER, 0x00FC, "u"}, // ü
+    {0x00FD, WORD | LOWER, 0x00FD, "y"}, // ý
+    {0x00FE, WORD | LOWER, 0x00FE, "th"}, // þ
+    {0x00FF, WORD | LOWER, 0x00FF, "y"}, // ÿ
+    {0x0152, WORD | UPPER, 0x0153, "OE"}, // Œ
+    {0x0153, WORD | LOWER, 0x0153, "oe"}, // œ
+    {0x2009, SPACE, 0x2009, " "}, // space
+    {0x2013, 0, 0x2013, "-"}, // –
+    {0x2014, 0, 0x2014, "--"}, // —
+    {0x2018, 0, 0x2018, "'"}, // ‘
+    {0x2019, 0, 0x2019, "'"}, // ’
+    {0x201C, 0, 0x201C, "\""}, // “
+    {0x201D, 0, 0x201D, "\""}, // ”
+    {0x2022, 0, 0x2022, "*"}, // •
+    {0x2026, 0, 0x2026, "..."}, // …
+    {0x202F, SPACE, 0x202F, " "}, // space
+    };
+
+    // Abbreviations replaced by remove_abbrv (same as __abbrv)
+    constexpr std::pair<std::string_view, std::string_view> kAbbreviations[] = {
+      {"av", "avenue"},      {"barr", "barrière"}, {"b", "boulevard"},   {"boul", "boulevard"},
+      {"boulev", "boulevard"}, {"carref", "carrefour"}, {"chem", "chemin"}, {"ch", "chemin"},
+      {"cloit", "cloitre"},  {"faub", "faubourg"},  {"fb", "faubourg"},   {"germ", "germain"},
+      {"imp", "impasse"},    {"impas", "impasse"},  {"pas", "passage"},   {"pass", "passage"},
+      {"p", "place"},        {"pl", "place"},       {"s", "saint"},       {"st", "saint"},
+      {"ste", "sainte"},     {"nve", "neuve"},
+    };
+
+    constexpr char32_t kBullet = 0x2022;
+
+    using text_t = std::u32string;
+
+
+    const char_info_t* find_char(char32_t c)
+    {
+      auto it = std::lower_bound(std::begin(kCharTable), std::end(kCharTable), c,
+                                 [](const char_info_t& x, char32_t v) { return x.cp < v; });
+      return (it != std::end(kCharTable) && it->cp == c) ? it : nullptr;
+    }
+
+    bool is_ascii_space(char32_t c) { return c == ' ' || (c >= '\t' && c <= '\r'); }
+
+    uint8_t props(char32_t c)
+    {
+      if (c < 0x80)
+      {
+        if ((c >= 'a' && c <= 'z'))
+          return WORD | LOWER;
+        if ((c >= 'A' && c <= 'Z'))
+          return WORD | UPPER;
+        if ((c >= '0' && c <= '9') || c == '_')
+          return WORD;
+        return is_ascii_space(c) ? SPACE : 0;
+      }
+      auto* info = find_char(c);
+      return info ? info->props : 0;
+    }
+
+    bool is_word(const text_t& s, std::size_t i) { return i < s.size() && (props(s[i]) & WORD); }
+    bool is_space(char32_t c) { return props(c) & SPACE; }
+
+    // \b before the position i
+    bool word_boundary(const text_t& s, std::size_t i) { return is_word(s, i) != (i > 0 && is_word(s, i - 1)); }
+
+
+    // Decode the text (std::nullopt if it is not valid UTF-8 or has a character that is not handled)
+    std::optional<text_t> decode(std::string_view s)
+    {
+      text_t out;
+      out.reserve(s.size());
+      for (std::size_t i = 0; i < s.size();)
+      {
+        unsigned char c = s[i];
+        char32_t      cp;
+        int           n;
+        if (c < 0x80)
+          cp = c, n = 1;
+        else if ((c & 0xE0) == 0xC0)
+          cp = c & 0x1F, n = 2;
+        else if ((c & 0xF0) == 0xE0)
+          cp = c & 0x0F, n = 3;
+        else if ((c & 0xF8) == 0xF0)
+          cp = c & 0x07, n = 4;
+        else
+          return std::nullopt;
+
+        if (i + n > s.size())
+          return std::nullopt;
+        for (int k = 1; k < n; ++k)
+        {
+          unsigned char cc = s[i + k];
+          if ((cc & 0xC0) != 0x80)
+            return std::nullopt;
+          cp = (cp << 6) | (cc & 0x3F);
+        }
+        i += n;
+
+        bool handled = (cp >= '\t' && cp <= '\r') || (cp >= 0x20 && cp < 0x7F) || find_char(cp);
+        if (!handled)
+          return std::nullopt;
+        out.push_back(cp);
+      }
+      return out;
+    }
+
+    void append_utf8(std::string& out, char32_t cp)
+    {
+      if (cp < 0x80)
+        out.push_back(static_cast<char>(cp));
+      else if (cp < 0x800)
+      {
+        out.push_back(static_cast<char>(0xC0 | (cp >> 6)));
+        out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+      }
+      else
+      {
+        out.push_back(static_cast<char>(0xE0 | (cp >> 12)));
+        out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+      }
+    }
+
+    std::string encode(const text_t& s)
+    {
+      std::string out;
+      out.reserve(s.size());
+      for (char32_t c : s)
+        append_utf8(out, c);
+      return out;
+    }
+
+    void append(text_t& out, std::string_view utf8)
+    {
+      out.append(*decode(utf8));
+    }
+
+
+    // Length of the group '([^)]+)' at the position i (0 if there is none)
+    std::size_t parenthesis_group(const text_t& s, std::size_t i)
+    {
+      if (s[i] != '(')
+        return 0;
+      auto j = s.find(')', i + 1);
+      return (j == text_t::npos || j == i + 1) ? 0 : j - i + 1;
+    }
+
+    // Abbreviation of places/rues at the position i: \b(\L<abrv>)([.,;:-]) (case insensitive)
+    bool match_place_abbreviation(const text_t& s, std::size_t i, std::size_t& len, std::string_view& full)
+    {
+      if (!word_boundary(s, i))
+        return false;
+
+      std::string word;
+      std::size_t k = i;
+      for (; k < s.size() && s[k] < 0x80 && std::isalpha(static_cast<int>(s[k])); ++k)
+        word.push_back(static_cast<char>(std::tolower(static_cast<int>(s[k]))));
+      if (word.empty() || k == s.size() || std::u32string_view(U".,;:-").find(s[k]) == std::u32string_view::npos)
+        return false;
+
+      for (auto [abbrv, name] : kAbbreviations)
+        if (abbrv == word)
+        {
+          len  = k - i + 1;
+          full = name;
+          return true;
+        }
+      return false;
+    }
+
+    // Abbreviation of names at the position i: \b([[:upper:]][[:lower:]]{0,2})[.;:]
+    bool match_name_abbreviation(const text_t& s, std::size_t i, std::size_t& len)
+    {
+      if (!word_boundary(s, i) || !(props(s[i]) & UPPER))
+        return false;
+
+      std::size_t k = i + 1;
+      while (k < s.size() && k < i + 3 && (props(s[k]) & LOWER))
+        ++k;
+      if (k == s.size() || std::u32string_view(U".;:").find(s[k]) == std::u32string_view::npos)
+        return false;
+      len = k - i;
+      return true;
+    }
+
+    text_t remove_abbreviations(const text_t& s)
+    {
+      text_t tmp;
+      tmp.reserve(s.size());
+      for (std::size_t i = 0; i < s.size();)
+      {
+        std::size_t      len;
+        std::string_view full;
+        if ((len = parenthesis_group(s, i)) > 0)
+        {
+          tmp.append(s, i, len);
+          i += len;
+        }
+        else if (match_place_abbreviation(s, i, len, full))
+        {
+          append(tmp, full);
+          tmp.push_back(s[i + len - 1] == '-' ? '-' : ' ');
+          i += len;
+        }
+        else
+          tmp.push_back(s[i++]);
+      }
+
+      text_t out;
+      out.reserve(tmp.size());
+      for (std::size_t i = 0; i < tmp.size();)
+      {
+        std::size_t len;
+        if ((len = parenthesis_group(tmp, i)) > 0)
+        {
+          out.append(tmp, i, len);
+          i += len;
+        }
+        else if (match_name_abbreviation(tmp, i, len))
+        {
+          out.append(tmp, i, len);
+          out.push_back(kBullet);
+          i += len + 1;
+        }
+        else
+          out.push_back(tmp[i++]);
+      }
+      return out;
+    }
+
+    // str.strip()
+    text_t strip(const text_t& s)
+    {
+      std::size_t b = 0, e = s.size();
+      while (b < e && is_space(s[b]))
+        ++b;
+      while (e > b && is_space(s[e - 1]))
+        --e;
+      return s.substr(b, e - b);
+    }
+
+    char32_t lower(char32_t c)
+    {
+      if (c < 0x80)
+        return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+      return find_char(c)->lower;
+    }
+
+
+    text_t normalize(text_t s, const options_t& opts)
+    {
+      if (opts.block)
+      {
+        text_t tmp;
+        tmp.reserve(s.size());
+        for (std::size_t i = 0; i < s.size(); ++i)
+        {
+          if (s[i] == '-' && i + 1 < s.size() && s[i + 1] == '\n')
+          {
+            tmp.push_back('-');
+            ++i;
+          }
+          else
+            tmp.push_back(s[i] == '\n' ? U' ' : s[i]);
+        }
+        s = std::move(tmp);
+      }
+
+      // Must be before lowering conversion (because case-dependant)
+      if (opts.remove_abbrv)
+        s = remove_abbreviations(s);
+
+      s = strip(s);
+      for (auto& c : s)
+      {
+        c = lower(c);
+        if (opts.strip_dashes && c == '-')
+          c = ' ';
+      }
+
+      // Collapse the spaces
+      text_t tmp;
+      tmp.reserve(s.size());
+      for (std::size_t i = 0; i < s.size();)
+      {
+        if (is_space(s[i]))
+        {
+          tmp.push_back(' ');
+          while (i < s.size() && is_space(s[i]))
+            ++i;
+        }
+        else
+          tmp.push_back(s[i++]);
+      }
+      s = std::move(tmp);
+
+      if (opts.force_ascii)
+      {
+        text_t tmp;
+        tmp.reserve(s.size());
+        for (char32_t c : s)
+        {
+          if (c < 0x80)
+            tmp.push_back(c);
+          else
+            for (const char* p = find_char(c)->ascii; *p; ++p)
+              tmp.push_back(static_cast<unsigned char>(*p));
+        }
+        s = std::move(tmp);
+      }
+      return s;
+    }
+
+    std::vector<std::string> split_fields(const text_t& s)
+    {
+      // Fields: ((?:[^(.,;:]|\([^)]*\))+)
+      auto separator = [](char32_t c) { return std::u32string_view(U"(.,;:").find(c) != std::u32string_view::npos; };
+      auto group     = [&](std::size_t i) -> std::size_t {
+        if (s[i] != '(')
+          return 0;
+        auto j = s.find(')', i + 1);
+        return (j == text_t::npos) ? 0 : j - i + 1;
+      };
+
+      std::vector<std::string> fields;
+      for (std::size_t i = 0; i < s.size();)
+      {
+        std::size_t start = i;
+        while (i < s.size())
+        {
+          if (!separator(s[i]))
+            ++i;
+          else if (std::size_t len = group(i))
+            i += len;
+          else
+            break;
+        }
+
+        if (i > start)
+          fields.push_back(encode(strip(s.substr(start, i - start))));
+        else
+          ++i; // Separator or unmatched parenthesis
+      }
+      return fields;
+    }
+
+    constexpr options_t kEntryOptions = {.force_ascii = true, .block = true, .remove_abbrv = true};
+  } // namespace
+
+
+  std::optional<std::string> normalize(std::string_view text, const options_t& opts)
+  {
+    auto s = decode(text);
+    if (!s)
+      return std::nullopt;
+    return encode(normalize(std::move(*s), opts));
+  }
+
+  std::optional<std::vector<std::string>> split_fields(std::string_view text)
+  {
+    auto s = decode(text);
+    if (!s)
+      return std::nullopt;
+    return split_fields(*s);
+  }
+
+  std::vector<std::optional<std::string>> normalize(std::span<const std::string> texts, const options_t& opts)
+  {
+    std::vector<std::optional<std::string>> out(texts.size());
+    ThreadPool::global().parallel_for(static_cast<int>(texts.size()),
+                                      [&](int i) { out[i] = normalize(std::string_view(texts[i]), opts); });
+    return out;
+  }
+
+  std::vector<std::optional<std::vector<std::string>>> split_entries(std::span<const std::string> texts)
+  {
+    std::vector<std::optional<std::vector<std::string>>> out(texts.size());
+    ThreadPool::global().parallel_for(static_cast<int>(texts.size()), [&](int i) {
+      if (auto s = decode(texts[i]))
+        out[i] = split_fields(normalize(std::move(*s), kEntryOptions));
+    });
+    return out;
+  }
+} // namespace TextNormalize
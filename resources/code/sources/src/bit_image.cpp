@@ -0,0 +1,113 @@
+#include "bit_image.hpp"
+
+#include <algorithm>
+
+
+namespace
+{
+  constexpr uint64_t kAllSet = ~uint64_t(0);
+
+  int words_per_row(int width)
+  {
+    return (width + 63) / 64;
+  }
+
+  // Mask of the bits of the word i that are in the column range [x0, x1)
+  uint64_t word_mask(int i, int x0, int x1)
+  {
+    uint64_t m = kAllSet;
+    if (i == (x0 >> 6))
+      m &= kAllSet << (x0 & 63);
+    if (i == ((x1 - 1) >> 6) && (x1 & 63))
+      m &= kAllSet >> (64 - (x1 & 63));
+    return m;
+  }
+} // namespace
+
+
+BitImage::BitImage(mln::box2d domain)
+  : m_domain{domain}
+  , m_stride{words_per_row(domain.width())}
+{
+  m_data.assign(m_stride * domain.height(), 0);
+}
+
+BitImage::BitImage(const mln::image2d<uint8_t>& input, int white_level)
+  : BitImage(input.domain())
+{
+  const int      width   = input.width();
+  const uint8_t* lineptr = input.buffer();
+
+  for (int y = 0; y < input.height(); ++y)
+  {
+    uint64_t* words = this->row(y);
+    for (int i = 0; i < m_stride; ++i)
+    {
+      const uint8_t* p = lineptr + 64 * i;
+      const int      n = std::min(64, width - 64 * i);
+      uint64_t       w = 0;
+      for (int b = 0; b < n; ++b)
+        w |= uint64_t(p[b] < white_level) << b;
+      words[i] = w;
+    }
+    lineptr += input.stride();
+  }
+}
+
+void BitImage::count_along_x(mln::box2d roi, int* out) const
+{
+  const int x0 = roi.x() - m_domain.x();
+  const int x1 = x0 + roi.width();
+  const int y0 = roi.y() - m_domain.y();
+
+  for (int y = 0; y < roi.height(); ++y)
+  {
+    const uint64_t* words = this->row(y0 + y);
+    int             count = 0;
+    if (x0 < x1)
+      for (int i = x0 >> 6; i <= (x1 - 1) >> 6; ++i)
+        count += std::popcount(words[i] & word_mask(i, x0, x1));
+    out[y] = count;
+  }
+}
+
+// The counts are accumulated in bit-sliced counters: the bit plane p holds the bit p of the count of every column,
+// so adding a row costs a few word operations for 64 columns (ripple-carry addition).
+void BitImage::count_along_y(mln::box2d roi, int* out) const
+{
+  const int x0 = roi.x() - m_domain.x();
+  const int x1 = x0 + roi.width();
+  const int y0 = roi.y() - m_domain.y();
+
+  if (x0 >= x1)
+    return;
+
+  const int i0      = x0 >> 6;
+  const int n       = ((x1 - 1) >> 6) - i0 + 1;
+  const int nplanes = std::bit_width(static_cast<unsigned>(roi.height()));
+
+  std::vector<uint64_t> planes(nplanes * n, 0);
+  for (int y = 0; y < roi.height(); ++y)
+  {
+    const uint64_t* words = this->row(y0 + y) + i0;
+    for (int i = 0; i < n; ++i)
+    {
+      uint64_t carry = words[i];
+      for (int p = 0; carry; ++p)
+      {
+        uint64_t t = planes[p * n + i] & carry;
+        planes[p * n + i] ^= carry;
+        carry = t;
+      }
+    }
+  }
+
+  for (int x = x0; x < x1; ++x)
+  {
+    const int i     = (x >> 6) - i0;
+    int       count = 0;
+    for (int p = 0; p < nplanes; ++p)
+      count |= static_cast<int>((planes[p * n + i] >> (x & 63)) & 1) << p;
+    out[x - x0] = count;
+  }
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <mln/core/image/ndimage.hpp>
+
+
+/// Binary image packed 64 pixels per word
+///
+/// The pixel at column x (relative to the domain) of a row is the bit x % 64 of the word x / 64. The bits past the
+/// width in the last word of a row are always 0. It is built once per threshold and then answers the black pixel
+/// tests/counts with 8x less memory traffic than the graylevel image.
+///
+/// There is no morphology on packed images: the openings and closings of the pipeline feed graylevel stages (the
+/// blur of the line segmentation, the rank filter of the blocks), so they run on the graylevel images.
+class BitImage
+{
+public:
+  BitImage() = default;
+
+  /// Create an image where all the pixels are unset
+  explicit BitImage(mln::box2d domain);
+
+  /// Threshold: a pixel is set iff input(p) < white_level (i.e. is black)
+  BitImage(const mln::image2d<uint8_t>& input, int white_level);
+
+  mln::box2d     domain() const { return m_domain; }
+  int            width() const { return m_domain.width(); }
+  int            height() const { return m_domain.height(); }
+  std::ptrdiff_t stride() const { return m_stride; } ///< Number of words per row
+
+  /// Pointer to the words of the row \p y (relative to the domain)
+  uint64_t*       row(int y) { return m_data.data() + y * m_stride; }
+  const uint64_t* row(int y) const { return m_data.data() + y * m_stride; }
+
+  bool operator()(mln::point2d p) const
+  {
+    int x = p.x() - m_domain.x();
+    return (row(p.y() - m_domain.y())[x >> 6] >> (x & 63)) & 1;
+  }
+
+  /// Number of set pixels of each row (along x) or of each column (along y) of \p roi
+  /// \p roi must be included in the domain
+  /// \{
+  void count_along_x(mln::box2d roi, int* out) const;
+  void count_along_y(mln::box2d roi, int* out) const;
+  /// \}
+
+  /// Call f(p) for every set pixel p of \p roi (in row-major order)
+  template <class F>
+  void for_each_set(mln::box2d roi, F f) const;
+
+private:
+  mln::box2d            m_domain;
+  std::ptrdiff_t        m_stride = 0;
+  std::vector<uint64_t> m_data;
+};
+
+
+/******************************************/
+/****          Implementation          ****/
+/******************************************/
+
+template <class F>
+void BitImage::for_each_set(mln::box2d roi, F f) const
+{
+  const int x0 = roi.x() - m_domain.x();
+  const int x1 = x0 + roi.width();
+  const int y0 = roi.y() - m_domain.y();
+
+  if (roi.width() <= 0)
+    return;
+
+  for (int y = y0; y < y0 + roi.height(); ++y)
+  {
+    const uint64_t* words = row(y);
+    for (int i = x0 >> 6; i <= (x1 - 1) >> 6; ++i)
+    {
+      uint64_t w = words[i];
+      if (i == (x0 >> 6))
+        w &= ~uint64_t(0) << (x0 & 63);
+      if (i == ((x1 - 1) >> 6) && (x1 & 63))
+        w &= ~uint64_t(0) >> (64 - (x1 & 63));
+
+      for (; w; w &= w - 1)
+        f(mln::point2d{m_domain.x() + 64 * i + std::countr_zero(w), m_domain.y() + y});
+    }
+  }
+}
@@ -9,19 +9,86 @@
 #include "InternalTypes.hpp"
 #include "display.hpp"
 #include "config.hpp"
-
-#include "DOMExport.hpp"
+#include "file_io.hpp"
+#include "load_pages.hpp"
+
+#include <AnnotationStore.hpp>
+#include <DOMExport.hpp>
+#include <DOMBinary.hpp>
+#include <PDFInfo.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <mutex>
+#include <numeric>
+#include <sstream>
+#include <thread>
 
 #include <mln/io/imsave.hpp>
 
+
+namespace
+{
+  // Pages of a list of ranges ("1-500", "3,7-9"), sorted and without duplicates
+  std::vector<int> parse_pages(const std::string& spec)
+  {
+    std::vector<int>  pages;
+    std::stringstream ss(spec);
+    std::string       item;
+    while (std::getline(ss, item, ','))
+    {
+      std::istringstream is(item);
+      int                first, last;
+      char               dash;
+      if (!(is >> first))
+        throw CLI::ValidationError("--pages", "Invalid range of pages '" + item + "'");
+      last = first;
+      if (is >> dash && (dash != '-' || !(is >> last)))
+        throw CLI::ValidationError("--pages", "Invalid range of pages '" + item + "'");
+      if (!(is >> std::ws).eof() || first < 1 || last < first)
+        throw CLI::ValidationError("--pages", "Invalid range of pages '" + item + "'");
+      for (int p = first; p <= last; ++p)
+        pages.push_back(p);
+    }
+    std::sort(pages.begin(), pages.end());
+    pages.erase(std::unique(pages.begin(), pages.end()), pages.end());
+    return pages;
+  }
+
+  // Path of the output of a page: "{page}" is replaced by the number of the page on 4 digits (the directories are
+  // created)
+  std::string output_path(std::string path, int page)
+  {
+    char number[16];
+    std::snprintf(number, sizeof(number), "%04d", page);
+    for (auto pos = path.find("{page}"); pos != std::string::npos; pos = path.find("{page}", pos))
+      path.replace(pos, 6, number);
+
+    auto dir = std::filesystem::path(path).parent_path();
+    if (!dir.empty())
+      std::filesystem::create_directories(dir);
+    return path;
+  }
+} // namespace
+
+
 int main(int argc, char** argv)
 {
   std::string       pdf_path;
   std::string       out_path;
   std::string       json_path;
-  int               page_number;
+  std::string       sdom_path;
+  std::string       annot_path;
+  std::vector<int>  pages;
+  int               page_number  = 0;
+  std::string       page_ranges;
+  bool              all_pages    = false;
+  int               jobs         = 1;
+  bool              overwrite    = false;
   int               debug        = 0;
   bool              deskew_only  = false;
+  LineSegmentation  lines        = LineSegmentation::WATERSHED;
   e_force_indent    force_indent = FORCE_NONE;
   display_options_t opts;
 
@@ -29,12 +96,29 @@ int main(int argc, char** argv)
     CLI::App app{"App description"};
     app.add_option("pdf", pdf_path, "Path to the input (PDF)")->required()->check(CLI::ExistingFile);
 
-    app.add_option("output", out_path, "Path to the debug output image (JPG).")->required();
+    app.add_option("output", out_path,
+                   "Path to the debug output image (JPG). The image is only rendered if this path is given.");
 
     app.add_option("-o", json_path, "Path to the output json file.");
-    app.add_flag("--deskew-only", deskew_only, "Only perform the deskew");
-
-    app.add_option("-p,--page", page_number, "Page to demat.")->required();
+    app.add_option("--sdom", sdom_path, "Path to the binary DOM file (.sdom) where the pages are added.");
+    app.add_option("--annot", annot_path, "Path to the annotation store (.annot) where the pages are added.");
+    app.add_flag("--overwrite", overwrite, "Replace the pages that are already in the annotation store.");
+    app.add_flag("--deskew-only", deskew_only, "Only perform the deskew (the deskewed image is saved as output)");
+    app.add_option("--entry-model", kEntryModelPath, "Path to the model of the entry detector (default: builtin).")
+        ->check(CLI::ExistingFile);
+    app.add_flag("--native-line-morphology", kNativeLineMorphology,
+                 "Use the in-project line morphology in the layout analysis instead of Pylene's.");
+    app.add_flag("--native-watershed", kNativeWatershed,
+                 "Use the watershed specialized for 8-bit images in the line detection instead of the generic one.");
+
+    auto* selection = app.add_option_group("pages", "Pages to demat (with several pages, the output paths must contain "
+                                                    "{page}, replaced by the page number, e.g. out/{page}.json).");
+    selection->add_option("-p,--page", page_number, "Page to demat.");
+    selection->add_option("--pages", page_ranges, "Ranges of pages to demat (e.g. 1-500 or 3,7-9).");
+    selection->add_flag("--all", all_pages, "Demat all the pages.");
+    selection->require_option(1);
+
+    app.add_option("-j,--jobs", jobs, "Number of pages processed at the same time.")->check(CLI::PositiveNumber);
 
     app.add_flag("-d,--debug", debug, "Export tmp images.");
 
@@ -57,7 +141,41 @@ int main(int argc, char** argv)
     app.add_option("--color-lines", opts.show_lines, "Colorize lines.")
         ->transform(CLI::CheckedTransformer(map, CLI::ignore_case));
 
+    std::vector<std::pair<std::string, LineSegmentation>> lines_map{{"watershed", LineSegmentation::WATERSHED},
+                                                                    {"projection", LineSegmentation::PROJECTION},
+                                                                    {"auto", LineSegmentation::AUTO}};
+    app.add_option("--lines", lines, "Line segmentation engine (watershed, projection or auto).")
+        ->transform(CLI::CheckedTransformer(lines_map, CLI::ignore_case));
+
     CLI11_PARSE(app, argc, argv);
+
+    try
+    {
+      if (all_pages)
+      {
+        pages.resize(PDFInfo(pdf_path).get_num_pages());
+        std::iota(pages.begin(), pages.end(), 1);
+      }
+      else if (!page_ranges.empty())
+        pages = parse_pages(page_ranges);
+      else
+        pages = {page_number};
+      if (pages.empty())
+        throw CLI::ValidationError("pages", "No page to demat");
+
+      if (deskew_only && out_path.empty())
+        throw CLI::RequiredError("output (required by --deskew-only)");
+      // The debug images have fixed names (see kDebugLevel): the pages processed at the same time would overwrite them
+      if (debug && jobs > 1)
+        throw CLI::ValidationError("--debug", "The debug images cannot be exported with several jobs (use -j 1)");
+      for (const auto* path : {&out_path, &json_path})
+        if (pages.size() > 1 && !path->empty() && path->find("{page}") == std::string::npos)
+          throw CLI::ValidationError(*path, "The output of several pages must contain {page}");
+    }
+    catch (const CLI::Error& e)
+    {
+      return app.exit(e);
+    }
   }
 
   if (debug)
@@ -70,25 +188,87 @@ int main(int argc, char** argv)
   }
 
 
-
-  Application app(pdf_path, page_number, nullptr, deskew_only);
-
-
-  if (deskew_only)
+  // Outputs shared by the pages
+  std::unique_ptr<AnnotationStore::Store> store;
+  if (!annot_path.empty())
+    store = std::make_unique<AnnotationStore::Store>(annot_path);
+
+  // Binary export (the new pages are merged in the file at the end)
+  DOMBinary::Writer sdom;
+  std::mutex        sdom_mutex;
+
+
+  auto process = [&](int page) {
+    Application app(pdf_path, page, nullptr, deskew_only, lines);
+
+    if (deskew_only)
+    {
+      ApplicationData* data = app.GetApplicationData();
+      mln::io::imsave(data->deskewed.image, output_path(out_path, page));
+      return;
+    }
+
+    // Export Json
+    if (!json_path.empty())
+      DOMExport(app.GetFlatDocument(), output_path(json_path, page));
+
+    if (store && !store->put(page, DOMExportToString(app.GetFlatDocument()), overwrite))
+      spdlog::info("Page {} is already in the annotation store (use --overwrite to replace it).", page);
+
+    if (!sdom_path.empty())
+    {
+      std::lock_guard lock(sdom_mutex);
+      sdom.add_page(page, app.GetFlatDocument());
+    }
+
+    if (!out_path.empty())
+    {
+      auto out = display(app.GetDocument(), app.GetApplicationData(), opts);
+      mln::io::imsave(out, output_path(out_path, page));
+    }
+  };
+
+  // The pages are processed by the workers in one process: the pdf is parsed once per worker (a failed page does not
+  // stop the others)
+  std::atomic<int> next   = 0;
+  std::atomic<int> done   = 0;
+  std::atomic<int> failed = 0;
+  auto             worker = [&]() {
+    DocumentCacheScope pdf_cache;
+    for (int i; (i = next++) < static_cast<int>(pages.size());)
+    {
+      try
+      {
+        process(pages[i]);
+        spdlog::info("Page {} done ({}/{}).", pages[i], ++done, pages.size());
+      }
+      catch (const std::exception& e)
+      {
+        spdlog::error("Page {} failed: {}", pages[i], e.what());
+        ++failed;
+      }
+    }
+  };
+
+  std::vector<std::thread> workers;
+  for (int k = 1; k < std::min<int>(jobs, pages.size()); ++k)
+    workers.emplace_back(worker);
+  worker();
+  for (auto& t : workers)
+    t.join();
+
+  // The file is read under the lock just before the write: the pages saved by others during the run are kept
+  if (!sdom_path.empty() && !deskew_only)
   {
-    ApplicationData* data = app.GetApplicationData();
-    mln::io::imsave(data->deskewed.image, out_path);
-    std::exit(0);
+    FileLock lock(sdom_path);
+    if (std::filesystem::exists(sdom_path))
+      sdom.merge(DOMBinary::Reader(sdom_path));
+    sdom.save(sdom_path);
   }
 
-
-  // Export Json
-  if (!json_path.empty())
-    DOMExport(app.GetDocument(), json_path);
-
-
-  auto out = display(app.GetDocument(), app.GetApplicationData(), opts);
-  mln::io::imsave(out, out_path);
+  if (failed)
+    spdlog::error("{} page(s) out of {} failed.", failed.load(), pages.size());
+  return failed ? 1 : 0;
 
 
   /*
@@ -3,6 +3,10 @@
 
 
 int kDebugLevel = 0;
+int kNumThreads = 0;
+std::string kEntryModelPath;
+bool kNativeLineMorphology = false;
+bool kNativeWatershed = false;
 float kLineHorizontalSigma = 10;
 float kLineVerticalSigma = 3;
 
@@ -1,7 +1,23 @@
 #pragma once
 
+#include <string>
+
 extern int kDebugLevel;
 
+// Number of worker threads of the parallel stages (0 = number of hardware threads)
+extern int kNumThreads;
+
+// Path to the model of the entry detector (empty = model embedded in the library)
+extern std::string kEntryModelPath;
+
+// Use the in-project line morphology in the layout analysis instead of mln::morpho::opening/closing (see
+// check-line-morphology)
+extern bool kNativeLineMorphology;
+
+// Use the watershed specialized for 8-bit images in the line detection instead of the generic one (see
+// check-watershed)
+extern bool kNativeWatershed;
+
 
 /// Constants for text blocks in mm
 /// \{
@@ -1,6 +1,8 @@
 #include "display.hpp"
 
 #include "InternalTypes.hpp"
+#include "bit_image.hpp"
+#include "config.hpp"
 
 #include "region_lut.hpp"
 #include <array>
@@ -8,7 +10,6 @@
 #include <mln/core/algorithm/for_each.hpp>
 #include <mln/core/algorithm/transform.hpp>
 #include <mln/core/image/view/zip.hpp>
-#include <mln/core/range/view/zip.hpp>
 #include <random>
 #include <spdlog/spdlog.h>
 
@@ -20,7 +21,7 @@ namespace
     uint8_t b,g,r,a;
   };
 
-  void labelize_line(const mln::image2d<uint8_t>* input_,  //
+  void labelize_line(const BitImage*              text,    //
                      const mln::image2d<int16_t>* ws_,     //
                      mln::image2d<bgra_t>*        output_, //
                      const DOM::line* e, int entry_number, //
@@ -29,10 +30,6 @@ namespace
   {
     mln::box2d region(e->bbox.x, e->bbox.y, e->bbox.width, e->bbox.height);
 
-    auto in = input_->clip(region);
-    auto out  = output_->clip(region);
-    auto lbls = ws_->clip(region);
-
     mln::rgb8 c     = {0, 0, 0};
     int label = e->label;
     if (opts.show_lines == display_options_t::LINE_ENTRY)
@@ -46,47 +43,46 @@ namespace
 
     bgra_t c2 = {c[2], c[1], c[0], 255};
 
-    auto vals = mln::ranges::view::zip(in.values(), out.values(), lbls.values());
-    for (auto&& r : mln::ranges::rows(vals))
-      for (auto && [vin, vout, vlbl] : r)
-      {
-        if (vlbl == label && vin < 150)
-          vout = c2;
-      }
+    // Only the text pixels of the line are visited
+    text->for_each_set(region, [&](mln::point2d p) {
+      if ((*ws_)(p) == label)
+        (*output_)(p) = c2;
+    });
   }
 
-  struct document_drawer : public DOMConstElementVisitor
+  // The context is the index (from 1) of the current entry in its column
+  struct document_drawer : public DOMStaticVisitor<document_drawer, const DOMElement, int>
   {
 
     display_options_t                          opts;
-    const mln::image2d<uint8_t>* input;
+    const BitImage*              text; // Text pixels of the input
     mln::image2d<bgra_t>*        output;
     const mln::image2d<int16_t>* ws;
     BLContext*                                 ctx;
 
-    void visit(const DOM::page* e, void* extra) final
+    void visit(const DOM::page* e, int k)
     {
       ctx->setStrokeStyle(BLRgba32(0u, 255u, 0u, 80u));
       ctx->setStrokeWidth(5);
       ctx->strokeBox(e->bbox.x, e->bbox.y, e->bbox.x1(), e->bbox.y1());
-      this->recurse(e, extra);
+      this->recurse(e, k);
     }
 
-    void visit(const DOM::title_level_1* e, void*) final
+    void visit(const DOM::title_level_1* e, int)
     {
       ctx->setStrokeStyle(BLRgba32(255u, 0u, 0u, 255));
       ctx->setStrokeWidth(3);
       ctx->strokeBox(e->bbox.x, e->bbox.y, e->bbox.x1(), e->bbox.y1());
     }
 
-    void visit(const DOM::title_level_2* e, void*) final
+    void visit(const DOM::title_level_2* e, int)
     {
       ctx->setStrokeStyle(BLRgba32(255u, 0u, 0u, 255));
       ctx->setStrokeWidth(3);
       ctx->strokeBox(e->bbox.x, e->bbox.y, e->bbox.x1(), e->bbox.y1());
     }
 
-    void visit(const DOM::section_level_1* e, void* extra) final
+    void visit(const DOM::section_level_1* e, int k)
     {
       ctx->setStrokeStyle(BLRgba32(0u, 0u, 255u, 255));
       ctx->setStrokeWidth(2);
@@ -95,25 +91,20 @@ namespace
 
       // ctx->setFillStyle(BLRgba32(255u, 0u, 0u, 25u));
       // ctx->fillBox(e->bbox.x, e->bbox.y, e->bbox.x1(), e->bbox.y1());
-      this->recurse(e, extra);
+      this->recurse(e, k);
     }
 
-    void visit(const DOM::section_level_2* e, void* extra) final
+    void visit(const DOM::section_level_2* e, int k)
     {
       ctx->setFillStyle(BLRgba32(255u, 0u, 0u, 25u));
       ctx->fillBox(e->bbox.x, e->bbox.y, e->bbox.x1(), e->bbox.y1());
       // ctx->setFillStyle(BLRgba32(0u, 255u, 0u, 25u));
       // ctx->fillBox(e->bbox.x, e->bbox.y, e->bbox.x1(), e->bbox.y1());
-      this->recurse(e, extra);
-    }
-
-    void visit(const DOM::column_level_1* e, void* extra) final
-    {
-      this->recurse(e, extra);
+      this->recurse(e, k);
     }
 
 
-    void visit(const DOM::line* e, void* extra) final
+    void visit(const DOM::line* e, int k)
     {
       if (opts.show_lines)
       {
@@ -121,39 +112,34 @@ namespace
         // ctx->setStrokeStyle(BLRgba32(c[0], c[1], c[2]));
         // ctx->setStrokeWidth(1);
         // ctx->strokeBox(e->bbox.x, e->bbox.y, e->bbox.x1(), e->bbox.y1());
-        intptr_t k = (intptr_t)extra;
-        labelize_line(input, ws, output, e, k, opts);
+        labelize_line(text, ws, output, e, k, opts);
       }
-      this->recurse(e, extra);
+      this->recurse(e, k);
     }
 
-    void visit(const DOM::entry* e, void* extra) final
+    void visit(const DOM::entry* e, int k)
     {
       /*
       if (!opts.hide_entries)
       {
-        intptr_t k = (intptr_t)extra;
         auto c = region_lut(k);
         ctx->setStrokeStyle(BLRgba32(c[0], c[1], c[2]));
         ctx->setStrokeWidth(1);
         ctx->strokeBox(e->bbox.x, e->bbox.y, e->bbox.x1(), e->bbox.y1());
       }
       */
-      this->recurse(e, extra);
+      this->recurse(e, k);
     }
 
 
-    void visit(const DOM::column_level_2* e, void*) final
+    void visit(const DOM::column_level_2* e, int)
     {
       ctx->setStrokeStyle(BLRgba32(0u, 0u, 255u, 100));
       ctx->setStrokeWidth(2);
       ctx->strokeBox(e->bbox.x, e->bbox.y, e->bbox.x1(), e->bbox.y1());
-      intptr_t k = 1;
+      int k = 1;
       for (auto& c : e->children)
-      {
-        c->accept(*this, (void*)k);
-        k++;
-      }
+        this->dispatch(c.get(), k++);
     }
   };
 
@@ -213,13 +199,15 @@ display(DOMElement* document, ApplicationData* data, const display_options_t& op
   // Draw the page
   if (opts.show_layout || opts.show_lines)
   {
+    BitImage text(input, kLayoutWhiteLevel);
+
     document_drawer drawer;
     drawer.opts   = opts;
-    drawer.input  = &input;
+    drawer.text   = &text;
     drawer.output = &out;
     drawer.ws     = &lbls;
     drawer.ctx    = &ctx;
-    document->accept(drawer, nullptr);
+    drawer.traverse(document, 0);
   }
 
   // Draw segments
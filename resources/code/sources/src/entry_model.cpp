@@ -0,0 +1,265 @@
+#include "entry_model.hpp"
+
+#include "config.hpp"
+
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+
+
+// Text format of a model (whitespace-separated tokens, '#' starts a comment):
+//
+//   entry-model
+//   ensemble <number of trees>       # classifier[0]
+//   tree <number of nodes>
+//   split <feature> <threshold> <left> <right>
+//   leaf <value>
+//   ...
+//   ensemble <number of trees>       # classifier[1]
+//   ...
+//
+// The nodes of a tree are numbered from 0 (the root) in the order of the file and a split sends a sample to <left> if
+// x[feature] <= threshold (same convention as scikit-learn).
+//
+// This is the model that was hard-coded in DOMEntriesExtractor.cpp (one tree per classifier).
+static const char* kBuiltinEntryModel = R"(
+entry-model
+
+# p(entry start | previous line is not an entry start)
+ensemble 1
+tree 15
+split 2 0.050192078575491905 1 2
+split 1 7.0 3 4
+split 0 15.0 5 6
+split 0 5.0 7 8
+split 2 0.023809523321688175 9 10
+leaf 0.9956150117952923
+split 1 6.0 11 12
+leaf 0.2806137080585029
+leaf 0.009406046080173251
+leaf 0.5186166688750498
+leaf 0.8073099294583558
+leaf 0.287751801205705
+split 1 17.0 13 14
+leaf 0.8895712641566001
+leaf 0.5709700948212982
+
+# p(entry start | previous line is an entry start)
+ensemble 1
+tree 15
+split 1 5.0 1 2
+split 2 0.015286649111658335 3 4
+split 2 0.05557460896670818 5 6
+split 0 1.0 7 8
+split 0 15.0 9 10
+leaf 0.00886907320584195
+leaf 0.8568592722907037
+split 2 0.0012019231216982007 11 12
+leaf 0.7509394870522096
+leaf 0.9902016678266132
+split 2 0.05302507430315018 13 14
+leaf 0.23448713324461126
+leaf 0.5701066700938181
+leaf 0.3559050064184852
+leaf 0.9729120552826217
+)";
+
+
+namespace
+{
+  [[noreturn]] void parse_error(const std::string& msg)
+  {
+    spdlog::error("Invalid entry model: {}", msg);
+    throw std::runtime_error("Invalid entry model (see logs)");
+  }
+
+  void expect(std::istream& in, const char* keyword)
+  {
+    std::string token;
+    if (!(in >> token) || token != keyword)
+      parse_error(fmt::format("expected '{}' (got '{}')", keyword, token));
+  }
+
+  int read_count(std::istream& in, const char* what)
+  {
+    int n;
+    if (!(in >> n) || n <= 0)
+      parse_error(fmt::format("invalid number of {}", what));
+    return n;
+  }
+
+  // Remove the comments
+  std::stringstream strip_comments(std::istream& in)
+  {
+    std::stringstream out;
+    std::string       line;
+    while (std::getline(in, line))
+      out << line.substr(0, line.find('#')) << '\n';
+    return out;
+  }
+
+  // The features are float and the thresholds are given in double precision: round down the threshold so that
+  // x <= threshold gives the same answer in single precision.
+  float round_threshold(double t)
+  {
+    float f = static_cast<float>(t);
+    if (f > t)
+      f = std::nextafter(f, -INFINITY);
+    return f;
+  }
+
+  EntryModel read_model(std::istream& input)
+  {
+    auto in = strip_comments(input);
+
+    EntryModel model;
+    expect(in, "entry-model");
+    for (auto& clf : model.classifier)
+      clf = TreeEnsemble::read(in, EntryModel::kNumFeatures);
+
+    std::string token;
+    if (in >> token)
+      parse_error(fmt::format("unexpected token '{}'", token));
+    return model;
+  }
+} // namespace
+
+
+TreeEnsemble TreeEnsemble::read(std::istream& in, int num_features)
+{
+  struct file_node_t
+  {
+    int    feature = -1;
+    double value;
+    int    left, right;
+  };
+
+  TreeEnsemble e;
+  e.m_num_features = num_features;
+
+  expect(in, "ensemble");
+  int ntrees = read_count(in, "trees");
+
+  std::vector<file_node_t> tree;
+  std::vector<int>         order;
+  for (int t = 0; t < ntrees; ++t)
+  {
+    expect(in, "tree");
+    int nnodes = read_count(in, "nodes");
+
+    tree.assign(nnodes, {});
+    for (auto& node : tree)
+    {
+      std::string kind;
+      in >> kind;
+      if (kind == "split")
+      {
+        if (!(in >> node.feature >> node.value >> node.left >> node.right))
+          parse_error("invalid split");
+        if (node.feature < 0 || node.feature >= num_features)
+          parse_error(fmt::format("invalid feature {}", node.feature));
+        if (node.left <= 0 || node.left >= nnodes || node.right <= 0 || node.right >= nnodes)
+          parse_error("child index out of range");
+      }
+      else if (kind == "leaf")
+      {
+        if (!(in >> node.value))
+          parse_error("invalid leaf");
+      }
+      else
+      {
+        parse_error(fmt::format("expected 'split' or 'leaf' (got '{}')", kind));
+      }
+    }
+
+    // Breadth-first relayout: the children of a split are appended together. The number of visited nodes is bounded
+    // so that a node with several parents (or a cycle) is detected.
+    const int base = static_cast<int>(e.m_nodes.size());
+    order.assign(1, 0);
+    for (std::size_t k = 0; k < order.size(); ++k)
+    {
+      const auto& node = tree[order[k]];
+      if (node.feature < 0)
+      {
+        e.m_nodes.push_back({-1, static_cast<float>(node.value), -1});
+        continue;
+      }
+
+      e.m_nodes.push_back({node.feature, round_threshold(node.value), base + static_cast<int>(order.size())});
+      order.push_back(node.left);
+      order.push_back(node.right);
+      if (static_cast<int>(order.size()) > nnodes)
+        parse_error("the nodes do not form a tree");
+    }
+    e.m_roots.push_back(base);
+  }
+  return e;
+}
+
+
+void TreeEnsemble::predict(const float* features, int n, float* out) const
+{
+  std::fill(out, out + n, 0.f);
+
+  // One tree at a time over all the samples: the tree stays in cache
+  for (int root : m_roots)
+  {
+    const float* x = features;
+    for (int i = 0; i < n; ++i, x += m_num_features)
+    {
+      int k = root;
+      while (m_nodes[k].feature >= 0)
+        k = m_nodes[k].left + (x[m_nodes[k].feature] > m_nodes[k].value);
+      out[i] += m_nodes[k].value;
+    }
+  }
+
+  if (m_roots.size() > 1)
+  {
+    const float scale = 1.f / m_roots.size();
+    for (int i = 0; i < n; ++i)
+      out[i] *= scale;
+  }
+}
+
+
+EntryModel EntryModel::load(const std::string& path)
+{
+  std::ifstream f(path);
+  if (!f)
+  {
+    spdlog::error("Unable to open the entry model '{}'", path);
+    throw std::runtime_error("Invalid entry model (see logs)");
+  }
+  spdlog::info("Loading the entry model '{}'", path);
+  return read_model(f);
+}
+
+const EntryModel& EntryModel::builtin()
+{
+  static const EntryModel model = [] {
+    std::istringstream in(kBuiltinEntryModel);
+    return read_model(in);
+  }();
+  return model;
+}
+
+const EntryModel& EntryModel::current()
+{
+  if (kEntryModelPath.empty())
+    return builtin();
+
+  static std::mutex                        mutex;
+  static std::map<std::string, EntryModel> models;
+
+  std::lock_guard lock(mutex);
+  auto            it = models.find(kEntryModelPath);
+  if (it == models.end())
+    it = models.emplace(kEntryModelPath, load(kEntryModelPath)).first;
+  return it->second;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <istream>
+#include <string>
+#include <vector>
+
+
+/// Ensemble of decision trees (the output is the mean of the outputs of the trees)
+///
+/// The nodes of all the trees are stored in a single array in breadth-first order where the two children of a node are
+/// adjacent, so that a node is 12 bytes and a descent only reads forward in memory.
+class TreeEnsemble
+{
+public:
+  /// Number of features of a sample
+  int num_features() const { return m_num_features; }
+
+  /// Number of trees
+  int size() const { return static_cast<int>(m_roots.size()); }
+
+  /// Evaluate the ensemble on \p n samples
+  /// \param features Array of n * num_features() values (one row per sample)
+  /// \param out Array of n values
+  void predict(const float* features, int n, float* out) const;
+
+  /// Read an ensemble in the text format described in entry_model.cpp
+  /// \throw std::runtime_error if the input is invalid
+  static TreeEnsemble read(std::istream& in, int num_features);
+
+private:
+  struct node_t
+  {
+    int32_t feature; // Index of the feature tested by the node (-1 for a leaf)
+    float   value;   // Threshold (x[feature] <= value goes left) or output of the leaf
+    int32_t left;    // Index of the left child (the right child is left + 1)
+  };
+
+  int                  m_num_features = 0;
+  std::vector<node_t>  m_nodes;
+  std::vector<int32_t> m_roots;
+};
+
+
+/// Model of the entry detector
+///
+/// For every line i > 0 of a column, the features are (lspace_abs, grad, prspace) with:
+/// * lspace_abs: the left margin of the line
+/// * grad: |lspace_abs(i) - lspace_abs(i - 1)|
+/// * prspace: the right margin of the previous line divided by the width of the column
+///
+/// classifier[k] estimates the probability that the line starts an entry knowing that the previous line starts an
+/// entry (k = 1) or not (k = 0).
+struct EntryModel
+{
+  static constexpr int kNumFeatures = 3;
+
+  TreeEnsemble classifier[2];
+
+  /// Load a model from a file (see entry_model.cpp for the format)
+  /// \throw std::runtime_error if the file cannot be read or is invalid
+  static EntryModel load(const std::string& path);
+
+  /// Model embedded in the library
+  static const EntryModel& builtin();
+
+  /// Model at kEntryModelPath (or the builtin model if the path is empty). It is loaded once per path.
+  static const EntryModel& current();
+};
@@ -0,0 +1,84 @@
+#include "file_io.hpp"
+
+#include <spdlog/spdlog.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+FileLock::FileLock(const std::string& path)
+{
+  const std::string lock_path = path + ".lock";
+  m_fd                        = ::open(lock_path.c_str(), O_RDWR | O_CREAT, 0644);
+  if (m_fd < 0)
+  {
+    spdlog::error("Unable to open the lock file '{}': {}", lock_path, std::strerror(errno));
+    throw std::runtime_error("Unable to lock the file (see logs)");
+  }
+
+  int r;
+  while ((r = ::flock(m_fd, LOCK_EX)) != 0 && errno == EINTR)
+    ;
+  if (r != 0)
+  {
+    spdlog::error("Unable to lock '{}': {}", lock_path, std::strerror(errno));
+    ::close(m_fd);
+    throw std::runtime_error("Unable to lock the file (see logs)");
+  }
+}
+
+FileLock::~FileLock()
+{
+  ::close(m_fd); // Releases the lock
+}
+
+
+void replace_file(const std::string& path, std::string_view data)
+{
+  std::string tmp = path + ".XXXXXX";
+  int         fd  = ::mkstemp(tmp.data());
+  if (fd < 0)
+  {
+    spdlog::error("Unable to create a temporary file for '{}': {}", path, std::strerror(errno));
+    throw std::runtime_error("Unable to write the file (see logs)");
+  }
+
+  auto fail = [&](const char* what) {
+    spdlog::error("Unable to {} '{}': {}", what, tmp, std::strerror(errno));
+    if (fd >= 0)
+      ::close(fd);
+    ::unlink(tmp.c_str());
+    throw std::runtime_error("Unable to write the file (see logs)");
+  };
+
+  // mkstemp creates the file with the mode 0600
+  mode_t mask = ::umask(0);
+  ::umask(mask);
+  if (::fchmod(fd, 0666 & ~mask) != 0)
+    fail("set the permissions of");
+
+  for (std::size_t done = 0; done < data.size();)
+  {
+    ssize_t n = ::write(fd, data.data() + done, data.size() - done);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      fail("write");
+    done += n;
+  }
+  if (::fsync(fd) != 0)
+    fail("sync");
+  int r = ::close(fd);
+  fd    = -1;
+  if (r != 0)
+    fail("close");
+
+  if (std::rename(tmp.c_str(), path.c_str()) != 0)
+    fail("rename");
+}
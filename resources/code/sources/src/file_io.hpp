@@ -0,0 +1,31 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+
+/// Exclusive lock on the file `<path>.lock`, held for the lifetime of the object
+///
+/// It is the lock taken by the python savers (`filelock.FileLock(path + ".lock")` uses flock too), so the C++ and the
+/// python writers of a file exclude each other.
+class FileLock
+{
+public:
+  /// Wait for the lock
+  /// \throw std::runtime_error if the lock file cannot be opened
+  explicit FileLock(const std::string& path);
+  ~FileLock();
+
+  FileLock(const FileLock&) = delete;
+  FileLock& operator=(const FileLock&) = delete;
+
+private:
+  int m_fd = -1;
+};
+
+
+/// Replace the content of a file: the data is written in a temporary file with a unique name in the same directory,
+/// which is then renamed over \p path (the readers see either the old or the new file). The file gets the default
+/// permissions (0666 & ~umask).
+/// \throw std::runtime_error if the file cannot be written
+void replace_file(const std::string& path, std::string_view data);
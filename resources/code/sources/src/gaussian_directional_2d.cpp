@@ -1,7 +1,10 @@
 #include "gaussian_directional_2d.hpp"
 
+#include "thread_pool.hpp"
+
 #include <algorithm>
 #include <cmath>
+#include <vector>
 #include <mln/core/image/ndimage.hpp>
 
 namespace
@@ -131,147 +134,146 @@ namespace
   };
 
 
-  void gaussian1d(recursivefilter_coef_ c, float* input, std::ptrdiff_t size, float* tmp1, float* tmp2)
+  // 4th-order Deriche recursion on N interleaved signals (the sample i of the signal k is input[i * N + k]).
+  //
+  // The recursion is independent for each signal, so the inner loops over k are vectorized by the compiler. \p input,
+  // \p tmp1 and \p tmp2 must have 4 samples of zeros before and after [0, size) (the causal/anti-causal parts then
+  // need no special case for the first samples).
+  template <int N>
+  void gaussian1d(const recursivefilter_coef_& c, float* input, int size, float* tmp1, float* tmp2)
   {
-    tmp1[0] = c.n[0] * input[0];
-
-    tmp1[1] = 0                   //
-              + c.n[0] * input[1] //
-              + c.n[1] * input[0] //
-              - c.d[1] * tmp1[0];
-
-    tmp1[2] = 0                   //
-              + c.n[0] * input[2] //
-              + c.n[1] * input[1] //
-              + c.n[2] * input[0] //
-              - c.d[1] * tmp1[1]  //
-              - c.d[2] * tmp1[0];
-
-    tmp1[3] = 0                   //
-              + c.n[0] * input[3] //
-              + c.n[1] * input[2] //
-              + c.n[2] * input[1] //
-              + c.n[3] * input[0] //
-              - c.d[1] * tmp1[2]  //
-              - c.d[2] * tmp1[1]  //
-              - c.d[3] * tmp1[0];
-
-    for (int i = 4; i < size; i++)
+    const float n0 = c.n[0], n1 = c.n[1], n2 = c.n[2], n3 = c.n[3];
+    const float d1 = c.d[1], d2 = c.d[2], d3 = c.d[3], d4 = c.d[4];
+    const float nm1 = c.nm[1], nm2 = c.nm[2], nm3 = c.nm[3], nm4 = c.nm[4];
+    const float dm1 = c.dm[1], dm2 = c.dm[2], dm3 = c.dm[3], dm4 = c.dm[4];
+
+    // Causal part
+    for (int i = 0; i < size; ++i)
     {
-      tmp1[i] = c.n[0] * input[i + 0] + c.n[1] * input[i - 1] + //
-                c.n[2] * input[i - 2] + c.n[3] * input[i - 3] - //
-                c.d[1] * tmp1[i - 1] - c.d[2] * tmp1[i - 2] -   //
-                c.d[3] * tmp1[i - 3] - c.d[4] * tmp1[i - 4];    //
+      const float* x = input + i * N;
+      float*       y = tmp1 + i * N;
+      for (int k = 0; k < N; ++k)
+        y[k] = n0 * x[k] + n1 * x[k - N] +              //
+               n2 * x[k - 2 * N] + n3 * x[k - 3 * N] - //
+               d1 * y[k - N] - d2 * y[k - 2 * N] -     //
+               d3 * y[k - 3 * N] - d4 * y[k - 4 * N];  //
     }
 
     // Non causal part
-
-    tmp2[size - 1] = 0;
-
-    tmp2[size - 2] = c.nm[1] * input[size - 1]; //
-
-    tmp2[size - 3] = c.nm[1] * input[size - 2] + //
-                     c.nm[2] * input[size - 1] - //
-                     c.dm[1] * tmp2[size - 2];   //
-
-    tmp2[size - 4] = c.nm[1] * input[size - 3] + //
-                     c.nm[2] * input[size - 2] + //
-                     c.nm[3] * input[size - 1] - //
-                     c.dm[1] * tmp2[size - 3] -  //
-                     c.dm[2] * tmp2[size - 2];   //
-
-    for (int i = size - 5; i >= 0; --i)
+    for (int i = size - 1; i >= 0; --i)
     {
-      tmp2[i] = c.nm[1] * input[i + 1] +                        //
-                c.nm[2] * input[i + 2] +                        //
-                c.nm[3] * input[i + 3] +                        //
-                c.nm[4] * input[i + 4] -                        //
-                c.dm[1] * tmp2[i + 1] - c.dm[2] * tmp2[i + 2] - //
-                c.dm[3] * tmp2[i + 3] - c.dm[4] * tmp2[i + 4];  //
+      const float* x = input + i * N;
+      float*       y = tmp2 + i * N;
+      for (int k = 0; k < N; ++k)
+        y[k] = nm1 * x[k + N] +                       //
+               nm2 * x[k + 2 * N] +                   //
+               nm3 * x[k + 3 * N] +                   //
+               nm4 * x[k + 4 * N] -                   //
+               dm1 * y[k + N] - dm2 * y[k + 2 * N] -  //
+               dm3 * y[k + 3 * N] - dm4 * y[k + 4 * N]; //
     }
 
-    for (int i = 0; i < size; ++i)
+    for (int i = 0; i < size * N; ++i)
       input[i] = tmp1[i] + tmp2[i];
   }
 
 
-  template <class T>
-  void copy_from_column(const mln::image2d<T>& f, int c, float* buffer)
-  {
-    int h = f.height();
-    int y0 = f.domain().y();
-    for (int y = 0; y < h; ++y)
-      buffer[y] = f({c, y + y0});
-  }
-
-  template <class T>
-  void copy_to_column(const float* buffer, int c, mln::image2d<T>& f)
+  // Scratch buffers of gaussian1d<N> for signals of \p size samples (with their zero padding)
+  template <int N>
+  struct gaussian_buffers
   {
-    int h = f.height();
-    int y0 = f.domain().y();
-    for (int y = 0; y < h; ++y)
-      f({c, y + y0}) = buffer[y];
-  }
+    explicit gaussian_buffers(int size)
+      : m_size{size + 8}
+      , m_data(3 * m_size * N, 0.f)
+    {
+    }
 
+    float* input() { return m_data.data() + 4 * N; }
+    float* tmp1() { return m_data.data() + (m_size + 4) * N; }
+    float* tmp2() { return m_data.data() + (2 * m_size + 4) * N; }
 
-  template <class T>
-  void gaussian2d_T(mln::image2d<T>& input, float h_sigma, float v_sigma, T border_value)
-  {
+  private:
+    int                m_size;
+    std::vector<float> m_data;
+  };
 
 
+  constexpr int kColumnLanes = 16; // Number of columns filtered simultaneously by the vertical pass
+  constexpr int kRowLanes    = 8;  // Number of rows filtered simultaneously by the horizontal pass
 
 
+  template <class T>
+  void gaussian2d_T(mln::image2d<T>& input, float h_sigma, float v_sigma, T border_value)
+  {
     int b      = 5 * static_cast<int>(std::max(h_sigma, v_sigma) + 0.5f);
     int width  = input.width();
     int height = input.height();
 
-    int tmp_size = std::max(width, height) + 2 * b;
-
-    // Allocate temporary buffer
-    std::vector<float> tmp(3 * tmp_size);
-    float*             i_buffer = tmp.data();
-    float*             tmp1     = tmp.data() + tmp_size;
-    float*             tmp2     = tmp.data() + 2 * tmp_size;
+    T*             buffer = input.buffer();
+    std::ptrdiff_t stride = input.stride();
 
-    // Fill border
-    std::fill_n(i_buffer, tmp_size, border_value);
+    if (width == 0 || height == 0)
+      return;
 
-
-    const int x0 = input.domain().x();
+    // Vertical pass by strips of kColumnLanes columns (row-major accesses, one lane per column)
     if (v_sigma != 0.f)
     {
+      constexpr int         N = kColumnLanes;
       recursivefilter_coef_ coef(1.68f, 3.735f, 1.783f, 1.723f, -0.6803f, -0.2598f, 0.6318f, 1.997f, v_sigma,
                                  recursivefilter_coef_::DericheGaussian);
 
+      int size     = height + 2 * b;
+      int nstrips  = (width + N - 1) / N;
+      ThreadPool::global().parallel_for(nstrips, [&](int s) {
+        gaussian_buffers<N> buf(size);
+        float*              in = buf.input();
+        int                 x0 = s * N;
+        int                 n  = std::min(N, width - x0);
 
-      int size = height + 2 * b;
-      for (int x = 0; x < width; ++x)
-      {
-        copy_from_column(input, x + x0, i_buffer + b);
-        gaussian1d(coef, i_buffer, size, tmp1, tmp2);
-        copy_to_column(i_buffer + b, x + x0, input);
-      }
-    }
-
+        std::fill_n(in, size * N, static_cast<float>(border_value));
+        for (int y = 0; y < height; ++y)
+          std::copy_n(buffer + y * stride + x0, n, in + (b + y) * N);
 
-    // Fill border
-    std::fill_n(i_buffer, tmp_size, border_value);
+        gaussian1d<N>(coef, in, size, buf.tmp1(), buf.tmp2());
 
+        for (int y = 0; y < height; ++y)
+          for (int j = 0; j < n; ++j)
+            buffer[y * stride + x0 + j] = static_cast<T>(in[(b + y) * N + j]);
+      });
+    }
 
+    // Horizontal pass by groups of kRowLanes rows (interleaved in the buffer, one lane per row)
     if (h_sigma != 0.f)
     {
+      constexpr int         N = kRowLanes;
       recursivefilter_coef_ coef(1.68f, 3.735f, 1.783f, 1.723f, -0.6803f, -0.2598f, 0.6318f, 1.997f, h_sigma,
                                  recursivefilter_coef_::DericheGaussian);
 
-      int size = width + 2 * b;
-      uint8_t* lineptr = input.buffer();
-      for (int y = 0; y < height; ++y)
-      {
-        std::copy_n(lineptr, width, i_buffer + b);
-        gaussian1d(coef, i_buffer, size, tmp1, tmp2);
-        std::copy_n(i_buffer + b, width, lineptr);
-        lineptr += input.stride();
-      }
+      int size    = width + 2 * b;
+      int ngroups = (height + N - 1) / N;
+      ThreadPool::global().parallel_for(ngroups, [&](int g) {
+        gaussian_buffers<N> buf(size);
+        float*              in = buf.input();
+        int                 y0 = g * N;
+        int                 n  = std::min(N, height - y0);
+
+        std::fill_n(in, size * N, static_cast<float>(border_value));
+        for (int j = 0; j < n; ++j)
+        {
+          const T* lineptr = buffer + (y0 + j) * stride;
+          for (int x = 0; x < width; ++x)
+            in[(b + x) * N + j] = lineptr[x];
+        }
+
+        gaussian1d<N>(coef, in, size, buf.tmp1(), buf.tmp2());
+
+        for (int j = 0; j < n; ++j)
+        {
+          T* lineptr = buffer + (y0 + j) * stride;
+          for (int x = 0; x < width; ++x)
+            lineptr[x] = static_cast<T>(in[(b + x) * N + j]);
+        }
+      });
     }
   }
 } // namespace
@@ -0,0 +1,279 @@
+#include "line_morphology.hpp"
+
+#include <algorithm>
+#include <vector>
+#include <mln/core/image/ndimage.hpp>
+#include <mln/core/se/periodic_line2d.hpp>
+#include <mln/core/se/rect2d.hpp>
+#include <mln/morpho/closing.hpp>
+#include <mln/morpho/opening.hpp>
+
+#include "config.hpp"
+
+namespace
+{
+  // Number of columns processed at once by the vertical passes (keeps the g/h buffers in cache)
+  constexpr int kStripWidth = 256;
+
+  struct min_t
+  {
+    static constexpr uint8_t neutral = UINT8_MAX;
+    uint8_t operator()(uint8_t a, uint8_t b) const { return std::min(a, b); }
+  };
+
+  struct max_t
+  {
+    static constexpr uint8_t neutral = 0;
+    uint8_t operator()(uint8_t a, uint8_t b) const { return std::max(a, b); }
+  };
+
+  // Size of the padded buffer: n samples + k neutral values on both sides, rounded up to a multiple of the SE size
+  int padded_size(int n, int k)
+  {
+    int L = 2 * k + 1;
+    return ((n + 2 * k + L - 1) / L) * L;
+  }
+
+
+  // Van Herk/Gil-Werman running min/max over a window of size L = 2k+1 along a single row.
+  //
+  // The padded row is split in blocks of size L; g holds the prefix min/max of each block and h the suffix min/max.
+  // The window [i - k, i + k] spans at most two blocks, so out[i] = op(h[i], g[i + L - 1]) (padded indices).
+  // g and h must have padded_size(n, k) elements.
+  template <class Op>
+  void running_row(const uint8_t* __restrict in, uint8_t* __restrict out, int n, int k, uint8_t* __restrict g,
+                   uint8_t* __restrict h)
+  {
+    Op        op;
+    const int L = 2 * k + 1;
+    const int m = padded_size(n, k);
+
+    std::fill_n(h, k, Op::neutral);
+    std::copy_n(in, n, h + k);
+    std::fill(h + k + n, h + m, Op::neutral);
+
+    for (int b = 0; b < m; b += L)
+    {
+      g[b] = h[b];
+      for (int i = b + 1; i < b + L; ++i)
+        g[i] = op(g[i - 1], h[i]);
+      for (int i = b + L - 2; i >= b; --i)
+        h[i] = op(h[i + 1], h[i]);
+    }
+
+    for (int i = 0; i < n; ++i)
+      out[i] = op(h[i], g[i + L - 1]);
+  }
+
+
+  // out[j] = op(a[j], b[j]) for j in [0, w) (vectorized by the compiler, \p out may be \p b)
+  template <class Op>
+  void apply_n(const uint8_t* __restrict a, const uint8_t* b, uint8_t* out, int w)
+  {
+    Op op;
+    for (int j = 0; j < w; ++j)
+      out[j] = op(a[j], b[j]);
+  }
+
+
+  // Same as running_row but along the columns. A sample is a row segment of w contiguous pixels, so all the
+  // columns of the strip are processed simultaneously with row-major accesses.
+  // g and h must have padded_size(n, k) * w elements.
+  template <class Op>
+  void running_columns(const uint8_t* in, std::ptrdiff_t in_stride, uint8_t* out, std::ptrdiff_t out_stride, int n,
+                       int w, int k, uint8_t* g, uint8_t* h)
+  {
+    const int L = 2 * k + 1;
+    const int m = padded_size(n, k);
+
+    std::fill_n(h, k * w, Op::neutral);
+    for (int i = 0; i < n; ++i)
+      std::copy_n(in + i * in_stride, w, h + (k + i) * w);
+    std::fill(h + (k + n) * w, h + m * w, Op::neutral);
+
+    for (int b = 0; b < m; b += L)
+    {
+      std::copy_n(h + b * w, w, g + b * w);
+      for (int i = b + 1; i < b + L; ++i)
+        apply_n<Op>(g + (i - 1) * w, h + i * w, g + i * w, w);
+      for (int i = b + L - 2; i >= b; --i)
+        apply_n<Op>(h + (i + 1) * w, h + i * w, h + i * w, w);
+    }
+
+    for (int i = 0; i < n; ++i)
+      apply_n<Op>(h + i * w, g + (i + L - 1) * w, out + i * out_stride, w);
+  }
+
+
+  void copy_buffer(const uint8_t* in, std::ptrdiff_t in_stride, uint8_t* out, std::ptrdiff_t out_stride, int width,
+                   int height)
+  {
+    for (int y = 0; y < height; ++y)
+      std::copy_n(in + y * in_stride, width, out + y * out_stride);
+  }
+
+
+  template <class Op>
+  void hline_op(const uint8_t* in, std::ptrdiff_t in_stride, uint8_t* out, std::ptrdiff_t out_stride, int width,
+                int height, int k)
+  {
+    if (width <= 0 || height <= 0)
+      return;
+    if (k <= 0)
+      return copy_buffer(in, in_stride, out, out_stride, width, height);
+
+    std::vector<uint8_t> tmp(2 * padded_size(width, k));
+    uint8_t*             g = tmp.data();
+    uint8_t*             h = tmp.data() + tmp.size() / 2;
+
+    for (int y = 0; y < height; ++y)
+      running_row<Op>(in + y * in_stride, out + y * out_stride, width, k, g, h);
+  }
+
+  template <class Op>
+  void vline_op(const uint8_t* in, std::ptrdiff_t in_stride, uint8_t* out, std::ptrdiff_t out_stride, int width,
+                int height, int k)
+  {
+    if (width <= 0 || height <= 0)
+      return;
+    if (k <= 0)
+      return copy_buffer(in, in_stride, out, out_stride, width, height);
+
+    const int            w = std::min(width, kStripWidth);
+    std::vector<uint8_t> tmp(2 * padded_size(height, k) * w);
+    uint8_t*             g = tmp.data();
+    uint8_t*             h = tmp.data() + tmp.size() / 2;
+
+    for (int x = 0; x < width; x += kStripWidth)
+      running_columns<Op>(in + x, in_stride, out + x, out_stride, height, std::min(kStripWidth, width - x), k, g, h);
+  }
+
+
+  using raw_op_t = void (*)(const uint8_t*, std::ptrdiff_t, uint8_t*, std::ptrdiff_t, int, int, int);
+
+  mln::image2d<uint8_t> apply(const mln::image2d<uint8_t>& input, int k, raw_op_t op)
+  {
+    mln::image2d<uint8_t> out;
+    mln::resize(out, input);
+    op(input.buffer(), input.stride(), out.buffer(), out.stride(), input.width(), input.height(), k);
+    return out;
+  }
+
+  // Apply op1 then op2 (through a temporary image)
+  mln::image2d<uint8_t> apply(const mln::image2d<uint8_t>& input, int k1, raw_op_t op1, int k2, raw_op_t op2)
+  {
+    mln::image2d<uint8_t> tmp, out;
+    mln::resize(tmp, input);
+    mln::resize(out, input);
+    op1(input.buffer(), input.stride(), tmp.buffer(), tmp.stride(), input.width(), input.height(), k1);
+    op2(tmp.buffer(), tmp.stride(), out.buffer(), out.stride(), input.width(), input.height(), k2);
+    return out;
+  }
+} // namespace
+
+
+namespace impl
+{
+  void hline_erosion(const uint8_t* in, std::ptrdiff_t in_stride, uint8_t* out, std::ptrdiff_t out_stride, int width,
+                     int height, int k)
+  {
+    hline_op<min_t>(in, in_stride, out, out_stride, width, height, k);
+  }
+
+  void hline_dilation(const uint8_t* in, std::ptrdiff_t in_stride, uint8_t* out, std::ptrdiff_t out_stride, int width,
+                      int height, int k)
+  {
+    hline_op<max_t>(in, in_stride, out, out_stride, width, height, k);
+  }
+
+  void vline_erosion(const uint8_t* in, std::ptrdiff_t in_stride, uint8_t* out, std::ptrdiff_t out_stride, int width,
+                     int height, int k)
+  {
+    vline_op<min_t>(in, in_stride, out, out_stride, width, height, k);
+  }
+
+  void vline_dilation(const uint8_t* in, std::ptrdiff_t in_stride, uint8_t* out, std::ptrdiff_t out_stride, int width,
+                      int height, int k)
+  {
+    vline_op<max_t>(in, in_stride, out, out_stride, width, height, k);
+  }
+} // namespace impl
+
+
+mln::image2d<uint8_t> hline_erosion(const mln::image2d<uint8_t>& input, int k)
+{
+  return apply(input, k, impl::hline_erosion);
+}
+
+mln::image2d<uint8_t> hline_dilation(const mln::image2d<uint8_t>& input, int k)
+{
+  return apply(input, k, impl::hline_dilation);
+}
+
+mln::image2d<uint8_t> vline_erosion(const mln::image2d<uint8_t>& input, int k)
+{
+  return apply(input, k, impl::vline_erosion);
+}
+
+mln::image2d<uint8_t> vline_dilation(const mln::image2d<uint8_t>& input, int k)
+{
+  return apply(input, k, impl::vline_dilation);
+}
+
+mln::image2d<uint8_t> hline_opening(const mln::image2d<uint8_t>& input, int k)
+{
+  return apply(input, k, impl::hline_erosion, k, impl::hline_dilation);
+}
+
+mln::image2d<uint8_t> vline_opening(const mln::image2d<uint8_t>& input, int k)
+{
+  return apply(input, k, impl::vline_erosion, k, impl::vline_dilation);
+}
+
+mln::image2d<uint8_t> hline_closing(const mln::image2d<uint8_t>& input, int k)
+{
+  return apply(input, k, impl::hline_dilation, k, impl::hline_erosion);
+}
+
+mln::image2d<uint8_t> vline_closing(const mln::image2d<uint8_t>& input, int k)
+{
+  return apply(input, k, impl::vline_dilation, k, impl::vline_erosion);
+}
+
+// rect2d(width, height) spans [-width/2, width/2] x [-height/2, height/2]
+mln::image2d<uint8_t> rect_opening(const mln::image2d<uint8_t>& input, int width, int height)
+{
+  auto ero = apply(input, width / 2, impl::hline_erosion, height / 2, impl::vline_erosion);
+  return apply(ero, width / 2, impl::hline_dilation, height / 2, impl::vline_dilation);
+}
+
+mln::image2d<uint8_t> rect_closing(const mln::image2d<uint8_t>& input, int width, int height)
+{
+  auto dil = apply(input, width / 2, impl::hline_dilation, height / 2, impl::vline_dilation);
+  return apply(dil, width / 2, impl::hline_erosion, height / 2, impl::vline_erosion);
+}
+
+
+namespace layout
+{
+  mln::image2d<uint8_t> hline_opening(const mln::image2d<uint8_t>& input, int k)
+  {
+    if (kNativeLineMorphology)
+      return ::hline_opening(input, k);
+    return mln::morpho::opening(input, mln::se::periodic_line2d(mln::point2d{1, 0}, k));
+  }
+
+  mln::image2d<uint8_t> vline_opening(const mln::image2d<uint8_t>& input, int k)
+  {
+    if (kNativeLineMorphology)
+      return ::vline_opening(input, k);
+    return mln::morpho::opening(input, mln::se::periodic_line2d(mln::point2d{0, 1}, k));
+  }
+
+  mln::image2d<uint8_t> rect_closing(const mln::image2d<uint8_t>& input, int width, int height)
+  {
+    if (kNativeLineMorphology)
+      return ::rect_closing(input, width, height);
+    return mln::morpho::closing(input, mln::se::rect2d(width, height));
+  }
+} // namespace layout
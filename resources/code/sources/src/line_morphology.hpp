@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mln/core/image/ndimage_fwd.hpp>
+
+
+/// Fast morphology by horizontal/vertical lines and rectangles (van Herk/Gil-Werman algorithm)
+///
+/// * A line of half-size \p k has 2k+1 pixels, i.e. the same SE as `mln::se::periodic_line2d(V, k)` with V = (1,0)
+///   (horizontal) or V = (0,1) (vertical).
+/// * A rectangle has the same extent as `mln::se::rect2d(width, height)` and is processed as two line passes.
+/// * Pixels outside the domain are ignored (as Pylene does with its default border management), so the results are
+///   the same as `mln::morpho::erosion/dilation/opening/closing` with the equivalent SE.
+///
+/// Each pass costs 3 min/max per pixel whatever the SE length. The vertical passes process several columns at once
+/// (row-major accesses that the compiler vectorizes).
+/// \{
+mln::image2d<uint8_t> hline_erosion(const mln::image2d<uint8_t>& input, int k);
+mln::image2d<uint8_t> hline_dilation(const mln::image2d<uint8_t>& input, int k);
+mln::image2d<uint8_t> vline_erosion(const mln::image2d<uint8_t>& input, int k);
+mln::image2d<uint8_t> vline_dilation(const mln::image2d<uint8_t>& input, int k);
+
+mln::image2d<uint8_t> hline_opening(const mln::image2d<uint8_t>& input, int k);
+mln::image2d<uint8_t> vline_opening(const mln::image2d<uint8_t>& input, int k);
+mln::image2d<uint8_t> hline_closing(const mln::image2d<uint8_t>& input, int k);
+mln::image2d<uint8_t> vline_closing(const mln::image2d<uint8_t>& input, int k);
+
+mln::image2d<uint8_t> rect_opening(const mln::image2d<uint8_t>& input, int width, int height);
+mln::image2d<uint8_t> rect_closing(const mln::image2d<uint8_t>& input, int width, int height);
+/// \}
+
+
+/// Openings/closings of the layout analysis
+///
+/// They call `mln::morpho::opening/closing` unless kNativeLineMorphology is set, in which case they call the operators
+/// above. The native operators become the default once check-line-morphology has passed against Pylene.
+namespace layout
+{
+  mln::image2d<uint8_t> hline_opening(const mln::image2d<uint8_t>& input, int k);
+  mln::image2d<uint8_t> vline_opening(const mln::image2d<uint8_t>& input, int k);
+  mln::image2d<uint8_t> rect_closing(const mln::image2d<uint8_t>& input, int width, int height);
+} // namespace layout
+
+
+namespace impl
+{
+  /// Raw buffer versions of the line operators (strides are in number of elements).
+  /// The input and the output buffers may not overlap. Pixels outside the (width x height) buffer are ignored.
+  /// \{
+  void hline_erosion(const uint8_t* in, std::ptrdiff_t in_stride, uint8_t* out, std::ptrdiff_t out_stride, //
+                     int width, int height, int k);
+  void hline_dilation(const uint8_t* in, std::ptrdiff_t in_stride, uint8_t* out, std::ptrdiff_t out_stride, //
+                      int width, int height, int k);
+  void vline_erosion(const uint8_t* in, std::ptrdiff_t in_stride, uint8_t* out, std::ptrdiff_t out_stride, //
+                     int width, int height, int k);
+  void vline_dilation(const uint8_t* in, std::ptrdiff_t in_stride, uint8_t* out, std::ptrdiff_t out_stride, //
+                      int width, int height, int k);
+  /// \}
+} // namespace impl
@@ -5,6 +5,7 @@
 #include <poppler-image.h>
 #include <poppler-page-renderer.h>
 #include <spdlog/spdlog.h>
+#include <filesystem>
 
 std::shared_ptr<poppler::document> open_document(const char* filename) noexcept
 {
@@ -19,6 +20,61 @@ std::shared_ptr<poppler::document> open_document(const char* filename) noexcept
   return doc;
 }
 
+namespace
+{
+  struct document_cache_t
+  {
+    int                                scopes = 0; // Number of DocumentCacheScope alive
+    std::string                        path;
+    std::filesystem::file_time_type    mtime;
+    std::uintmax_t                     size = 0;
+    std::shared_ptr<poppler::document> doc;
+  };
+
+  thread_local document_cache_t tls_document_cache;
+} // namespace
+
+DocumentCacheScope::DocumentCacheScope()
+{
+  tls_document_cache.scopes++;
+}
+
+DocumentCacheScope::~DocumentCacheScope()
+{
+  if (--tls_document_cache.scopes == 0)
+  {
+    tls_document_cache.doc = nullptr;
+    tls_document_cache.path.clear();
+  }
+}
+
+std::shared_ptr<poppler::document> open_document_cached(const char* filename) noexcept
+{
+  namespace fs = std::filesystem;
+
+  auto& last = tls_document_cache;
+  if (last.scopes == 0)
+    return open_document(filename);
+
+  std::error_code ec;
+  auto            mtime = fs::last_write_time(filename, ec);
+  auto            size  = ec ? 0 : fs::file_size(filename, ec);
+  if (ec)
+  {
+    last.doc = nullptr;
+    return open_document(filename);
+  }
+
+  if (!last.doc || last.path != filename || last.mtime != mtime || last.size != size)
+  {
+    last.doc   = open_document(filename);
+    last.path  = filename;
+    last.mtime = mtime;
+    last.size  = size;
+  }
+  return last.doc;
+}
+
 
 std::optional<PageData> load_page(poppler::document* doc, int page) noexcept
 {
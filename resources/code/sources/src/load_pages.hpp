@@ -16,6 +16,24 @@ namespace poppler
 /// Return null if the document cannot be opened
 std::shared_ptr<poppler::document> open_document(const char* filename) noexcept;
 
+/// \brief Same as open_document, but while a DocumentCacheScope is alive in the calling thread, the last document
+/// opened is kept and returned again while the file is not modified (the pages of a pdf processed one after the other
+/// by a thread are parsed once). Without a scope, the document is opened again.
+std::shared_ptr<poppler::document> open_document_cached(const char* filename) noexcept;
+
+/// \brief Enable the cache of open_document_cached in the calling thread; the cached document is released with the
+/// outermost scope. Only the batch processing opens a scope: the long-lived threads (server, JobManager) must not keep
+/// the pdfs open.
+class DocumentCacheScope
+{
+public:
+  DocumentCacheScope();
+  ~DocumentCacheScope();
+
+  DocumentCacheScope(const DocumentCacheScope&)            = delete;
+  DocumentCacheScope& operator=(const DocumentCacheScope&) = delete;
+};
+
 
 /// \brief Load the page \p page from the document \p document
 /// and returns its content (image + text boxes)
@@ -0,0 +1,258 @@
+#include "thread_pool.hpp"
+#include "config.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+
+namespace
+{
+  // Pool and index of the worker running in the current thread (-1 outside of a pool)
+  thread_local ThreadPool* tls_pool  = nullptr;
+  thread_local int         tls_index = -1;
+} // namespace
+
+
+ThreadPool::ThreadPool(int nthreads)
+{
+  if (nthreads <= 0)
+    nthreads = std::max(1u, std::thread::hardware_concurrency());
+
+  for (int i = 0; i <= nthreads; ++i)
+    m_queues.push_back(std::make_unique<queue_t>());
+
+  m_workers.reserve(nthreads);
+  for (int i = 0; i < nthreads; ++i)
+    m_workers.emplace_back([this, i]() { this->worker_loop(i); });
+}
+
+ThreadPool::~ThreadPool()
+{
+  {
+    std::lock_guard lock(m_mutex);
+    m_stop = true;
+  }
+  m_cv.notify_all();
+  for (auto& w : m_workers)
+    w.join();
+}
+
+ThreadPool& ThreadPool::global()
+{
+  static ThreadPool pool(kNumThreads);
+  return pool;
+}
+
+int ThreadPool::size() const
+{
+  return static_cast<int>(m_workers.size());
+}
+
+void ThreadPool::push(std::function<void()> task)
+{
+  // A worker pushes in its own deque, other threads in the shared one
+  int index = (tls_pool == this) ? tls_index : static_cast<int>(m_queues.size()) - 1;
+  {
+    std::lock_guard lock(m_queues[index]->mutex);
+    m_queues[index]->tasks.push_back(std::move(task));
+  }
+  {
+    std::lock_guard lock(m_mutex);
+    m_pending++;
+  }
+  m_cv.notify_one();
+}
+
+bool ThreadPool::pop_local(int index, std::function<void()>& task)
+{
+  auto&           q = *m_queues[index];
+  std::lock_guard lock(q.mutex);
+  if (q.tasks.empty())
+    return false;
+  task = std::move(q.tasks.back());
+  q.tasks.pop_back();
+  return true;
+}
+
+bool ThreadPool::steal(int index, std::function<void()>& task)
+{
+  // Start with the shared queue, then the other workers (from the next one)
+  const int nworkers = static_cast<int>(m_queues.size()) - 1;
+  for (int i = -1; i < nworkers; ++i)
+  {
+    int victim = (i < 0) ? nworkers : (index + 1 + i) % nworkers;
+    if (victim == index)
+      continue;
+
+    auto&           q = *m_queues[victim];
+    std::lock_guard lock(q.mutex);
+    if (q.tasks.empty())
+      continue;
+    task = std::move(q.tasks.front());
+    q.tasks.pop_front();
+    return true;
+  }
+  return false;
+}
+
+bool ThreadPool::try_run_one()
+{
+  if (m_pending.load() == 0)
+    return false;
+
+  int                   index = (tls_pool == this) ? tls_index : -1;
+  std::function<void()> task;
+  if (!(index >= 0 && this->pop_local(index, task)) && !this->steal(index, task))
+    return false;
+
+  m_pending--;
+  task();
+  return true;
+}
+
+void ThreadPool::worker_loop(int index)
+{
+  tls_pool  = this;
+  tls_index = index;
+
+  while (true)
+  {
+    if (this->try_run_one())
+      continue;
+
+    std::unique_lock lock(m_mutex);
+    m_cv.wait(lock, [this]() { return m_stop || m_pending.load() > 0; });
+    if (m_stop && m_pending.load() == 0)
+      return;
+  }
+}
+
+
+namespace
+{
+  // Shared between the caller of parallel_for and the helper tasks (which may start after the loop is over)
+  struct parallel_for_state
+  {
+    std::function<void(int)> f;
+    int                      n;
+    std::atomic<int>         next = 0;
+    int                      done = 0;
+    std::exception_ptr       error;
+    std::mutex               mutex;
+    std::condition_variable  cv;
+
+    // Take iterations until there is no more to process
+    void run()
+    {
+      int count = 0;
+      std::exception_ptr err;
+      for (int i = next++; i < n; i = next++, ++count)
+      {
+        try
+        {
+          f(i);
+        }
+        catch (...)
+        {
+          if (!err)
+            err = std::current_exception();
+        }
+      }
+
+      if (count == 0)
+        return;
+
+      std::lock_guard lock(mutex);
+      if (err && !error)
+        error = err;
+      done += count;
+      if (done == n)
+        cv.notify_all();
+    }
+  };
+} // namespace
+
+
+void ThreadPool::parallel_for(int n, const std::function<void(int)>& f)
+{
+  if (n <= 0)
+    return;
+
+  auto state = std::make_shared<parallel_for_state>();
+  state->f   = f;
+  state->n   = n;
+
+  int nhelpers = std::min(n, this->size() + 1) - 1;
+  for (int i = 0; i < nhelpers; ++i)
+    this->push([state]() { state->run(); });
+
+  state->run();
+
+  std::unique_lock lock(state->mutex);
+  state->cv.wait(lock, [&state]() { return state->done == state->n; });
+  if (state->error)
+    std::rethrow_exception(state->error);
+}
+
+
+TaskGroup::TaskGroup(ThreadPool& pool)
+  : m_pool{&pool}
+  , m_state{std::make_shared<state_t>()}
+{
+}
+
+TaskGroup::~TaskGroup()
+{
+  try
+  {
+    this->wait();
+  }
+  catch (...)
+  {
+  }
+}
+
+void TaskGroup::run(std::function<void()> f)
+{
+  m_state->count++;
+  m_pool->push([state = m_state, f = std::move(f)]() {
+    try
+    {
+      f();
+    }
+    catch (...)
+    {
+      std::lock_guard lock(state->mutex);
+      if (!state->error)
+        state->error = std::current_exception();
+    }
+
+    if (--state->count == 0)
+    {
+      std::lock_guard lock(state->mutex);
+      state->cv.notify_all();
+    }
+  });
+}
+
+void TaskGroup::wait()
+{
+  // Help the pool while our tasks are pending. When there is nothing to run, our remaining tasks are being run by
+  // other threads: sleep until they complete (with a timeout to catch the tasks they may spawn meanwhile).
+  while (m_state->count.load() > 0)
+  {
+    if (m_pool->try_run_one())
+      continue;
+
+    std::unique_lock lock(m_state->mutex);
+    m_state->cv.wait_for(lock, std::chrono::milliseconds(1), [this]() { return m_state->count.load() == 0; });
+  }
+
+  std::exception_ptr err;
+  {
+    std::lock_guard lock(m_state->mutex);
+    std::swap(err, m_state->error);
+  }
+  if (err)
+    std::rethrow_exception(err);
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+/// Pool of worker threads shared by the parallel stages of the pipeline
+///
+/// Every worker owns a deque of tasks: it pushes and pops its own tasks at the back (LIFO, good locality for
+/// recursive algorithms) and steals the oldest tasks of the other workers when it runs out of work. Tasks submitted
+/// by threads outside the pool go to a shared queue.
+class ThreadPool
+{
+public:
+  /// \param nthreads Number of workers (0 = number of hardware threads)
+  explicit ThreadPool(int nthreads = 0);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  /// Pool shared by the whole application (created at first use with kNumThreads workers)
+  static ThreadPool& global();
+
+  /// Number of worker threads
+  int size() const;
+
+  /// Run f(i) for every i in [0, n) and wait for the completion.
+  /// The calling thread takes part in the work, so it can be called from a task of the pool.
+  /// The first exception thrown by f (if any) is rethrown once all the calls have completed.
+  void parallel_for(int n, const std::function<void(int)>& f);
+
+  /// Submit a task
+  void push(std::function<void()> task);
+
+  /// Run one pending task (if any) in the calling thread. Return false if there was nothing to run.
+  bool try_run_one();
+
+private:
+  struct queue_t
+  {
+    std::mutex                        mutex;
+    std::deque<std::function<void()>> tasks;
+  };
+
+  bool pop_local(int index, std::function<void()>& task);
+  bool steal(int index, std::function<void()>& task);
+  void worker_loop(int index);
+
+  std::vector<std::thread>              m_workers;
+  std::vector<std::unique_ptr<queue_t>> m_queues; // One per worker + the shared queue (last)
+  std::atomic<int>                      m_pending = 0;
+  std::mutex                            m_mutex;
+  std::condition_variable               m_cv;
+  bool                                  m_stop = false;
+};
+
+
+/// Group of tasks spawned on a pool that can be waited for
+///
+/// wait() runs pending tasks of the pool while the group is not complete, so a task can spawn and wait for
+/// sub-tasks (recursive algorithms) without starving the pool.
+class TaskGroup
+{
+public:
+  explicit TaskGroup(ThreadPool& pool = ThreadPool::global());
+  ~TaskGroup();
+
+  TaskGroup(const TaskGroup&) = delete;
+  TaskGroup& operator=(const TaskGroup&) = delete;
+
+  /// Spawn a task in the group
+  void run(std::function<void()> f);
+
+  /// Wait for the completion of all the tasks of the group.
+  /// The first exception thrown by a task (if any) is rethrown.
+  void wait();
+
+private:
+  struct state_t
+  {
+    std::atomic<int>        count = 0;
+    std::exception_ptr      error;
+    std::mutex              mutex;
+    std::condition_variable cv;
+  };
+
+  ThreadPool*              m_pool;
+  std::shared_ptr<state_t> m_state;
+};
@@ -2,6 +2,10 @@
 
 #include <mln/morpho/watershed.hpp>
 
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
 
 
 /******************************************/
@@ -122,4 +126,147 @@ namespace impl
 
     return nlabel;
   }
+
+
+  /// Marker-based watershed specialized for 8-bit inputs and the 4-connectivity
+  ///
+  /// Same result as `watershed(input, mln::c4, markers, nlabel)` above (markers are labels > 0, the other pixels are 0
+  /// and get either a label or the waterline 0; see check-watershed) but:
+  /// * the priority queue is a bucket queue with one FIFO per level (linked through a flat array of next indexes);
+  /// * the labels are stored in a buffer with a 1-pixel border of waterline, so the neighbors are fixed offsets
+  ///   and need no bound check.
+  /// The pixels are pushed and popped in the same order as with the generic implementation, so the labels and the
+  /// waterlines are identical. \p L is the label type (int16_t or int32_t).
+  template <class L>
+  int watershed_u8(const mln::image2d<uint8_t>& input, mln::image2d<L>& markers, int nlabel)
+  {
+    constexpr L   kUnlabeled = -2;
+    constexpr L   kInqueue   = -1;
+    constexpr L   kWaterline = 0;
+    constexpr int kNone      = -1; // End of a FIFO
+
+    const int width  = input.width();
+    const int height = input.height();
+    const int W      = width + 2;
+    const int H      = height + 2;
+    const int nbh[4] = {-W, -1, 1, W}; // Same order as mln::c4 (up, left, right, down)
+
+    std::vector<uint8_t> val(W * H, 0);
+    std::vector<L>       lbl(W * H, kWaterline);
+    for (int y = 0; y < height; ++y)
+    {
+      std::copy_n(input.buffer() + y * input.stride(), width, val.data() + (y + 1) * W + 1);
+      std::copy_n(markers.buffer() + y * markers.stride(), width, lbl.data() + (y + 1) * W + 1);
+    }
+
+    // Bucket queue (FIFO per level, the lowest level first)
+    std::vector<int> next(W * H);
+    int              head[256], tail[256];
+    int              current = 256;
+    std::fill_n(head, 256, kNone);
+    std::fill_n(tail, 256, kNone);
+
+    auto push = [&](int p) {
+      int level = val[p];
+      next[p]   = kNone;
+      if (tail[level] == kNone)
+        head[level] = p;
+      else
+        next[tail[level]] = p;
+      tail[level] = p;
+      current     = std::min(current, level);
+    };
+
+    auto pop = [&]() {
+      int p         = head[current];
+      head[current] = next[p];
+      if (head[current] == kNone)
+      {
+        tail[current] = kNone;
+        while (current < 256 && head[current] == kNone)
+          current++;
+      }
+      return p;
+    };
+
+    // 1. Push the unlabeled neighbors of the markers (row-major order)
+    for (int y = 1; y <= height; ++y)
+      for (int p = y * W + 1; p <= y * W + width; ++p)
+      {
+        if (lbl[p] != 0)
+          continue;
+
+        bool is_local_min_neighbor = false;
+        for (int k = 0; k < 4; ++k)
+          if (lbl[p + nbh[k]] > 0)
+          {
+            is_local_min_neighbor = true;
+            break;
+          }
+
+        if (is_local_min_neighbor)
+        {
+          lbl[p] = kInqueue;
+          push(p);
+        }
+        else
+        {
+          lbl[p] = kUnlabeled;
+        }
+      }
+
+    // 2. Flood from the markers
+    while (current < 256)
+    {
+      int p = pop();
+
+      // Check if there is a single marked neighbor
+      L    common_label               = kWaterline;
+      bool has_single_adjacent_marker = false;
+      for (int k = 0; k < 4; ++k)
+      {
+        L nlbl = lbl[p + nbh[k]];
+        if (nlbl <= 0)
+          continue;
+        else if (common_label == kWaterline)
+        {
+          common_label               = nlbl;
+          has_single_adjacent_marker = true;
+        }
+        else if (nlbl != common_label)
+        {
+          has_single_adjacent_marker = false;
+          break;
+        }
+      }
+
+      if (!has_single_adjacent_marker)
+      {
+        lbl[p] = kWaterline;
+        continue;
+      }
+
+      lbl[p] = common_label;
+      for (int k = 0; k < 4; ++k)
+      {
+        int q = p + nbh[k];
+        if (lbl[q] == kUnlabeled)
+        {
+          lbl[q] = kInqueue;
+          push(q);
+        }
+      }
+    }
+
+    // 3. Label all unlabeled pixels
+    for (int y = 0; y < height; ++y)
+    {
+      const L* src = lbl.data() + (y + 1) * W + 1;
+      L*       dst = markers.buffer() + y * markers.stride();
+      for (int x = 0; x < width; ++x)
+        dst[x] = std::max(src[x], kWaterline);
+    }
+
+    return nlabel;
+  }
 } // namespace impl